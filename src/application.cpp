@@ -7,6 +7,7 @@
 #include <nfd.hpp>
 #include <nfd_sdl2.h>
 #include <toml.hpp>
+#include <algorithm>
 
 #ifdef EMU_PLATFORM_WINDOWS
 #include <SDL_syswm.h>
@@ -26,49 +27,112 @@ Application::~Application()
 
 int Application::run(int argc, char* argv[])
 {
+#ifndef EMU_DEBUG_ENABLED
+    log_set_error_handler([](const char* message) {
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, EMU_VERSION_NAME, message, nullptr);
+    });
+#endif // Release mode
+
     load_settings();
 
     m_running = init();
     if (!m_running)
         return -1;
 
-    if (!m_nes->init())
+    if (!m_emulation->emulator().init())
         return -1;
 
-    if (argc > 1 && !m_nes->load_rom_file(argv[1]))
+    if (argc > 1 && !m_emulation->emulator().load_rom_file(argv[1]))
         return -1;
 
-    constexpr int DELAY = 1000.0f / 60;
+    // The emulation thread paces itself, the UI only shows its latest frame.
+    // The sound is kept two device buffers and a frame ahead of the device.
+    const long sound_target = 2 * m_sound_device_samples + APU::SoundSampleRate / 60;
+    m_emulation->set_sound_output([this](const blip_sample_t* samples, long count) {
+        m_sound_queue->set_producing(count > 0);
+        if (count > 0)
+            m_sound_queue->write(samples, count);
+        return m_sound_queue->sample_count();
+    }, sound_target);
+    send_command({ EmulationThread::Command::SetFastForwardSpeed, m_fast_forward_speed });
+    send_command({ EmulationThread::Command::SetRunAhead, m_run_ahead });
+    m_emulation->set_rewind_buffer_size(static_cast<size_t>(m_rewind_buffer_size) * 1024 * 1024);
+    m_emulation->start();
+
     uint32_t frame_time = 0;
 
     while (m_running)
     {
         const uint32_t frame_start = SDL_GetTicks();
 
+        send_pending_commands();
         process_events();
 
-        if (!m_show_popup)
+        uint8_t buttons[Controller::ControllerCount] = {};
+        m_input_manager.poll_buttons_state(buttons, Controller::ControllerCount);
+        m_emulation->set_buttons_state(buttons, Controller::ControllerCount);
+
+        // Rewinds while Backspace is held, unless it goes to the UI
+        const bool rewinding = !ImGui::GetIO().WantCaptureKeyboard &&
+                               SDL_GetKeyboardState(nullptr)[SDL_SCANCODE_BACKSPACE] != 0;
+        if (rewinding != m_rewinding)
         {
-            m_nes->run();
-            if (m_nes->sound_samples_available() >= APU::SoundBufferSize)
-            {
-                long size = m_nes->read_sound_samples(m_sound_buffer, sizeof(m_sound_buffer) / sizeof(blip_sample_t));
-                m_sound_queue->write(m_sound_buffer, size);
-            }
+            m_rewinding = rewinding;
+            send_command({ EmulationThread::Command::SetRewind, m_rewinding ? 1 : 0 });
         }
 
+        process_emulation_events();
+
         render();
 
         frame_time = SDL_GetTicks() - frame_start;
-        if (frame_time < DELAY)
-            SDL_Delay((int)(DELAY - frame_time));
+        if (frame_time < FrameDelay)
+            SDL_Delay((int)(FrameDelay - frame_time));
     }
 
+    m_emulation->stop();
     save_settings();
 
     return 0;
 }
 
+void Application::send_command(const EmulationThread::Command& command)
+{
+    // Kept in order until the command queue has room again, a ROM load or a
+    // reset is never dropped
+    if (!m_pending_commands.empty() || !m_emulation->send(command))
+    {
+        if (m_pending_commands.empty())
+            LOG_WARNING("Emulation command queue full, command delayed");
+
+        m_pending_commands.push_back(command);
+    }
+}
+
+void Application::send_pending_commands()
+{
+    while (!m_pending_commands.empty() && m_emulation->send(m_pending_commands.front()))
+        m_pending_commands.pop_front();
+}
+
+void Application::process_emulation_events()
+{
+    EmulationThread::Event event;
+    while (m_emulation->poll_event(event))
+    {
+        switch (event.type)
+        {
+        case EmulationThread::Event::RomLoaded:
+        {
+            const std::string title = std::string(EMU_VERSION_NAME) + " - " +
+                                      platform::file_remove_extension(platform::file_name(event.path));
+            set_window_title(title);
+            break;
+        }
+        }
+    }
+}
+
 void Application::set_window_title(const std::string& title)
 {
     m_window_title = title;
@@ -119,7 +183,8 @@ bool Application::init()
     }
 
     m_sound_queue = std::make_unique<SoundQueue>();
-    if (!m_sound_queue->init(APU::SoundSampleRate))
+    if (!m_sound_queue->init(APU::SoundSampleRate, std::max<long>(m_sound_capacity, 4 * m_sound_device_samples),
+                             m_sound_device_samples))
         return false;
 
     IMGUI_CHECKVERSION();
@@ -192,7 +257,7 @@ void Application::on_keyboard_event(const SDL_KeyboardEvent& event)
     if (event.keysym.sym == SDLK_r &&
         event.keysym.mod & KMOD_CTRL)
     {
-        m_nes.reset();
+        send_command({ EmulationThread::Command::Reset });
         return;
     }
 
@@ -202,6 +267,13 @@ void Application::on_keyboard_event(const SDL_KeyboardEvent& event)
         toggle_fullscreen();
         return;
     }
+
+    if (event.keysym.sym == SDLK_t &&
+        event.keysym.mod & KMOD_CTRL)
+    {
+        toggle_fast_forward();
+        return;
+    }
 }
 
 void Application::on_window_event(const SDL_Event& event)
@@ -244,13 +316,21 @@ void Application::render()
         ImGui::OpenPopup("About");
     render_about_dialog();
 
+    // The emulation waits while a dialog is open
+    const bool dialog_open = ImGui::IsPopupOpen("Exit") || ImGui::IsPopupOpen("About");
+    if (dialog_open != m_dialog_open)
+    {
+        m_dialog_open = dialog_open;
+        send_command({ EmulationThread::Command::SetHold, m_dialog_open ? 1 : 0 });
+    }
+
     ImGui::EndFrame();
 
-    if (m_nes->running())
+    if (m_emulation->running())
     {
         // Keep aspect ratio
         SDL_RenderSetLogicalSize(m_renderer, PPU::ScreenWidth, PPU::ScreenHeight);
-        SDL_UpdateTexture(m_frame_texture, nullptr, m_nes->screen_buffer(), PPU::ScreenWidth * sizeof(uint32_t));
+        SDL_UpdateTexture(m_frame_texture, nullptr, m_emulation->latest_frame(), PPU::ScreenWidth * sizeof(uint32_t));
         SDL_RenderCopy(m_renderer, m_frame_texture, nullptr, nullptr);
     }
 
@@ -290,17 +370,47 @@ void Application::render_menubar()
                 open_palette_file();
 
             ImGui::Separator();
-            const std::string menu_title = m_nes->paused() ? "Resume" : "Pause";
-            if (ImGui::MenuItem(menu_title.c_str(), "Esc", false, m_nes->running()))
-                m_nes->toggle_pause();
+            const std::string menu_title = m_emulation->paused() ? "Resume" : "Pause";
+            if (ImGui::MenuItem(menu_title.c_str(), "Esc", false, m_emulation->running()))
+                send_command({ EmulationThread::Command::TogglePause });
 
-            if (ImGui::MenuItem("Reset", "Ctr+R", false, m_nes->running()))
-                m_nes->reset();
+            if (ImGui::MenuItem("Reset", "Ctr+R", false, m_emulation->running()))
+                send_command({ EmulationThread::Command::Reset });
 
             ImGui::Separator();
-            if (ImGui::MenuItem("Power Off", nullptr, false, m_nes->running()))
+            if (ImGui::MenuItem("Fast Forward", "Ctr+T", m_fast_forward))
+                toggle_fast_forward();
+
+            if (ImGui::BeginMenu("Fast Forward Speed"))
             {
-                m_nes->power_off();
+                if (ImGui::MenuItem("2x", nullptr, m_fast_forward_speed == 2))
+                    set_fast_forward_speed(2);
+                if (ImGui::MenuItem("4x", nullptr, m_fast_forward_speed == 4))
+                    set_fast_forward_speed(4);
+                if (ImGui::MenuItem("8x", nullptr, m_fast_forward_speed == 8))
+                    set_fast_forward_speed(8);
+                if (ImGui::MenuItem("Unlimited", nullptr, m_fast_forward_speed == 0))
+                    set_fast_forward_speed(0);
+                ImGui::EndMenu();
+            }
+
+            if (ImGui::BeginMenu("Run Ahead"))
+            {
+                if (ImGui::MenuItem("Off", nullptr, m_run_ahead == 0))
+                    set_run_ahead(0);
+                if (ImGui::MenuItem("1 frame", nullptr, m_run_ahead == 1))
+                    set_run_ahead(1);
+                if (ImGui::MenuItem("2 frames", nullptr, m_run_ahead == 2))
+                    set_run_ahead(2);
+                if (ImGui::MenuItem("3 frames", nullptr, m_run_ahead == 3))
+                    set_run_ahead(3);
+                ImGui::EndMenu();
+            }
+
+            ImGui::Separator();
+            if (ImGui::MenuItem("Power Off", nullptr, false, m_emulation->running()))
+            {
+                send_command({ EmulationThread::Command::PowerOff });
                 set_window_title(EMU_VERSION_NAME);
             }
 
@@ -337,6 +447,15 @@ void Application::render_menubar()
             if (ImGui::MenuItem("Full screen", "Ctr+F", m_fullscreen))
                 toggle_fullscreen();
 
+            if (ImGui::MenuItem("Sound Statistics", nullptr, m_show_sound_stats))
+                m_show_sound_stats = !m_show_sound_stats;
+
+            if (ImGui::MenuItem("Rewind Statistics", nullptr, m_show_rewind_stats))
+                m_show_rewind_stats = !m_show_rewind_stats;
+
+            if (ImGui::MenuItem("Frame Statistics", nullptr, m_show_frame_stats))
+                m_show_frame_stats = !m_show_frame_stats;
+
             ImGui::EndMenu();
         }
 
@@ -349,16 +468,46 @@ void Application::render_menubar()
         }
 
         ImGui::Separator();
-        if (m_nes->running())
+        if (m_emulation->running())
         {
-            if (m_nes->paused())
+            if (m_emulation->paused())
                 ImGui::Text("Paused");
+            else if (m_rewinding)
+                ImGui::Text("Rewinding");
+            else if (m_fast_forward && m_fast_forward_speed > 0)
+                ImGui::Text("Fast forward %dx", m_fast_forward_speed);
+            else if (m_fast_forward)
+                ImGui::Text("Fast forward");
             else
                 ImGui::Text("Running...");
         }
         else
             ImGui::Text("Idle");
 
+        if (m_show_sound_stats)
+        {
+            ImGui::Separator();
+            ImGui::Text("Sound: %.0f ms, %llu underruns, %llu overruns", m_sound_queue->latency(),
+                        static_cast<unsigned long long>(m_sound_queue->underruns()),
+                        static_cast<unsigned long long>(m_sound_queue->overruns()));
+        }
+
+        if (m_show_rewind_stats)
+        {
+            // Memory per minute of play, the frames held are the last ones run
+            const EmulationThread::RewindStats stats = m_emulation->rewind_stats();
+            const double megabytes_per_minute = stats.frames > 0 ? stats.memory / (1024.0 * 1024.0) / stats.frames * 3600 : 0;
+            ImGui::Separator();
+            ImGui::Text("Rewind: %.1f s, %.1f MB/min, %.0f us capture", stats.frames / 60.0,
+                        megabytes_per_minute, stats.capture_time);
+        }
+
+        if (m_show_frame_stats)
+        {
+            ImGui::Separator();
+            ImGui::Text("Frame: %.2f ms, %d ahead", m_emulation->frame_time(), m_run_ahead);
+        }
+
         ImGui::EndMainMenuBar();
     }
 }
@@ -367,7 +516,6 @@ void Application::render_exit_dialog()
 {
     if (ImGui::BeginPopupModal("Exit", NULL, ImGuiWindowFlags_AlwaysAutoResize))
     {
-        m_show_popup = true;
         m_exit = false;
 
         ImGui::Text("Are you sure you want to exit?");
@@ -384,7 +532,6 @@ void Application::render_exit_dialog()
 
         if (ImGui::Button("No", ImVec2(120, 0)))
         {
-            m_show_popup = false;
             ImGui::CloseCurrentPopup();
         }
 
@@ -396,7 +543,6 @@ void Application::render_about_dialog()
 {
     if (ImGui::BeginPopupModal("About", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
     {
-        m_show_popup = true;
         m_show_about = false;
 
         ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(0, 128, 255, 255));
@@ -434,7 +580,6 @@ void Application::render_about_dialog()
         ImGui::SetItemDefaultFocus();
         if (ImGui::Button("OK", ImVec2(200, 0)))
         {
-            m_show_popup = false;
             ImGui::CloseCurrentPopup();
         }
 
@@ -453,6 +598,11 @@ void Application::load_settings()
     std::optional<uint32_t> window_y = config.table()["window"]["y"][0].value<uint32_t>();
     std::optional<uint32_t> window_width = config.table()["window"]["width"][0].value<uint32_t>();
     std::optional<uint32_t> window_height = config.table()["window"]["height"][0].value<uint32_t>();
+    std::optional<uint32_t> fast_forward_speed = config.table()["emulation"]["fast_forward_speed"][0].value<uint32_t>();
+    std::optional<uint32_t> rewind_buffer_size = config.table()["emulation"]["rewind_buffer_size"][0].value<uint32_t>();
+    std::optional<uint32_t> run_ahead = config.table()["emulation"]["run_ahead"][0].value<uint32_t>();
+    std::optional<uint32_t> sound_capacity = config.table()["sound"]["capacity"][0].value<uint32_t>();
+    std::optional<uint32_t> sound_device_samples = config.table()["sound"]["device_samples"][0].value<uint32_t>();
 
     if (theme.has_value())
         m_style_name = theme.value();
@@ -464,6 +614,16 @@ void Application::load_settings()
         m_window_width = window_width.value() >= DefaultWindowWidth ? window_width.value() : DefaultWindowWidth;
     if (window_height.has_value())
         m_window_height = window_height.value() >= DefaultWindowHeight ? window_height.value() : DefaultWindowHeight;
+    if (fast_forward_speed.has_value())
+        m_fast_forward_speed = fast_forward_speed.value() <= 8 ? fast_forward_speed.value() : 8;
+    if (rewind_buffer_size.has_value())
+        m_rewind_buffer_size = std::min<uint32_t>(rewind_buffer_size.value(), 1024);
+    if (run_ahead.has_value())
+        m_run_ahead = run_ahead.value() <= 3 ? run_ahead.value() : 3;
+    if (sound_capacity.has_value())
+        m_sound_capacity = std::clamp<uint32_t>(sound_capacity.value(), 1024, 65536);
+    if (sound_device_samples.has_value())
+        m_sound_device_samples = std::clamp<uint32_t>(sound_device_samples.value(), 64, 4096);
 }
 
 void Application::save_settings()
@@ -477,6 +637,15 @@ void Application::save_settings()
         y = [0]
         width = [0]
         height = [0]
+
+        [emulation]
+        fast_forward_speed = [4]
+        rewind_buffer_size = [32]
+        run_ahead = [0]
+
+        [sound]
+        capacity = [0]
+        device_samples = [0]
     )");
 
     if (!config)
@@ -522,6 +691,46 @@ void Application::save_settings()
         });
     }
 
+    if (toml::array* fast_forward_speed = config.table()["emulation"]["fast_forward_speed"].as_array())
+    {
+        fast_forward_speed->for_each([this](auto&& el) {
+            if constexpr (toml::is_number<decltype(el)>)
+                el = m_fast_forward_speed;
+        });
+    }
+
+    if (toml::array* rewind_buffer_size = config.table()["emulation"]["rewind_buffer_size"].as_array())
+    {
+        rewind_buffer_size->for_each([this](auto&& el) {
+            if constexpr (toml::is_number<decltype(el)>)
+                el = m_rewind_buffer_size;
+        });
+    }
+
+    if (toml::array* run_ahead = config.table()["emulation"]["run_ahead"].as_array())
+    {
+        run_ahead->for_each([this](auto&& el) {
+            if constexpr (toml::is_number<decltype(el)>)
+                el = m_run_ahead;
+        });
+    }
+
+    if (toml::array* sound_capacity = config.table()["sound"]["capacity"].as_array())
+    {
+        sound_capacity->for_each([this](auto&& el) {
+            if constexpr (toml::is_number<decltype(el)>)
+                el = m_sound_capacity;
+        });
+    }
+
+    if (toml::array* sound_device_samples = config.table()["sound"]["device_samples"].as_array())
+    {
+        sound_device_samples->for_each([this](auto&& el) {
+            if constexpr (toml::is_number<decltype(el)>)
+                el = m_sound_device_samples;
+        });
+    }
+
     std::ofstream config_file("nesmancer.toml");
     if (!config_file.is_open())
         return;
@@ -535,6 +744,24 @@ void Application::toggle_fullscreen()
     SDL_SetWindowFullscreen(m_window, m_fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
 }
 
+void Application::toggle_fast_forward()
+{
+    m_fast_forward = !m_fast_forward;
+    send_command({ EmulationThread::Command::SetFastForward, m_fast_forward ? 1 : 0 });
+}
+
+void Application::set_fast_forward_speed(int speed)
+{
+    m_fast_forward_speed = speed;
+    send_command({ EmulationThread::Command::SetFastForwardSpeed, speed });
+}
+
+void Application::set_run_ahead(int frames)
+{
+    m_run_ahead = frames;
+    send_command({ EmulationThread::Command::SetRunAhead, frames });
+}
+
 void Application::open_nes_file()
 {
     NFD::Guard guard;
@@ -550,13 +777,9 @@ void Application::open_nes_file()
     nfdresult_t result = NFD::OpenDialog(nes_file_path, filter, 1, nullptr, parent_window);
     if (result == NFD_OKAY)
     {
+        // The title changes once the emulation thread has loaded it
         std::string file_path(nes_file_path.get());
-        if (m_nes->load_rom_file(file_path))
-        {
-            const std::string title = std::string(EMU_VERSION_NAME) + " - " +
-                                      platform::file_remove_extension(platform::file_name(file_path));
-            set_window_title(title);
-        }
+        send_command({ EmulationThread::Command::LoadRom, 0, file_path });
     }
 }
 
@@ -576,6 +799,6 @@ void Application::open_palette_file()
     if (result == NFD_OKAY)
     {
         std::string file_path(nes_file_path.get());
-        m_nes->load_palette_file(file_path);
+        send_command({ EmulationThread::Command::LoadPalette, 0, file_path });
     }
 }
@@ -1,10 +1,11 @@
 #pragma once
 
-#include "emulator.hpp"
+#include "emulation_thread.hpp"
 #include "input_manager.hpp"
 #include "sound_queue.hpp"
 #include "application_style.hpp"
 #include "version.hpp"
+#include <deque>
 #include <string>
 #include <memory>
 #include <SDL.h>
@@ -13,7 +14,7 @@ class Application
 {
 public:
     Application() :
-        m_nes(std::make_unique<Emulator>(m_input_manager))
+        m_emulation(std::make_unique<EmulationThread>())
     {}
 
     ~Application();
@@ -24,12 +25,13 @@ public:
 
     static constexpr uint16_t DefaultWindowWidth = PPU::ScreenWidth * PPU::ScreenScale;
     static constexpr uint16_t DefaultWindowHeight = PPU::ScreenHeight * PPU::ScreenScale;
+    static constexpr uint32_t FrameDelay = 1000 / 60;
 
 private:
     InputManager m_input_manager;
-    std::unique_ptr<Emulator> m_nes = nullptr;
     std::unique_ptr<SoundQueue> m_sound_queue = nullptr;
-    blip_sample_t m_sound_buffer[APU::SoundBufferSize] = {};
+    // Declared after the sound queue it writes to, so it stops first
+    std::unique_ptr<EmulationThread> m_emulation = nullptr;
     SDL_Window* m_window = nullptr;
     SDL_Renderer* m_renderer = nullptr;
     SDL_Texture* m_frame_texture = nullptr;
@@ -45,13 +47,34 @@ private:
     bool m_fullscreen = false;
     bool m_running = false;
     bool m_exit = false;
-    bool m_show_popup = false;
     bool m_show_about = false;
+    bool m_dialog_open = false;
+    // Frames run per displayed frame when fast forwarding, 0 runs as many as
+    // fit in the frame period
+    int m_fast_forward_speed = 4;
+    bool m_fast_forward = false;
+    // Rewind buffer size in MB, 0 disables it
+    uint32_t m_rewind_buffer_size = 32;
+    bool m_rewinding = false;
+    bool m_show_rewind_stats = false;
+    // Frames shown ahead of the emulated one to hide the game's input lag,
+    // 0 disables it
+    int m_run_ahead = 0;
+    bool m_show_frame_stats = false;
+    // Sound ring buffer size and device buffer size, in samples
+    long m_sound_capacity = 8192;
+    int m_sound_device_samples = 512;
+    bool m_show_sound_stats = false;
+    // Commands the emulation thread queue had no room for, sent first next frame
+    std::deque<EmulationThread::Command> m_pending_commands;
 
     bool init();
     void process_events();
     void on_keyboard_event(const SDL_KeyboardEvent& event);
     void on_window_event(const SDL_Event& event);
+    void send_command(const EmulationThread::Command& command);
+    void send_pending_commands();
+    void process_emulation_events();
     void render();
     void render_menubar();
     void render_exit_dialog();
@@ -61,6 +84,9 @@ private:
     void save_settings();
 
     void toggle_fullscreen();
+    void toggle_fast_forward();
+    void set_fast_forward_speed(int speed);
+    void set_run_ahead(int frames);
     void open_nes_file();
     void open_palette_file();
 };
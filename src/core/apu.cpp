@@ -1,6 +1,9 @@
 #include "apu.hpp"
 #include "system_bus.hpp"
+#include "scheduler.hpp"
 #include "logger.hpp"
+#include <algorithm>
+#include <cmath>
 
 APU::APU()
 {
@@ -18,7 +21,7 @@ void APU::set_system_bus(SystemBus* system_bus)
 bool APU::init()
 {
     m_apu.set_output(&m_buffer);
-    m_buffer.clock_rate(ClockRate);
+    m_buffer.clock_rate(m_clock_rate);
     if (m_buffer.set_sample_rate(SoundSampleRate))
     {
         LOG_FATAL("APU error, cannot set sample rate %u", SoundSampleRate);
@@ -32,26 +35,49 @@ void APU::reset()
 {
     m_apu.reset();
     m_buffer.clear();
+    m_state.frame_start = 0;
+    m_apu.save_state(&m_state.sound);
 }
 
-uint8_t APU::read()
+uint8_t APU::read(uint64_t cycle)
 {
-    blip_time_t time = clock();
-    return m_apu.read_status(time);
+    return m_apu.read_status(time(cycle));
 }
 
-void APU::write(uint16_t address, uint8_t data)
+void APU::write(uint64_t cycle, uint16_t address, uint8_t data)
 {
-    blip_time_t time = clock();
-    m_apu.write_register(time, address, data);
+    m_apu.write_register(time(cycle), address, data);
 }
 
-void APU::end_frame()
+void APU::end_frame(uint64_t cycle)
 {
-    m_time = 0;
-    m_frame_length ^= 1;
-    m_apu.end_frame(m_frame_length);
-    m_buffer.end_frame(m_frame_length);
+    const blip_time_t length = time(cycle);
+    m_apu.end_frame(length);
+    m_buffer.end_frame(length);
+    m_state.frame_start = cycle;
+    m_apu.save_state(&m_state.sound);
+}
+
+void APU::run_until(uint64_t cycle)
+{
+    m_apu.run_until(time(cycle));
+}
+
+bool APU::irq(uint64_t cycle) const
+{
+    return m_apu.earliest_irq(time(cycle)) <= time(cycle);
+}
+
+uint64_t APU::next_irq() const
+{
+    return cycle(m_apu.earliest_irq(0));
+}
+
+uint64_t APU::next_dmc_read() const
+{
+    // The sample byte is read once the DMC runs past the read time
+    const uint64_t read_cycle = cycle(m_apu.next_dmc_read_time());
+    return read_cycle == Scheduler::Never ? read_cycle : read_cycle + 1;
 }
 
 long APU::read_samples(blip_sample_t* buffer, long size)
@@ -59,7 +85,34 @@ long APU::read_samples(blip_sample_t* buffer, long size)
     return m_buffer.read_samples(buffer, size);
 }
 
-blip_time_t APU::clock()
+void APU::set_sample_rate_ratio(double ratio)
 {
-    return m_time += ClockTick;
+    // The buffer resamples from a lower clock rate to make more samples
+    const long clock_rate = std::lround(ClockRate / ratio);
+    if (clock_rate == m_clock_rate)
+        return;
+
+    m_clock_rate = clock_rate;
+    m_buffer.clock_rate(m_clock_rate);
+}
+
+void APU::save_state(State& state) const
+{
+    state = m_state;
+    m_buffer.save_state(&state.buffer);
+}
+
+void APU::load_state(const State& state)
+{
+    m_state = state;
+    m_apu.load_state(m_state.sound);
+    m_buffer.load_state(m_state.buffer);
+}
+
+uint64_t APU::cycle(blip_time_t time) const
+{
+    if (time == Nes_Apu::no_irq)
+        return Scheduler::Never;
+
+    return m_state.frame_start + std::max<blip_time_t>(time, 0);
 }
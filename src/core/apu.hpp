@@ -7,6 +7,19 @@ class SystemBus;
 
 class APU
 {
+public:
+    // Part of the machine state. Nes_Apu keeps its own state, it is copied
+    // here at the end of every frame and copied back when a state is loaded.
+    // The sound buffer keeps the tails of the last samples and its filter,
+    // they are copied when the state is saved so a loaded state sounds the
+    // same.
+    struct State
+    {
+        uint64_t frame_start = 0;
+        apu_state_t sound = {};
+        blip_buffer_state_t buffer = {};
+    };
+
 public:
     APU();
 
@@ -14,16 +27,31 @@ public:
     bool init();
 
     void reset();
-    uint8_t read();
-    void write(uint16_t address, uint8_t data);
-    void end_frame();
+    // Accesses are timed with the CPU cycle count
+    uint8_t read(uint64_t cycle);
+    void write(uint64_t cycle, uint16_t address, uint8_t data);
+    void end_frame(uint64_t cycle);
+
+    // Runs the DMC so its memory reads happen before the CPU can switch banks
+    void run_until(uint64_t cycle);
+    // The IRQ stays raised until $4015 is read or written
+    bool irq(uint64_t cycle) const;
+    // CPU cycles of the next IRQ and DMC read, Scheduler::Never if none
+    uint64_t next_irq() const;
+    uint64_t next_dmc_read() const;
 
     long samples_available() const { return m_buffer.samples_avail(); }
     long read_samples(blip_sample_t* buffer, long size);
+    // Samples made per emulated second relative to SoundSampleRate, takes
+    // effect on the next frame
+    void set_sample_rate_ratio(double ratio);
+
+    // Saved once the samples of the frame have been read, loading drops the
+    // samples not read
+    void save_state(State& state) const;
+    void load_state(const State& state);
 
-    static constexpr int ClockTick = 4;
     static constexpr long ClockRate = 1789773; // 1.789773 MHz
-    static constexpr long FrameLength = 29780;
     static constexpr long SoundSampleRate = 44100;
     static constexpr long SoundBufferSize = 4096;
 
@@ -31,8 +59,9 @@ private:
     SystemBus* m_system_bus = nullptr;
     Nes_Apu m_apu;
     Blip_Buffer m_buffer;
-    blip_time_t m_time = 0;
-    blip_time_t m_frame_length = FrameLength;
+    State m_state;
+    long m_clock_rate = ClockRate;
 
-    blip_time_t clock();
+    blip_time_t time(uint64_t cycle) const { return static_cast<blip_time_t>(cycle - m_state.frame_start); }
+    uint64_t cycle(blip_time_t time) const;
 };
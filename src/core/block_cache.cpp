@@ -0,0 +1,38 @@
+#include "block_cache.hpp"
+#include <algorithm>
+#include <utility>
+
+void BlockCache::reset(uint32_t rom_size)
+{
+    // The index is allocated with the first block, not at all when the
+    // cache is not used
+    m_rom_size = rom_size;
+    m_block_index.clear();
+    m_blocks.clear();
+}
+
+CodeBlock* BlockCache::find(uint32_t rom_offset)
+{
+    if (rom_offset >= m_block_index.size() || m_block_index[rom_offset] == NoBlock)
+        return nullptr;
+
+    return &m_blocks[m_block_index[rom_offset]];
+}
+
+CodeBlock* BlockCache::insert(uint32_t rom_offset, CodeBlock&& block)
+{
+    if (rom_offset >= m_block_index.size())
+        m_block_index.resize(std::max(m_rom_size, rom_offset + 1), NoBlock);
+
+    if (m_block_index[rom_offset] != NoBlock)
+    {
+        CodeBlock& existing = m_blocks[m_block_index[rom_offset]];
+        existing = std::move(block);
+        return &existing;
+    }
+
+    m_blocks.push_back(std::move(block));
+    m_block_index[rom_offset] = static_cast<uint32_t>(m_blocks.size() - 1);
+
+    return &m_blocks.back();
+}
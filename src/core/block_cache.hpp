@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class CPU;
+struct JitState;
+
+// Instruction decoded from PRG ROM, the operand bytes are already read and
+// relative branches already hold their target address
+struct DecodedInstruction
+{
+    static constexpr uint32_t EndOfBlock = 0x10000;
+
+    void (*execute)(CPU& cpu, uint16_t operand) = nullptr;
+    uint32_t address = EndOfBlock;
+    uint16_t operand = 0;
+    uint8_t opcode = 0;
+};
+
+// Straight-line code, ends with a jump, a branch, a return or at the end of
+// the memory map page it starts in. The last entry is an EndOfBlock marker
+// which never matches the program counter.
+struct CodeBlock
+{
+    std::vector<DecodedInstruction> instructions;
+    uint16_t address = 0;
+
+    // Native code, compiled once the block has run often enough
+    void (*native)(JitState* state) = nullptr;
+    uint32_t executions = 0;
+    uint16_t max_cycles = 0;
+    bool native_failed = false;
+};
+
+// Decoded blocks keyed by their PRG ROM offset. ROM never changes so the
+// blocks stay valid across bank switches as long as the bank is mapped at
+// the same CPU address, branch targets are absolute.
+class BlockCache
+{
+public:
+    static constexpr uint32_t NoBlock = UINT32_MAX;
+
+    void reset(uint32_t rom_size);
+    CodeBlock* find(uint32_t rom_offset);
+    CodeBlock* insert(uint32_t rom_offset, CodeBlock&& block); // Replaces the block already at rom_offset
+    size_t block_count() const { return m_blocks.size(); }
+
+private:
+    uint32_t m_rom_size = 0;
+    std::vector<uint32_t> m_block_index;
+    std::deque<CodeBlock> m_blocks; // Stable addresses, the CPU keeps a pointer in the current block
+};
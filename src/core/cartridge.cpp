@@ -17,9 +17,9 @@ bool Cartridge::load_from_file(const std::string& file_path)
 {
     try
     {
-        NesRom rom(file_path);
+        std::shared_ptr<const RomImage> rom = RomImage::load(file_path);
 
-        switch (rom.mapper_id())
+        switch (rom->mapper_id())
         {
         case MAPPER_NROM:
             m_mapper = std::make_unique<Mapper_NROM>(rom);
@@ -42,10 +42,13 @@ bool Cartridge::load_from_file(const std::string& file_path)
             break;
 
         default:
-            LOG_ERROR("Unsupported mapper id %u", rom.mapper_id());
+            LOG_ERROR("Unsupported mapper id %u", rom->mapper_id());
             return false;
         }
 
+        if (m_memory_map)
+            m_mapper->set_memory_map(m_memory_map);
+
         return true;
     }
     catch (std::runtime_error e)
@@ -103,3 +106,34 @@ void Cartridge::scanline()
     if (m_mapper)
         m_mapper->scanline();
 }
+
+uint32_t Cartridge::scanlines_until_irq()
+{
+    if (!m_mapper)
+        return Mapper::NoIrq;
+    return m_mapper->scanlines_until_irq();
+}
+
+uint16_t Cartridge::mapper_id() const
+{
+    assert(m_mapper);
+    return m_mapper->id();
+}
+
+uint32_t Cartridge::rom_checksum() const
+{
+    assert(m_mapper);
+    return m_mapper->rom_checksum();
+}
+
+const Mapper::State& Cartridge::state() const
+{
+    assert(m_mapper);
+    return m_mapper->state();
+}
+
+bool Cartridge::load_state(const Mapper::State& state)
+{
+    assert(m_mapper);
+    return m_mapper->load_state(state);
+}
@@ -11,6 +11,7 @@ class Cartridge
 {
 public:
     void reset();
+    void set_memory_map(MemoryMap* memory_map) { m_memory_map = memory_map; }
     bool load_from_file(const std::string& file_path);
     bool loaded() const { return m_mapper != nullptr; }
     MirroringMode mirroring_mode();
@@ -19,11 +20,19 @@ public:
     void cpu_write(uint16_t address, uint8_t data);
     uint8_t ppu_read(uint16_t address);
     void ppu_write(uint16_t address, uint8_t data);
+    const uint8_t* chr_tile(uint16_t address) { return m_mapper->chr_tile(address); }
 
     bool irq();
     void irq_clear();
     void scanline();
+    uint32_t scanlines_until_irq();
+
+    uint16_t mapper_id() const;
+    uint32_t rom_checksum() const;
+    const Mapper::State& state() const;
+    bool load_state(const Mapper::State& state);
 
 private:
     std::unique_ptr<Mapper> m_mapper = nullptr;
+    MemoryMap* m_memory_map = nullptr;
 };
@@ -1,7 +1,12 @@
 #include "controller.hpp"
-#include "input_manager.hpp"
+#include "input_source.hpp"
 #include "logger.hpp"
 
+void Controller::latch_buttons()
+{
+    m_input_source.poll_buttons_state(m_state.buttons, ControllerCount);
+}
+
 uint8_t Controller::read(uint8_t index)
 {
     if (index >= ControllerCount)
@@ -10,22 +15,22 @@ uint8_t Controller::read(uint8_t index)
         return 0;
     }
 
-    if (m_strobe)
-        return 0x40 | (m_input_manager.get_buttons_state(index) & 0x1);
+    if (m_state.strobe)
+        return 0x40 | (m_state.buttons[index] & 0x1);
 
-    uint8_t value = 0x40 | (m_registers[index] & 0x1);
-    m_registers[index] = 0x80 | (m_registers[index] >> 1);
+    uint8_t value = 0x40 | (m_state.registers[index] & 0x1);
+    m_state.registers[index] = 0x80 | (m_state.registers[index] >> 1);
 
     return value;
 }
 
 void Controller::write(uint8_t data)
 {
-    if (m_strobe && !(data & 0x1))
+    if (m_state.strobe && !(data & 0x1))
     {
         for (int i = 0; i < ControllerCount; i++)
-            m_registers[i] = m_input_manager.get_buttons_state(i);
+            m_state.registers[i] = m_state.buttons[i];
     }
 
-    m_strobe = (data & 0x1);
+    m_state.strobe = (data & 0x1);
 }
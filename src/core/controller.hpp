@@ -2,22 +2,34 @@
 
 #include <cstdint>
 
-class InputManager;
+class InputSource;
 
 class Controller
 {
 public:
-    Controller(InputManager& input_manager):
-        m_input_manager(input_manager)
+    static constexpr uint8_t ControllerCount = 2;
+
+    // Latched buttons and shift registers, part of the machine state
+    struct State
+    {
+        uint8_t buttons[ControllerCount] = { 0, 0 };
+        uint8_t registers[ControllerCount] = { 0, 0 };
+        bool strobe = false;
+    };
+
+public:
+    Controller(InputSource& input_source):
+        m_input_source(input_source)
     {}
 
+    const State& state() const { return m_state; }
+    void load_state(const State& state) { m_state = state; }
+
+    void latch_buttons();
     uint8_t read(uint8_t index);
     void write(uint8_t data);
 
-    static constexpr uint8_t ControllerCount = 2;
-
 private:
-    InputManager& m_input_manager;
-    uint8_t m_registers[ControllerCount] = { 0, 0 };
-    bool m_strobe = false;
+    InputSource& m_input_source;
+    State m_state;
 };
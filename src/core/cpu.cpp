@@ -1,278 +1,305 @@
 #include "cpu.hpp"
 #include "system_bus.hpp"
 #include "logger.hpp"
+#include <algorithm>
+#include <utility>
+
+// Opcode, mnemonic, addressing mode, instruction, addressing mode type, cycles, class
+// BRK cycle count is added by the interrupt. The class is what the block cache,
+// the JIT and the idle loop detection know of the instruction. Of the unofficial
+// ones only NOP is classified beyond the block end and the page crossing cycle.
+#define CPU_INSTRUCTIONS(X)                                                                             \
+    X(0x00, BRK, read_implied,          op_brk, AM_IMPLIED,            0, INS_ENDS_BLOCK)                \
+    X(0x01, ORA, read_indexed_indirect, op_ora, AM_INDEXED_INDIRECT,   6, INS_READ | INS_PAGE_CROSS)     \
+    X(0x02, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0x03, SLO, read_indexed_indirect, op_slo, AM_INDEXED_INDIRECT,   8, INS_NONE)                      \
+    X(0x04, NOP, read_zeropage,         op_nop, AM_ZEROPAGE,           3, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x05, ORA, read_zeropage,         op_ora, AM_ZEROPAGE,           3, INS_READ | INS_PAGE_CROSS)     \
+    X(0x06, ASL, read_zeropage,         op_asl, AM_ZEROPAGE,           5, INS_MODIFY)                    \
+    X(0x07, SLO, read_zeropage,         op_slo, AM_ZEROPAGE,           5, INS_NONE)                      \
+    X(0x08, PHP, read_implied,          op_php, AM_IMPLIED,            3, INS_STACK)                     \
+    X(0x09, ORA, read_immediate,        op_ora, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0x0A, ASL, read_implied,          op_asl, AM_IMPLIED,            2, INS_MODIFY)                    \
+    X(0x0B, ANC, read_immediate,        op_anc, AM_IMMEDIATE,          2, INS_NONE)                      \
+    X(0x0C, NOP, read_absolute,         op_nop, AM_ABSOLUTE,           4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x0D, ORA, read_absolute,         op_ora, AM_ABSOLUTE,           4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x0E, ASL, read_absolute,         op_asl, AM_ABSOLUTE,           6, INS_MODIFY)                    \
+    X(0x0F, SLO, read_absolute,         op_slo, AM_ABSOLUTE,           6, INS_NONE)                      \
+    X(0x10, BPL, read_relative,         op_bpl, AM_RELATIVE,           2, INS_ENDS_BLOCK)                \
+    X(0x11, ORA, read_indirect_indexed, op_ora, AM_INDIRECT_INDEXED,   5, INS_READ | INS_PAGE_CROSS)     \
+    X(0x12, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0x13, SLO, read_indirect_indexed, op_slo, AM_INDIRECT_INDEXED,   8, INS_NONE)                      \
+    X(0x14, NOP, read_zeropage_x,       op_nop, AM_ZEROPAGE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x15, ORA, read_zeropage_x,       op_ora, AM_ZEROPAGE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x16, ASL, read_zeropage_x,       op_asl, AM_ZEROPAGE_INDEXED_X, 6, INS_MODIFY)                    \
+    X(0x17, SLO, read_zeropage_x,       op_slo, AM_ZEROPAGE_INDEXED_X, 6, INS_NONE)                      \
+    X(0x18, CLC, read_implied,          op_clc, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0x19, ORA, read_absolute_y,       op_ora, AM_ABSOLUTE_INDEXED_Y, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x1A, NOP, read_implied,          op_nop, AM_IMPLIED,            2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x1B, SLO, read_absolute_y,       op_slo, AM_ABSOLUTE_INDEXED_Y, 7, INS_NONE)                      \
+    X(0x1C, NOP, read_absolute_x,       op_nop, AM_ABSOLUTE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x1D, ORA, read_absolute_x,       op_ora, AM_ABSOLUTE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x1E, ASL, read_absolute_x,       op_asl, AM_ABSOLUTE_INDEXED_X, 7, INS_MODIFY)                    \
+    X(0x1F, SLO, read_absolute_x,       op_slo, AM_ABSOLUTE_INDEXED_X, 7, INS_NONE)                      \
+    X(0x20, JSR, read_absolute,         op_jsr, AM_ABSOLUTE,           6, INS_ENDS_BLOCK)                \
+    X(0x21, AND, read_indexed_indirect, op_and, AM_INDEXED_INDIRECT,   6, INS_READ | INS_PAGE_CROSS)     \
+    X(0x22, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0x23, RLA, read_indexed_indirect, op_rla, AM_INDEXED_INDIRECT,   8, INS_NONE)                      \
+    X(0x24, BIT, read_zeropage,         op_bit, AM_ZEROPAGE,           3, INS_READ)                      \
+    X(0x25, AND, read_zeropage,         op_and, AM_ZEROPAGE,           3, INS_READ | INS_PAGE_CROSS)     \
+    X(0x26, ROL, read_zeropage,         op_rol, AM_ZEROPAGE,           5, INS_MODIFY)                    \
+    X(0x27, RLA, read_zeropage,         op_rla, AM_ZEROPAGE,           5, INS_NONE)                      \
+    X(0x28, PLP, read_implied,          op_plp, AM_IMPLIED,            4, INS_STACK)                     \
+    X(0x29, AND, read_immediate,        op_and, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0x2A, ROL, read_implied,          op_rol, AM_IMPLIED,            2, INS_MODIFY)                    \
+    X(0x2B, ANC, read_immediate,        op_anc, AM_IMMEDIATE,          2, INS_NONE)                      \
+    X(0x2C, BIT, read_absolute,         op_bit, AM_ABSOLUTE,           4, INS_READ)                      \
+    X(0x2D, AND, read_absolute,         op_and, AM_ABSOLUTE,           4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x2E, ROL, read_absolute,         op_rol, AM_ABSOLUTE,           6, INS_MODIFY)                    \
+    X(0x2F, RLA, read_absolute,         op_rla, AM_ABSOLUTE,           6, INS_NONE)                      \
+    X(0x30, BMI, read_relative,         op_bmi, AM_RELATIVE,           2, INS_ENDS_BLOCK)                \
+    X(0x31, AND, read_indirect_indexed, op_and, AM_INDIRECT_INDEXED,   5, INS_READ | INS_PAGE_CROSS)     \
+    X(0x32, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0x33, RLA, read_indirect_indexed, op_rla, AM_INDIRECT_INDEXED,   8, INS_NONE)                      \
+    X(0x34, NOP, read_zeropage_x,       op_nop, AM_ZEROPAGE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x35, AND, read_zeropage_x,       op_and, AM_ZEROPAGE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x36, ROL, read_zeropage_x,       op_rol, AM_ZEROPAGE_INDEXED_X, 6, INS_MODIFY)                    \
+    X(0x37, RLA, read_zeropage_x,       op_rla, AM_ZEROPAGE_INDEXED_X, 6, INS_NONE)                      \
+    X(0x38, SEC, read_implied,          op_sec, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0x39, AND, read_absolute_y,       op_and, AM_ABSOLUTE_INDEXED_Y, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x3A, NOP, read_implied,          op_nop, AM_IMPLIED,            2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x3B, RLA, read_absolute_y,       op_rla, AM_ABSOLUTE_INDEXED_Y, 7, INS_NONE)                      \
+    X(0x3C, NOP, read_absolute_x,       op_nop, AM_ABSOLUTE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x3D, AND, read_absolute_x,       op_and, AM_ABSOLUTE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x3E, ROL, read_absolute_x,       op_rol, AM_ABSOLUTE_INDEXED_X, 7, INS_MODIFY)                    \
+    X(0x3F, RLA, read_absolute_x,       op_rla, AM_ABSOLUTE_INDEXED_X, 7, INS_NONE)                      \
+    X(0x40, RTI, read_implied,          op_rti, AM_IMPLIED,            6, INS_ENDS_BLOCK)                \
+    X(0x41, EOR, read_indexed_indirect, op_eor, AM_INDEXED_INDIRECT,   6, INS_READ | INS_PAGE_CROSS)     \
+    X(0x42, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0x43, SRE, read_indexed_indirect, op_sre, AM_INDEXED_INDIRECT,   8, INS_NONE)                      \
+    X(0x44, NOP, read_zeropage,         op_nop, AM_ZEROPAGE,           3, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x45, EOR, read_zeropage,         op_eor, AM_ZEROPAGE,           3, INS_READ | INS_PAGE_CROSS)     \
+    X(0x46, LSR, read_zeropage,         op_lsr, AM_ZEROPAGE,           5, INS_MODIFY)                    \
+    X(0x47, SRE, read_zeropage,         op_sre, AM_ZEROPAGE,           5, INS_NONE)                      \
+    X(0x48, PHA, read_implied,          op_pha, AM_IMPLIED,            3, INS_STACK)                     \
+    X(0x49, EOR, read_immediate,        op_eor, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0x4A, LSR, read_implied,          op_lsr, AM_IMPLIED,            2, INS_MODIFY)                    \
+    X(0x4B, ALR, read_immediate,        op_alr, AM_IMMEDIATE,          2, INS_NONE)                      \
+    X(0x4C, JMP, read_absolute,         op_jmp, AM_ABSOLUTE,           3, INS_ENDS_BLOCK)                \
+    X(0x4D, EOR, read_absolute,         op_eor, AM_ABSOLUTE,           4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x4E, LSR, read_absolute,         op_lsr, AM_ABSOLUTE,           6, INS_MODIFY)                    \
+    X(0x4F, SRE, read_absolute,         op_sre, AM_ABSOLUTE,           6, INS_NONE)                      \
+    X(0x50, BVC, read_relative,         op_bvc, AM_RELATIVE,           2, INS_ENDS_BLOCK)                \
+    X(0x51, EOR, read_indirect_indexed, op_eor, AM_INDIRECT_INDEXED,   5, INS_READ | INS_PAGE_CROSS)     \
+    X(0x52, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0x53, SRE, read_indirect_indexed, op_sre, AM_INDIRECT_INDEXED,   8, INS_NONE)                      \
+    X(0x54, NOP, read_zeropage_x,       op_nop, AM_ZEROPAGE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x55, EOR, read_zeropage_x,       op_eor, AM_ZEROPAGE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x56, LSR, read_zeropage_x,       op_lsr, AM_ZEROPAGE_INDEXED_X, 6, INS_MODIFY)                    \
+    X(0x57, SRE, read_zeropage_x,       op_sre, AM_ZEROPAGE_INDEXED_X, 6, INS_NONE)                      \
+    X(0x58, CLI, read_implied,          op_cli, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0x59, EOR, read_absolute_y,       op_eor, AM_ABSOLUTE_INDEXED_Y, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x5A, NOP, read_implied,          op_nop, AM_IMPLIED,            2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x5B, SRE, read_absolute_y,       op_sre, AM_ABSOLUTE_INDEXED_Y, 7, INS_NONE)                      \
+    X(0x5C, NOP, read_absolute_x,       op_nop, AM_ABSOLUTE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x5D, EOR, read_absolute_x,       op_eor, AM_ABSOLUTE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x5E, LSR, read_absolute_x,       op_lsr, AM_ABSOLUTE_INDEXED_X, 7, INS_MODIFY)                    \
+    X(0x5F, SRE, read_absolute_x,       op_sre, AM_ABSOLUTE_INDEXED_X, 7, INS_NONE)                      \
+    X(0x60, RTS, read_implied,          op_rts, AM_IMPLIED,            6, INS_ENDS_BLOCK)                \
+    X(0x61, ADC, read_indexed_indirect, op_adc, AM_INDEXED_INDIRECT,   6, INS_READ | INS_PAGE_CROSS)     \
+    X(0x62, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0x63, RRA, read_indexed_indirect, op_rra, AM_INDEXED_INDIRECT,   8, INS_NONE)                      \
+    X(0x64, NOP, read_zeropage,         op_nop, AM_ZEROPAGE,           3, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x65, ADC, read_zeropage,         op_adc, AM_ZEROPAGE,           3, INS_READ | INS_PAGE_CROSS)     \
+    X(0x66, ROR, read_zeropage,         op_ror, AM_ZEROPAGE,           5, INS_MODIFY)                    \
+    X(0x67, RRA, read_zeropage,         op_rra, AM_ZEROPAGE,           5, INS_NONE)                      \
+    X(0x68, PLA, read_implied,          op_pla, AM_IMPLIED,            4, INS_STACK)                     \
+    X(0x69, ADC, read_immediate,        op_adc, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0x6A, ROR, read_implied,          op_ror, AM_IMPLIED,            2, INS_MODIFY)                    \
+    X(0x6B, ARR, read_immediate,        op_arr, AM_IMMEDIATE,          2, INS_NONE)                      \
+    X(0x6C, JMP, read_indirect,         op_jmp, AM_INDIRECT,           5, INS_ENDS_BLOCK)                \
+    X(0x6D, ADC, read_absolute,         op_adc, AM_ABSOLUTE,           4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x6E, ROR, read_absolute,         op_ror, AM_ABSOLUTE,           6, INS_MODIFY)                    \
+    X(0x6F, RRA, read_absolute,         op_rra, AM_ABSOLUTE,           6, INS_NONE)                      \
+    X(0x70, BVS, read_relative,         op_bvs, AM_RELATIVE,           2, INS_ENDS_BLOCK)                \
+    X(0x71, ADC, read_indirect_indexed, op_adc, AM_INDIRECT_INDEXED,   5, INS_READ | INS_PAGE_CROSS)     \
+    X(0x72, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0x73, RRA, read_indirect_indexed, op_rra, AM_INDIRECT_INDEXED,   8, INS_NONE)                      \
+    X(0x74, NOP, read_zeropage_x,       op_nop, AM_ZEROPAGE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x75, ADC, read_zeropage_x,       op_adc, AM_ZEROPAGE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x76, ROR, read_zeropage_x,       op_ror, AM_ZEROPAGE_INDEXED_X, 6, INS_MODIFY)                    \
+    X(0x77, RRA, read_zeropage_x,       op_rra, AM_ZEROPAGE_INDEXED_X, 6, INS_NONE)                      \
+    X(0x78, SEI, read_implied,          op_sei, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0x79, ADC, read_absolute_y,       op_adc, AM_ABSOLUTE_INDEXED_Y, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x7A, NOP, read_implied,          op_nop, AM_IMPLIED,            2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x7B, RRA, read_absolute_y,       op_rra, AM_ABSOLUTE_INDEXED_Y, 7, INS_NONE)                      \
+    X(0x7C, NOP, read_absolute_x,       op_nop, AM_ABSOLUTE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x7D, ADC, read_absolute_x,       op_adc, AM_ABSOLUTE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0x7E, ROR, read_absolute_x,       op_ror, AM_ABSOLUTE_INDEXED_X, 7, INS_MODIFY)                    \
+    X(0x7F, RRA, read_absolute_x,       op_rra, AM_ABSOLUTE_INDEXED_X, 7, INS_NONE)                      \
+    X(0x80, NOP, read_immediate,        op_nop, AM_IMMEDIATE,          2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x81, STA, read_indexed_indirect, op_sta, AM_INDEXED_INDIRECT,   6, INS_STORE)                     \
+    X(0x82, NOP, read_immediate,        op_nop, AM_IMMEDIATE,          2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x83, SAX, read_indexed_indirect, op_sax, AM_INDEXED_INDIRECT,   6, INS_NONE)                      \
+    X(0x84, STY, read_zeropage,         op_sty, AM_ZEROPAGE,           3, INS_STORE)                     \
+    X(0x85, STA, read_zeropage,         op_sta, AM_ZEROPAGE,           3, INS_STORE)                     \
+    X(0x86, STX, read_zeropage,         op_stx, AM_ZEROPAGE,           3, INS_STORE)                     \
+    X(0x87, SAX, read_zeropage,         op_sax, AM_ZEROPAGE,           3, INS_NONE)                      \
+    X(0x88, DEY, read_implied,          op_dey, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0x89, NOP, read_immediate,        op_nop, AM_IMMEDIATE,          2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0x8A, TXA, read_implied,          op_txa, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0x8B, XAA, read_immediate,        op_xaa, AM_IMMEDIATE,          2, INS_NONE)                      \
+    X(0x8C, STY, read_absolute,         op_sty, AM_ABSOLUTE,           4, INS_STORE)                     \
+    X(0x8D, STA, read_absolute,         op_sta, AM_ABSOLUTE,           4, INS_STORE)                     \
+    X(0x8E, STX, read_absolute,         op_stx, AM_ABSOLUTE,           4, INS_STORE)                     \
+    X(0x8F, SAX, read_absolute,         op_sax, AM_ABSOLUTE,           4, INS_NONE)                      \
+    X(0x90, BCC, read_relative,         op_bcc, AM_RELATIVE,           2, INS_ENDS_BLOCK)                \
+    X(0x91, STA, read_indirect_indexed, op_sta, AM_INDIRECT_INDEXED,   6, INS_STORE)                     \
+    X(0x92, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0x93, AHX, read_indirect_indexed, op_ahx, AM_INDIRECT_INDEXED,   6, INS_NONE)                      \
+    X(0x94, STY, read_zeropage_x,       op_sty, AM_ZEROPAGE_INDEXED_X, 4, INS_STORE)                     \
+    X(0x95, STA, read_zeropage_x,       op_sta, AM_ZEROPAGE_INDEXED_X, 4, INS_STORE)                     \
+    X(0x96, STX, read_zeropage_y,       op_stx, AM_ZEROPAGE_INDEXED_Y, 4, INS_STORE)                     \
+    X(0x97, SAX, read_zeropage_y,       op_sax, AM_ZEROPAGE_INDEXED_Y, 4, INS_NONE)                      \
+    X(0x98, TYA, read_implied,          op_tya, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0x99, STA, read_absolute_y,       op_sta, AM_ABSOLUTE_INDEXED_Y, 5, INS_STORE)                     \
+    X(0x9A, TXS, read_implied,          op_txs, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0x9B, TAS, read_absolute_y,       op_tas, AM_ABSOLUTE_INDEXED_Y, 5, INS_NONE)                      \
+    X(0x9C, SHY, read_absolute_x,       op_shy, AM_ABSOLUTE_INDEXED_X, 5, INS_NONE)                      \
+    X(0x9D, STA, read_absolute_x,       op_sta, AM_ABSOLUTE_INDEXED_X, 5, INS_STORE)                     \
+    X(0x9E, SHX, read_absolute_y,       op_shx, AM_ABSOLUTE_INDEXED_Y, 5, INS_NONE)                      \
+    X(0x9F, AHX, read_absolute_y,       op_ahx, AM_ABSOLUTE_INDEXED_Y, 5, INS_NONE)                      \
+    X(0xA0, LDY, read_immediate,        op_ldy, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0xA1, LDA, read_indexed_indirect, op_lda, AM_INDEXED_INDIRECT,   6, INS_READ | INS_PAGE_CROSS)     \
+    X(0xA2, LDX, read_immediate,        op_ldx, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0xA3, LAX, read_indexed_indirect, op_lax, AM_INDEXED_INDIRECT,   6, INS_PAGE_CROSS)                \
+    X(0xA4, LDY, read_zeropage,         op_ldy, AM_ZEROPAGE,           3, INS_READ | INS_PAGE_CROSS)     \
+    X(0xA5, LDA, read_zeropage,         op_lda, AM_ZEROPAGE,           3, INS_READ | INS_PAGE_CROSS)     \
+    X(0xA6, LDX, read_zeropage,         op_ldx, AM_ZEROPAGE,           3, INS_READ | INS_PAGE_CROSS)     \
+    X(0xA7, LAX, read_zeropage,         op_lax, AM_ZEROPAGE,           3, INS_PAGE_CROSS)                \
+    X(0xA8, TAY, read_implied,          op_tay, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0xA9, LDA, read_immediate,        op_lda, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0xAA, TAX, read_implied,          op_tax, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0xAB, LAX, read_immediate,        op_lax, AM_IMMEDIATE,          2, INS_PAGE_CROSS)                \
+    X(0xAC, LDY, read_absolute,         op_ldy, AM_ABSOLUTE,           4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xAD, LDA, read_absolute,         op_lda, AM_ABSOLUTE,           4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xAE, LDX, read_absolute,         op_ldx, AM_ABSOLUTE,           4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xAF, LAX, read_absolute,         op_lax, AM_ABSOLUTE,           4, INS_PAGE_CROSS)                \
+    X(0xB0, BCS, read_relative,         op_bcs, AM_RELATIVE,           2, INS_ENDS_BLOCK)                \
+    X(0xB1, LDA, read_indirect_indexed, op_lda, AM_INDIRECT_INDEXED,   5, INS_READ | INS_PAGE_CROSS)     \
+    X(0xB2, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0xB3, LAX, read_indirect_indexed, op_lax, AM_INDIRECT_INDEXED,   5, INS_PAGE_CROSS)                \
+    X(0xB4, LDY, read_zeropage_x,       op_ldy, AM_ZEROPAGE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xB5, LDA, read_zeropage_x,       op_lda, AM_ZEROPAGE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xB6, LDX, read_zeropage_y,       op_ldx, AM_ZEROPAGE_INDEXED_Y, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xB7, LAX, read_zeropage_y,       op_lax, AM_ZEROPAGE_INDEXED_Y, 4, INS_PAGE_CROSS)                \
+    X(0xB8, CLV, read_implied,          op_clv, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0xB9, LDA, read_absolute_y,       op_lda, AM_ABSOLUTE_INDEXED_Y, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xBA, TSX, read_implied,          op_tsx, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0xBB, LAS, read_absolute_y,       op_las, AM_ABSOLUTE_INDEXED_Y, 4, INS_PAGE_CROSS)                \
+    X(0xBC, LDY, read_absolute_x,       op_ldy, AM_ABSOLUTE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xBD, LDA, read_absolute_x,       op_lda, AM_ABSOLUTE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xBE, LDX, read_absolute_y,       op_ldx, AM_ABSOLUTE_INDEXED_Y, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xBF, LAX, read_absolute_y,       op_lax, AM_ABSOLUTE_INDEXED_Y, 4, INS_PAGE_CROSS)                \
+    X(0xC0, CPY, read_immediate,        op_cpy, AM_IMMEDIATE,          2, INS_READ)                      \
+    X(0xC1, CMP, read_indexed_indirect, op_cmp, AM_INDEXED_INDIRECT,   6, INS_READ | INS_PAGE_CROSS)     \
+    X(0xC2, NOP, read_immediate,        op_nop, AM_IMMEDIATE,          2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0xC3, DCP, read_indexed_indirect, op_dcp, AM_INDEXED_INDIRECT,   8, INS_NONE)                      \
+    X(0xC4, CPY, read_zeropage,         op_cpy, AM_ZEROPAGE,           3, INS_READ)                      \
+    X(0xC5, CMP, read_zeropage,         op_cmp, AM_ZEROPAGE,           3, INS_READ | INS_PAGE_CROSS)     \
+    X(0xC6, DEC, read_zeropage,         op_dec, AM_ZEROPAGE,           5, INS_MODIFY)                    \
+    X(0xC7, DCP, read_zeropage,         op_dcp, AM_ZEROPAGE,           5, INS_NONE)                      \
+    X(0xC8, INY, read_implied,          op_iny, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0xC9, CMP, read_immediate,        op_cmp, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0xCA, DEX, read_implied,          op_dex, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0xCB, AXS, read_immediate,        op_axs, AM_IMMEDIATE,          2, INS_NONE)                      \
+    X(0xCC, CPY, read_absolute,         op_cpy, AM_ABSOLUTE,           4, INS_READ)                      \
+    X(0xCD, CMP, read_absolute,         op_cmp, AM_ABSOLUTE,           4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xCE, DEC, read_absolute,         op_dec, AM_ABSOLUTE,           6, INS_MODIFY)                    \
+    X(0xCF, DCP, read_absolute,         op_dcp, AM_ABSOLUTE,           6, INS_NONE)                      \
+    X(0xD0, BNE, read_relative,         op_bne, AM_RELATIVE,           2, INS_ENDS_BLOCK)                \
+    X(0xD1, CMP, read_indirect_indexed, op_cmp, AM_INDIRECT_INDEXED,   5, INS_READ | INS_PAGE_CROSS)     \
+    X(0xD2, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0xD3, DCP, read_indirect_indexed, op_dcp, AM_INDIRECT_INDEXED,   8, INS_NONE)                      \
+    X(0xD4, NOP, read_zeropage_x,       op_nop, AM_ZEROPAGE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0xD5, CMP, read_zeropage_x,       op_cmp, AM_ZEROPAGE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xD6, DEC, read_zeropage_x,       op_dec, AM_ZEROPAGE_INDEXED_X, 6, INS_MODIFY)                    \
+    X(0xD7, DCP, read_zeropage_x,       op_dcp, AM_ZEROPAGE_INDEXED_X, 6, INS_NONE)                      \
+    X(0xD8, CLD, read_implied,          op_cld, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0xD9, CMP, read_absolute_y,       op_cmp, AM_ABSOLUTE_INDEXED_Y, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xDA, NOP, read_implied,          op_nop, AM_IMPLIED,            2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0xDB, DCP, read_absolute_y,       op_dcp, AM_ABSOLUTE_INDEXED_Y, 7, INS_NONE)                      \
+    X(0xDC, NOP, read_absolute_x,       op_nop, AM_ABSOLUTE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0xDD, CMP, read_absolute_x,       op_cmp, AM_ABSOLUTE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xDE, DEC, read_absolute_x,       op_dec, AM_ABSOLUTE_INDEXED_X, 7, INS_MODIFY)                    \
+    X(0xDF, DCP, read_absolute_x,       op_dcp, AM_ABSOLUTE_INDEXED_X, 7, INS_NONE)                      \
+    X(0xE0, CPX, read_immediate,        op_cpx, AM_IMMEDIATE,          2, INS_READ)                      \
+    X(0xE1, SBC, read_indexed_indirect, op_sbc, AM_INDEXED_INDIRECT,   6, INS_READ | INS_PAGE_CROSS)     \
+    X(0xE2, NOP, read_immediate,        op_nop, AM_IMMEDIATE,          2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0xE3, ISC, read_indexed_indirect, op_isc, AM_INDEXED_INDIRECT,   8, INS_NONE)                      \
+    X(0xE4, CPX, read_zeropage,         op_cpx, AM_ZEROPAGE,           3, INS_READ)                      \
+    X(0xE5, SBC, read_zeropage,         op_sbc, AM_ZEROPAGE,           3, INS_READ | INS_PAGE_CROSS)     \
+    X(0xE6, INC, read_zeropage,         op_inc, AM_ZEROPAGE,           5, INS_MODIFY)                    \
+    X(0xE7, ISC, read_zeropage,         op_isc, AM_ZEROPAGE,           5, INS_NONE)                      \
+    X(0xE8, INX, read_implied,          op_inx, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0xE9, SBC, read_immediate,        op_sbc, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0xEA, NOP, read_implied,          op_nop, AM_IMPLIED,            2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0xEB, SBC, read_immediate,        op_sbc, AM_IMMEDIATE,          2, INS_READ | INS_PAGE_CROSS)     \
+    X(0xEC, CPX, read_absolute,         op_cpx, AM_ABSOLUTE,           4, INS_READ)                      \
+    X(0xED, SBC, read_absolute,         op_sbc, AM_ABSOLUTE,           4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xEE, INC, read_absolute,         op_inc, AM_ABSOLUTE,           6, INS_MODIFY)                    \
+    X(0xEF, ISC, read_absolute,         op_isc, AM_ABSOLUTE,           6, INS_NONE)                      \
+    X(0xF0, BEQ, read_relative,         op_beq, AM_RELATIVE,           2, INS_ENDS_BLOCK)                \
+    X(0xF1, SBC, read_indirect_indexed, op_sbc, AM_INDIRECT_INDEXED,   5, INS_READ | INS_PAGE_CROSS)     \
+    X(0xF2, HLT, read_implied,          op_hlt, AM_IMPLIED,            2, INS_ENDS_BLOCK)                \
+    X(0xF3, ISC, read_indirect_indexed, op_isc, AM_INDIRECT_INDEXED,   8, INS_NONE)                      \
+    X(0xF4, NOP, read_zeropage_x,       op_nop, AM_ZEROPAGE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0xF5, SBC, read_zeropage_x,       op_sbc, AM_ZEROPAGE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xF6, INC, read_zeropage_x,       op_inc, AM_ZEROPAGE_INDEXED_X, 6, INS_MODIFY)                    \
+    X(0xF7, ISC, read_zeropage_x,       op_isc, AM_ZEROPAGE_INDEXED_X, 6, INS_NONE)                      \
+    X(0xF8, SED, read_implied,          op_sed, AM_IMPLIED,            2, INS_REGISTER)                  \
+    X(0xF9, SBC, read_absolute_y,       op_sbc, AM_ABSOLUTE_INDEXED_Y, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xFA, NOP, read_implied,          op_nop, AM_IMPLIED,            2, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0xFB, ISC, read_absolute_y,       op_isc, AM_ABSOLUTE_INDEXED_Y, 7, INS_NONE)                      \
+    X(0xFC, NOP, read_absolute_x,       op_nop, AM_ABSOLUTE_INDEXED_X, 4, INS_REGISTER | INS_PAGE_CROSS) \
+    X(0xFD, SBC, read_absolute_x,       op_sbc, AM_ABSOLUTE_INDEXED_X, 4, INS_READ | INS_PAGE_CROSS)     \
+    X(0xFE, INC, read_absolute_x,       op_inc, AM_ABSOLUTE_INDEXED_X, 7, INS_MODIFY)                    \
+    X(0xFF, ISC, read_absolute_x,       op_isc, AM_ABSOLUTE_INDEXED_X, 7, INS_NONE)
+
+const CPU::InstructionInfo CPU::m_instruction_info[256] = {
+#define CPU_INSTRUCTION_INFO(opcode, mnemonic, read_address, execute, addressing_mode, cycles, flags) \
+    { #mnemonic, CPU::Mnemonic::mnemonic, CPU::addressing_mode, cycles, flags },
+    CPU_INSTRUCTIONS(CPU_INSTRUCTION_INFO)
+#undef CPU_INSTRUCTION_INFO
+};
 
-CPU::Instruction CPU::m_instruction_table[256] = {
-    { &CPU::read_implied,          &CPU::op_brk, "BRK", CPU::AM_IMPLIED,            0 }, // Cycle count added by the interrupt
-    { &CPU::read_indexed_indirect, &CPU::op_ora, "ORA", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indexed_indirect, &CPU::op_slo, "SLO", CPU::AM_INDEXED_INDIRECT,   8 },
-    { &CPU::read_zeropage,         &CPU::op_nop, "NOP", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_ora, "ORA", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_asl, "ASL", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_zeropage,         &CPU::op_slo, "SLO", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_implied,          &CPU::op_php, "PHP", CPU::AM_IMPLIED,            3 },
-    { &CPU::read_immediate,        &CPU::op_ora, "ORA", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_implied,          &CPU::op_asl, "ASL", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_anc, "ANC", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_absolute,         &CPU::op_nop, "NOP", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_ora, "ORA", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_asl, "ASL", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_absolute,         &CPU::op_slo, "SLO", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_relative,         &CPU::op_bpl, "BPL", CPU::AM_RELATIVE,           2 },
-    { &CPU::read_indirect_indexed, &CPU::op_ora, "ORA", CPU::AM_INDIRECT_INDEXED,   5 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indirect_indexed, &CPU::op_slo, "SLO", CPU::AM_INDIRECT_INDEXED,   8 },
-    { &CPU::read_zeropage_x,       &CPU::op_nop, "NOP", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_ora, "ORA", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_asl, "ASL", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_zeropage_x,       &CPU::op_slo, "SLO", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_implied,          &CPU::op_clc, "CLC", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_ora, "ORA", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_implied,          &CPU::op_nop, "NOP", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_slo, "SLO", CPU::AM_ABSOLUTE_INDEXED_Y, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_nop, "NOP", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_ora, "ORA", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_asl, "ASL", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_slo, "SLO", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_absolute,         &CPU::op_jsr, "JSR", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_indexed_indirect, &CPU::op_and, "AND", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indexed_indirect, &CPU::op_rla, "RLA", CPU::AM_INDEXED_INDIRECT,   8 },
-    { &CPU::read_zeropage,         &CPU::op_bit, "BIT", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_and, "AND", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_rol, "ROL", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_zeropage,         &CPU::op_rla, "RLA", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_implied,          &CPU::op_plp, "PLP", CPU::AM_IMPLIED,            4 },
-    { &CPU::read_immediate,        &CPU::op_and, "AND", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_implied,          &CPU::op_rol, "ROL", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_anc, "ANC", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_absolute,         &CPU::op_bit, "BIT", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_and, "AND", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_rol, "ROL", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_absolute,         &CPU::op_rla, "RLA", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_relative,         &CPU::op_bmi, "BMI", CPU::AM_RELATIVE,           2 },
-    { &CPU::read_indirect_indexed, &CPU::op_and, "AND", CPU::AM_INDIRECT_INDEXED,   5 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indirect_indexed, &CPU::op_rla, "RLA", CPU::AM_INDIRECT_INDEXED,   8 },
-    { &CPU::read_zeropage_x,       &CPU::op_nop, "NOP", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_and, "AND", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_rol, "ROL", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_zeropage_x,       &CPU::op_rla, "RLA", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_implied,          &CPU::op_sec, "SEC", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_and, "AND", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_implied,          &CPU::op_nop, "NOP", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_rla, "RLA", CPU::AM_ABSOLUTE_INDEXED_Y, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_nop, "NOP", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_and, "AND", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_rol, "ROL", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_rla, "RLA", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_implied,          &CPU::op_rti, "RTI", CPU::AM_IMPLIED,            6 },
-    { &CPU::read_indexed_indirect, &CPU::op_eor, "EOR", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indexed_indirect, &CPU::op_sre, "SRE", CPU::AM_INDEXED_INDIRECT,   8 },
-    { &CPU::read_zeropage,         &CPU::op_nop, "NOP", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_eor, "EOR", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_lsr, "LSR", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_zeropage,         &CPU::op_sre, "SRE", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_implied,          &CPU::op_pha, "PHA", CPU::AM_IMPLIED,            3 },
-    { &CPU::read_immediate,        &CPU::op_eor, "EOR", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_implied,          &CPU::op_lsr, "LSR", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_alr, "ALR", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_absolute,         &CPU::op_jmp, "JMP", CPU::AM_ABSOLUTE,           3 },
-    { &CPU::read_absolute,         &CPU::op_eor, "EOR", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_lsr, "LSR", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_absolute,         &CPU::op_sre, "SRE", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_relative,         &CPU::op_bvc, "BVC", CPU::AM_RELATIVE,           2 },
-    { &CPU::read_indirect_indexed, &CPU::op_eor, "EOR", CPU::AM_INDIRECT_INDEXED,   5 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indirect_indexed, &CPU::op_sre, "SRE", CPU::AM_INDIRECT_INDEXED,   8 },
-    { &CPU::read_zeropage_x,       &CPU::op_nop, "NOP", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_eor, "EOR", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_lsr, "LSR", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_zeropage_x,       &CPU::op_sre, "SRE", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_implied,          &CPU::op_cli, "CLI", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_eor, "EOR", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_implied,          &CPU::op_nop, "NOP", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_sre, "SRE", CPU::AM_ABSOLUTE_INDEXED_Y, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_nop, "NOP", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_eor, "EOR", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_lsr, "LSR", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_sre, "SRE", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_implied,          &CPU::op_rts, "RTS", CPU::AM_IMPLIED,            6 },
-    { &CPU::read_indexed_indirect, &CPU::op_adc, "ADC", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indexed_indirect, &CPU::op_rra, "RRA", CPU::AM_INDEXED_INDIRECT,   8 },
-    { &CPU::read_zeropage,         &CPU::op_nop, "NOP", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_adc, "ADC", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_ror, "ROR", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_zeropage,         &CPU::op_rra, "RRA", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_implied,          &CPU::op_pla, "PLA", CPU::AM_IMPLIED,            4 },
-    { &CPU::read_immediate,        &CPU::op_adc, "ADC", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_implied,          &CPU::op_ror, "ROR", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_arr, "ARR", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_indirect,         &CPU::op_jmp, "JMP", CPU::AM_INDIRECT,           5 },
-    { &CPU::read_absolute,         &CPU::op_adc, "ADC", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_ror, "ROR", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_absolute,         &CPU::op_rra, "RRA", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_relative,         &CPU::op_bvs, "BVS", CPU::AM_RELATIVE,           2 },
-    { &CPU::read_indirect_indexed, &CPU::op_adc, "ADC", CPU::AM_INDIRECT_INDEXED,   5 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indirect_indexed, &CPU::op_rra, "RRA", CPU::AM_INDIRECT_INDEXED,   8 },
-    { &CPU::read_zeropage_x,       &CPU::op_nop, "NOP", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_adc, "ADC", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_ror, "ROR", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_zeropage_x,       &CPU::op_rra, "RRA", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_implied,          &CPU::op_sei, "SEI", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_adc, "ADC", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_implied,          &CPU::op_nop, "NOP", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_rra, "RRA", CPU::AM_ABSOLUTE_INDEXED_Y, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_nop, "NOP", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_adc, "ADC", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_ror, "ROR", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_rra, "RRA", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_immediate,        &CPU::op_nop, "NOP", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_indexed_indirect, &CPU::op_sta, "STA", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_immediate,        &CPU::op_nop, "NOP", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_indexed_indirect, &CPU::op_sax, "SAX", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_zeropage,         &CPU::op_sty, "STY", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_sta, "STA", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_stx, "STX", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_sax, "SAX", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_implied,          &CPU::op_dey, "DEY", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_nop, "NOP", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_implied,          &CPU::op_txa, "TXA", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_xaa, "XAA", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_absolute,         &CPU::op_sty, "STY", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_sta, "STA", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_stx, "STX", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_sax, "SAX", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_relative,         &CPU::op_bcc, "BCC", CPU::AM_RELATIVE,           2 },
-    { &CPU::read_indirect_indexed, &CPU::op_sta, "STA", CPU::AM_INDIRECT_INDEXED,   6 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indirect_indexed, &CPU::op_ahx, "AHX", CPU::AM_INDIRECT_INDEXED,   6 },
-    { &CPU::read_zeropage_x,       &CPU::op_sty, "STY", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_sta, "STA", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_y,       &CPU::op_stx, "STX", CPU::AM_ZEROPAGE_INDEXED_Y, 4 },
-    { &CPU::read_zeropage_y,       &CPU::op_sax, "SAX", CPU::AM_ZEROPAGE_INDEXED_Y, 4 },
-    { &CPU::read_implied,          &CPU::op_tya, "TYA", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_sta, "STA", CPU::AM_ABSOLUTE_INDEXED_Y, 5 },
-    { &CPU::read_implied,          &CPU::op_txs, "TXS", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_tas, "TAS", CPU::AM_ABSOLUTE_INDEXED_Y, 5 },
-    { &CPU::read_absolute_x,       &CPU::op_shy, "SHY", CPU::AM_ABSOLUTE_INDEXED_X, 5 },
-    { &CPU::read_absolute_x,       &CPU::op_sta, "STA", CPU::AM_ABSOLUTE_INDEXED_X, 5 },
-    { &CPU::read_absolute_y,       &CPU::op_shx, "SHX", CPU::AM_ABSOLUTE_INDEXED_Y, 5 },
-    { &CPU::read_absolute_y,       &CPU::op_ahx, "AHX", CPU::AM_ABSOLUTE_INDEXED_Y, 5 },
-    { &CPU::read_immediate,        &CPU::op_ldy, "LDY", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_indexed_indirect, &CPU::op_lda, "LDA", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_immediate,        &CPU::op_ldx, "LDX", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_indexed_indirect, &CPU::op_lax, "LAX", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_zeropage,         &CPU::op_ldy, "LDY", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_lda, "LDA", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_ldx, "LDX", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_lax, "LAX", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_implied,          &CPU::op_tay, "TAY", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_lda, "LDA", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_implied,          &CPU::op_tax, "TAX", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_lax, "LAX", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_absolute,         &CPU::op_ldy, "LDY", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_lda, "LDA", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_ldx, "LDX", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_lax, "LAX", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_relative,         &CPU::op_bcs, "BCS", CPU::AM_RELATIVE,           2 },
-    { &CPU::read_indirect_indexed, &CPU::op_lda, "LDA", CPU::AM_INDIRECT_INDEXED,   5 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indirect_indexed, &CPU::op_lax, "LAX", CPU::AM_INDIRECT_INDEXED,   5 },
-    { &CPU::read_zeropage_x,       &CPU::op_ldy, "LDY", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_lda, "LDA", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_y,       &CPU::op_ldx, "LDX", CPU::AM_ZEROPAGE_INDEXED_Y, 4 },
-    { &CPU::read_zeropage_y,       &CPU::op_lax, "LAX", CPU::AM_ZEROPAGE_INDEXED_Y, 4 },
-    { &CPU::read_implied,          &CPU::op_clv, "CLV", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_lda, "LDA", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_implied,          &CPU::op_tsx, "TSX", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_las, "LAS", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_ldy, "LDY", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_lda, "LDA", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_y,       &CPU::op_ldx, "LDX", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_absolute_y,       &CPU::op_lax, "LAX", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_immediate,        &CPU::op_cpy, "CPY", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_indexed_indirect, &CPU::op_cmp, "CMP", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_immediate,        &CPU::op_nop, "NOP", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_indexed_indirect, &CPU::op_dcp, "DCP", CPU::AM_INDEXED_INDIRECT,   8 },
-    { &CPU::read_zeropage,         &CPU::op_cpy, "CPY", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_cmp, "CMP", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_dec, "DEC", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_zeropage,         &CPU::op_dcp, "DCP", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_implied,          &CPU::op_iny, "INY", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_cmp, "CMP", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_implied,          &CPU::op_dex, "DEX", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_axs, "AXS", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_absolute,         &CPU::op_cpy, "CPY", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_cmp, "CMP", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_dec, "DEC", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_absolute,         &CPU::op_dcp, "DCP", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_relative,         &CPU::op_bne, "BNE", CPU::AM_RELATIVE,           2 },
-    { &CPU::read_indirect_indexed, &CPU::op_cmp, "CMP", CPU::AM_INDIRECT_INDEXED,   5 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indirect_indexed, &CPU::op_dcp, "DCP", CPU::AM_INDIRECT_INDEXED,   8 },
-    { &CPU::read_zeropage_x,       &CPU::op_nop, "NOP", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_cmp, "CMP", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_dec, "DEC", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_zeropage_x,       &CPU::op_dcp, "DCP", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_implied,          &CPU::op_cld, "CLD", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_cmp, "CMP", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_implied,          &CPU::op_nop, "NOP", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_dcp, "DCP", CPU::AM_ABSOLUTE_INDEXED_Y, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_nop, "NOP", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_cmp, "CMP", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_dec, "DEC", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_dcp, "DCP", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_immediate,        &CPU::op_cpx, "CPX", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_indexed_indirect, &CPU::op_sbc, "SBC", CPU::AM_INDEXED_INDIRECT,   6 },
-    { &CPU::read_immediate,        &CPU::op_nop, "NOP", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_indexed_indirect, &CPU::op_isc, "ISC", CPU::AM_INDEXED_INDIRECT,   8 },
-    { &CPU::read_zeropage,         &CPU::op_cpx, "CPX", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_sbc, "SBC", CPU::AM_ZEROPAGE,           3 },
-    { &CPU::read_zeropage,         &CPU::op_inc, "INC", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_zeropage,         &CPU::op_isc, "ISC", CPU::AM_ZEROPAGE,           5 },
-    { &CPU::read_implied,          &CPU::op_inx, "INX", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_sbc, "SBC", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_implied,          &CPU::op_nop, "NOP", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_immediate,        &CPU::op_sbc, "SBC", CPU::AM_IMMEDIATE,          2 },
-    { &CPU::read_absolute,         &CPU::op_cpx, "CPX", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_sbc, "SBC", CPU::AM_ABSOLUTE,           4 },
-    { &CPU::read_absolute,         &CPU::op_inc, "INC", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_absolute,         &CPU::op_isc, "ISC", CPU::AM_ABSOLUTE,           6 },
-    { &CPU::read_relative,         &CPU::op_beq, "BEQ", CPU::AM_RELATIVE,           2 },
-    { &CPU::read_indirect_indexed, &CPU::op_sbc, "SBC", CPU::AM_INDIRECT_INDEXED,   5 },
-    { &CPU::read_implied,          &CPU::op_hlt, "HLT", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_indirect_indexed, &CPU::op_isc, "ISC", CPU::AM_INDIRECT_INDEXED,   8 },
-    { &CPU::read_zeropage_x,       &CPU::op_nop, "NOP", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_sbc, "SBC", CPU::AM_ZEROPAGE_INDEXED_X, 4 },
-    { &CPU::read_zeropage_x,       &CPU::op_inc, "INC", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_zeropage_x,       &CPU::op_isc, "ISC", CPU::AM_ZEROPAGE_INDEXED_X, 6 },
-    { &CPU::read_implied,          &CPU::op_sed, "SED", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_sbc, "SBC", CPU::AM_ABSOLUTE_INDEXED_Y, 4 },
-    { &CPU::read_implied,          &CPU::op_nop, "NOP", CPU::AM_IMPLIED,            2 },
-    { &CPU::read_absolute_y,       &CPU::op_isc, "ISC", CPU::AM_ABSOLUTE_INDEXED_Y, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_nop, "NOP", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_sbc, "SBC", CPU::AM_ABSOLUTE_INDEXED_X, 4 },
-    { &CPU::read_absolute_x,       &CPU::op_inc, "INC", CPU::AM_ABSOLUTE_INDEXED_X, 7 },
-    { &CPU::read_absolute_x,       &CPU::op_isc, "ISC", CPU::AM_ABSOLUTE_INDEXED_X, 7 }
+const CPU::DecodedHandler CPU::m_decoded_handlers[256] = {
+#define CPU_DECODED_HANDLER(opcode, mnemonic, read_address, execute, addressing_mode, cycles, flags) \
+    &CPU::execute_decoded<addressing_mode, &CPU::execute, cycles>,
+    CPU_INSTRUCTIONS(CPU_DECODED_HANDLER)
+#undef CPU_DECODED_HANDLER
 };
 
 void CPU::reset()
 {
-    m_registers.A = 0;
-    m_registers.X = 0;
-    m_registers.Y = 0;
-    m_registers.P = STATUS_U;
-    m_registers.SP = 0xFD;
-    m_opcode = 0;
-    m_address = 0;
-    m_cycles = 0;
-    m_dma_cycles = 0;
-    m_total_cycles = 0;
+    m_state.registers.A = 0;
+    m_state.registers.X = 0;
+    m_state.registers.Y = 0;
+    m_state.registers.P = STATUS_U;
+    m_state.registers.SP = 0xFD;
+    m_state.opcode = 0;
+    m_state.address = 0;
+    m_state.cycles = 0;
+    m_state.dma_cycles = 0;
+    m_state.total_cycles = 0;
+    m_state.instructions = 0;
+    m_block_cache.reset(m_system_bus.memory_map().rom_size());
+    m_decoded = nullptr;
+    m_idle_loop = IdleLoop();
+    m_skipped_cycles = 0;
+
+    if (m_jit)
+        m_jit->reset();
 
     interrupt(InterruptType::RST);
 }
@@ -289,41 +316,570 @@ void CPU::nmi()
 
 void CPU::tick()
 {
-    m_total_cycles++;
+    m_state.total_cycles++;
 
-    if (m_dma_cycles != 0)
+    if (m_state.dma_cycles != 0)
     {
-        m_dma_cycles--;
+        m_state.dma_cycles--;
         return;
     }
 
-    if (m_cycles != 0)
+    if (m_state.cycles != 0)
+    {
+        m_state.cycles--;
+        return;
+    }
+
+    execute_next_instruction();
+}
+
+void CPU::run_until(uint64_t target_cycle)
+{
+    // Same result as calling tick() until target_cycle, without going through
+    // the idle cycles one by one
+    while (m_state.total_cycles < target_cycle)
+    {
+        uint64_t idle_cycles = target_cycle - m_state.total_cycles;
+
+        if (m_state.dma_cycles != 0)
+        {
+            idle_cycles = std::min<uint64_t>(idle_cycles, m_state.dma_cycles);
+            m_state.dma_cycles -= static_cast<uint16_t>(idle_cycles);
+            m_state.total_cycles += idle_cycles;
+            continue;
+        }
+
+        if (m_state.cycles != 0)
+        {
+            idle_cycles = std::min<uint64_t>(idle_cycles, m_state.cycles);
+            m_state.cycles -= static_cast<uint16_t>(idle_cycles);
+            m_state.total_cycles += idle_cycles;
+            continue;
+        }
+
+        m_state.total_cycles++;
+        execute_next_instruction();
+    }
+}
+
+void CPU::step(uint64_t limit_cycle)
+{
+    if (m_jit && m_jit_block_start && execute_native_block(limit_cycle))
+        return;
+
+    const uint16_t address = m_state.registers.PC;
+    m_state.total_cycles++;
+    execute_next_instruction();
+
+    if (m_idle_loop_skipping_enabled)
+        detect_idle_loop(address);
+
+    if (m_jit)
+    {
+        // Blocks start at jump targets, at page boundaries and after the
+        // instructions the native code cannot run
+        const uint16_t next = address + instruction_length(m_instruction_info[m_state.opcode].addressing_mode);
+        m_jit_block_start = m_jit_block_start || m_state.registers.PC != next ||
+            ((address ^ m_state.registers.PC) & ~MemoryMap::PageMask) != 0;
+    }
+}
+
+void CPU::set_block_cache_enabled(bool enabled)
+{
+    m_block_cache_enabled = enabled;
+    m_decoded = nullptr;
+}
+
+bool CPU::set_jit_enabled(bool enabled)
+{
+    if (!enabled)
+    {
+        m_jit.reset();
+        return true;
+    }
+
+    if (!JitX64::supported())
+    {
+        LOG_WARNING("CPU: JIT is only available on x86-64");
+        return false;
+    }
+
+    if (!m_jit)
+    {
+        // Drop the blocks, none of them points to code in the new JIT
+        m_jit = std::make_unique<JitX64>();
+        m_block_cache.reset(m_system_bus.memory_map().rom_size());
+        m_decoded = nullptr;
+        m_jit_block_start = true;
+    }
+
+    return true;
+}
+
+void CPU::set_idle_loop_skipping_enabled(bool enabled)
+{
+    m_idle_loop_skipping_enabled = enabled;
+    m_idle_loop = IdleLoop();
+}
+
+void CPU::load_state(const State& state)
+{
+    m_state = state;
+
+    // The decoded blocks stay, they are looked up again from the new PC
+    m_decoded = nullptr;
+    m_jit_block_start = true;
+    m_idle_loop = IdleLoop();
+}
+
+uint8_t CPU::instruction_length(AddressingMode addressing_mode)
+{
+    switch (addressing_mode)
     {
-        m_cycles--;
+    case AM_IMPLIED:
+        return 1;
+    case AM_ABSOLUTE:
+    case AM_ABSOLUTE_INDEXED_X:
+    case AM_ABSOLUTE_INDEXED_Y:
+    case AM_INDIRECT:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+void CPU::execute_next_instruction()
+{
+    if (m_block_cache_enabled && execute_cached_instruction())
         return;
+
+    m_state.opcode = read(m_state.registers.PC++);
+    m_state.address = 0;
+    m_state.instructions++;
+
+    switch (m_state.opcode)
+    {
+#define CPU_DISPATCH(opcode, mnemonic, read_address, execute, addressing_mode, cycles, flags) \
+    case opcode: \
+        execute_instruction<&CPU::read_address, &CPU::execute, addressing_mode, cycles>(); \
+        break;
+    CPU_INSTRUCTIONS(CPU_DISPATCH)
+#undef CPU_DISPATCH
     }
 
-    m_opcode = read(m_registers.PC++);
-    Instruction op = m_instruction_table[m_opcode];
-    m_addressing_mode = op.addressing_mode;
-    m_cycles = op.cycles;
-    m_address = 0;
-    bool am_cycle = (this->*op.read_address)();
-    bool op_cycle = (this->*op.execute)();
+    m_state.cycles--;
+}
+
+template <bool (CPU::*ReadAddress)(), bool (CPU::*Execute)(), CPU::AddressingMode Mode, uint8_t Cycles>
+inline void CPU::execute_instruction()
+{
+    m_state.addressing_mode = Mode;
+    m_state.cycles = Cycles;
+
+    // Page crossing adds a cycle only for the instructions that care about it
+    bool am_cycle = (this->*ReadAddress)();
+    bool op_cycle = (this->*Execute)();
     if (am_cycle && op_cycle)
-        m_cycles++;
+        m_state.cycles++;
+}
+
+inline bool CPU::execute_cached_instruction()
+{
+    // Continue the current block unless the program jumped, an interrupt
+    // happened or the mapper switched banks
+    const DecodedInstruction* instruction = m_decoded;
+    if (instruction == nullptr ||
+        instruction->address != m_state.registers.PC ||
+        m_decoded_version != m_system_bus.memory_map().version())
+    {
+        instruction = find_block();
+        if (instruction == nullptr)
+            return false;
+    }
+
+    m_decoded = instruction + 1;
+    m_state.opcode = instruction->opcode;
+    m_state.registers.PC++;
+    m_state.address = 0;
+    m_state.instructions++;
+
+    instruction->execute(*this, instruction->operand);
+
+    m_state.cycles--;
+    return true;
+}
 
-    m_cycles--;
+const DecodedInstruction* CPU::find_block()
+{
+    const MemoryMap& memory_map = m_system_bus.memory_map();
+    m_decoded = nullptr;
+    m_decoded_version = memory_map.version();
+
+    // Code running from RAM is not cached
+    const int32_t rom_offset = memory_map.rom_offset(m_state.registers.PC);
+    if (rom_offset < 0)
+        return nullptr;
+
+    const DecodedInstruction* instruction = lookup_block(m_state.registers.PC, rom_offset)->instructions.data();
+    if (instruction->address == DecodedInstruction::EndOfBlock)
+        return nullptr;
+
+    return instruction;
+}
+
+CodeBlock* CPU::lookup_block(uint16_t address, uint32_t rom_offset)
+{
+    // The same ROM can be mapped at another address, branch targets would be wrong
+    CodeBlock* block = m_block_cache.find(rom_offset);
+    if (block == nullptr || block->address != address)
+        block = decode_block(address, rom_offset);
+
+    return block;
+}
+
+CodeBlock* CPU::decode_block(uint16_t address, uint32_t rom_offset)
+{
+    // Stay inside the memory map page, the next page can be switched separately
+    const uint32_t page_end = (address & ~MemoryMap::PageMask) + MemoryMap::PageSize;
+    CodeBlock block;
+    block.address = address;
+
+    while (true)
+    {
+        const uint8_t opcode = read(address);
+        const InstructionInfo& info = m_instruction_info[opcode];
+        const uint8_t length = instruction_length(info.addressing_mode);
+        if (address + length > page_end)
+            break;
+
+        DecodedInstruction instruction;
+        instruction.execute = m_decoded_handlers[opcode];
+        instruction.address = address;
+        instruction.opcode = opcode;
+
+        if (length == 2)
+            instruction.operand = read(address + 1);
+        else if (length == 3)
+            instruction.operand = read_word(address + 1);
+
+        if (info.addressing_mode == AM_RELATIVE)
+            instruction.operand = address + 2 + static_cast<int8_t>(instruction.operand);
+
+        block.instructions.push_back(instruction);
+        address += length;
+
+        // Anything that can change the program counter ends the block
+        if (info.flags & INS_ENDS_BLOCK)
+            break;
+    }
+
+    block.instructions.push_back(DecodedInstruction());
+
+    // Replacing a block frees the one the cached instructions were read from
+    m_decoded = nullptr;
+
+    return m_block_cache.insert(rom_offset, std::move(block));
+}
+
+bool CPU::execute_native_block(uint64_t limit_cycle)
+{
+    m_jit_block_start = false;
+
+    // Code running from RAM is not compiled
+    const MemoryMap& memory_map = m_system_bus.memory_map();
+    const int32_t rom_offset = memory_map.rom_offset(m_state.registers.PC);
+    if (rom_offset < 0)
+        return false;
+
+    CodeBlock* block = lookup_block(m_state.registers.PC, rom_offset);
+    if (block->native == nullptr)
+    {
+        // The interpreter runs the first instruction, the next one starts a block
+        if (block->native_failed)
+        {
+            m_jit_block_start = true;
+            return false;
+        }
+
+        if (++block->executions < JIT_Threshold)
+            return false;
+
+        if (!m_jit->compile(*block))
+        {
+            // Start over when the code memory is full, blocks replaced after
+            // a bank moved to another address leave unused code behind
+            if (m_jit->full())
+            {
+                m_jit->reset();
+                m_block_cache.reset(memory_map.rom_size());
+                m_decoded = nullptr;
+                m_jit_block_start = true;
+            }
+
+            return false;
+        }
+    }
+
+    if (m_state.total_cycles + block->max_cycles > limit_cycle)
+        return false;
+
+    JitState state;
+    state.read_pages = memory_map.read_pages();
+    state.ram = memory_map.write_page(0x0000);
+    state.PC = m_state.registers.PC;
+    state.A = m_state.registers.A;
+    state.X = m_state.registers.X;
+    state.Y = m_state.registers.Y;
+    state.P = m_state.registers.P;
+    state.SP = m_state.registers.SP;
+
+    block->native(&state);
+
+    // Stopped before an instruction the interpreter has to run
+    m_jit_block_start = true;
+    if (state.instructions == 0)
+        return false;
+
+    m_state.registers.PC = state.PC;
+    m_state.registers.A = state.A;
+    m_state.registers.X = state.X;
+    m_state.registers.Y = state.Y;
+    m_state.registers.P = state.P;
+    m_state.registers.SP = state.SP;
+    m_state.total_cycles += state.cycles;
+    m_state.instructions += state.instructions;
+
+    // The loop is seen only when the block ends with the branch
+    if (m_idle_loop_skipping_enabled && state.instructions == block->instructions.size() - 1)
+        detect_idle_loop(block->instructions[state.instructions - 1].address);
+
+    return true;
+}
+
+bool CPU::idle_loop(uint8_t ppu_status)
+{
+    if (m_state.registers.PC != m_idle_loop.start || !m_idle_loop.valid)
+        return false;
+
+    if (m_idle_loop.version != m_system_bus.memory_map().version())
+    {
+        m_idle_loop.valid = false;
+        return false;
+    }
+
+    // Straight from the previous start through the branch, without an
+    // interrupt, and with nothing the loop reads changed
+    const Registers& registers = m_idle_loop.registers;
+    const bool unchanged = m_idle_loop.started &&
+                           m_state.instructions - m_idle_loop.instructions == m_idle_loop.length &&
+                           registers.A == m_state.registers.A &&
+                           registers.X == m_state.registers.X &&
+                           registers.Y == m_state.registers.Y &&
+                           registers.P == m_state.registers.P &&
+                           registers.SP == m_state.registers.SP &&
+                           ppu_status == m_idle_loop.ppu_status;
+
+    m_idle_loop.iteration_cycles = unchanged ? m_state.total_cycles - m_idle_loop.cycles : 0;
+    m_idle_loop.started = true;
+    m_idle_loop.registers = m_state.registers;
+    m_idle_loop.ppu_status = ppu_status;
+    m_idle_loop.cycles = m_state.total_cycles;
+    m_idle_loop.instructions = m_state.instructions;
+
+    return unchanged;
+}
+
+bool CPU::skip_idle_loop(uint64_t limit_cycle)
+{
+    if (m_idle_loop.iteration_cycles == 0 || limit_cycle <= m_state.total_cycles)
+        return false;
+
+    const uint64_t iterations = (limit_cycle - m_state.total_cycles) / m_idle_loop.iteration_cycles;
+    if (iterations == 0)
+        return false;
+
+    // The CPU stays at the start of the loop, the next iteration is
+    // interpreted again to see if the loop still changes nothing
+    const uint64_t cycles = iterations * m_idle_loop.iteration_cycles;
+    m_state.total_cycles += cycles;
+    m_state.instructions += iterations * m_idle_loop.length;
+    m_skipped_cycles += cycles;
+    m_idle_loop.started = false;
+    m_idle_loop.iteration_cycles = 0;
+    m_jit_block_start = true;
+
+    return true;
+}
+
+void CPU::detect_idle_loop(uint16_t address)
+{
+    // Loops branch back to a lower address
+    const uint16_t start = m_state.registers.PC;
+    if (start > address || address - start >= IdleLoop_MaxLength)
+        return;
+
+    const MemoryMap& memory_map = m_system_bus.memory_map();
+    if (start == m_idle_loop.start && address == m_idle_loop.end &&
+        m_idle_loop.version == memory_map.version())
+        return;
+
+    m_idle_loop = IdleLoop();
+    m_idle_loop.start = start;
+    m_idle_loop.end = address;
+    m_idle_loop.version = memory_map.version();
+
+    // Only code in PRG ROM, decoded without side effects
+    auto peek = [&memory_map](uint16_t address, uint8_t& data)
+    {
+        if (memory_map.rom_offset(address) < 0)
+            return false;
+
+        data = memory_map.read_page(address)[address & MemoryMap::PageMask];
+        return true;
+    };
+
+    uint16_t pc = start;
+    while (pc <= address)
+    {
+        uint8_t opcode = 0;
+        uint8_t low = 0;
+        uint8_t high = 0;
+        if (!peek(pc, opcode))
+            return;
+
+        const InstructionInfo& info = m_instruction_info[opcode];
+        const uint8_t length = instruction_length(info.addressing_mode);
+        if ((length > 1 && !peek(pc + 1, low)) || (length > 2 && !peek(pc + 2, high)))
+            return;
+
+        const uint16_t operand = low | (high << 8);
+        m_idle_loop.length++;
+
+        if (pc == address)
+        {
+            // Branch or jump back to the start
+            if (info.addressing_mode == AM_RELATIVE)
+                m_idle_loop.valid = static_cast<uint16_t>(pc + 2 + static_cast<int8_t>(low)) == start;
+            else if (opcode == 0x4C)
+                m_idle_loop.valid = operand == start;
+
+            return;
+        }
+
+        if (info.flags & INS_REGISTER)
+        {
+            // Registers only, a loop changing them is not idle
+        }
+        else if (info.flags & INS_READ)
+        {
+            // Reads of RAM, PRG ROM/RAM or the PPU status, which the CPU
+            // alone changes or reading twice gives the same value
+            if (info.addressing_mode == AM_ABSOLUTE)
+            {
+                if (memory_map.read_page(operand) == nullptr && (operand & 0xE007) != 0x2002)
+                    return;
+            }
+            else if (info.addressing_mode != AM_IMMEDIATE && info.addressing_mode != AM_ZEROPAGE &&
+                     info.addressing_mode != AM_IMPLIED)
+                return;
+        }
+        else
+        {
+            return;
+        }
+
+        pc += length;
+    }
+}
+
+template <CPU::AddressingMode Mode, bool (CPU::*Execute)(), uint8_t Cycles>
+void CPU::execute_decoded(CPU& cpu, uint16_t operand)
+{
+    cpu.m_state.addressing_mode = Mode;
+    cpu.m_state.cycles = Cycles;
+
+    bool am_cycle = cpu.resolve_address<Mode>(operand);
+    bool op_cycle = (cpu.*Execute)();
+    if (am_cycle && op_cycle)
+        cpu.m_state.cycles++;
+}
+
+// Same as the read_* addressing modes, with the operand already fetched
+template <CPU::AddressingMode Mode>
+inline bool CPU::resolve_address(uint16_t operand)
+{
+    if constexpr (Mode == AM_IMPLIED)
+    {
+        return false;
+    }
+    else if constexpr (Mode == AM_IMMEDIATE)
+    {
+        m_state.address = m_state.registers.PC++;
+        return false;
+    }
+    else if constexpr (Mode == AM_ABSOLUTE)
+    {
+        m_state.address = operand;
+        m_state.registers.PC += 2;
+        return false;
+    }
+    else if constexpr (Mode == AM_ABSOLUTE_INDEXED_X || Mode == AM_ABSOLUTE_INDEXED_Y)
+    {
+        m_state.address = operand + (Mode == AM_ABSOLUTE_INDEXED_X ? m_state.registers.X : m_state.registers.Y);
+        m_state.registers.PC += 2;
+        return (operand & 0xFF00) != (m_state.address & 0xFF00);
+    }
+    else if constexpr (Mode == AM_RELATIVE)
+    {
+        m_state.registers.PC++;
+        m_state.address = operand;
+        return (m_state.registers.PC & 0xFF00) != (m_state.address & 0xFF00);
+    }
+    else if constexpr (Mode == AM_ZEROPAGE)
+    {
+        m_state.address = operand;
+        m_state.registers.PC++;
+        return false;
+    }
+    else if constexpr (Mode == AM_ZEROPAGE_INDEXED_X || Mode == AM_ZEROPAGE_INDEXED_Y)
+    {
+        m_state.address = (operand + (Mode == AM_ZEROPAGE_INDEXED_X ? m_state.registers.X : m_state.registers.Y)) & 0x00FF;
+        m_state.registers.PC++;
+        return false;
+    }
+    else if constexpr (Mode == AM_INDIRECT)
+    {
+        uint16_t high = (operand & 0xFF00) | ((operand + 1) & 0x00FF);
+        m_state.registers.PC += 2;
+        m_state.address = static_cast<uint16_t>(read(operand)) | static_cast<uint16_t>(read(high)) << 8;
+        return false;
+    }
+    else if constexpr (Mode == AM_INDEXED_INDIRECT)
+    {
+        uint16_t low = static_cast<uint16_t>(operand + m_state.registers.X) & 0x00FF;
+        uint16_t high = static_cast<uint16_t>(low + 1) & 0x00FF;
+        m_state.registers.PC++;
+        m_state.address = static_cast<uint16_t>(read(low)) | static_cast<uint16_t>(read(high)) << 8;
+        return false;
+    }
+    else
+    {
+        uint16_t high = static_cast<uint16_t>(operand + 1) & 0x00FF;
+        uint16_t address = static_cast<uint16_t>(read(operand)) | static_cast<uint16_t>(read(high)) << 8;
+        m_state.registers.PC++;
+        m_state.address = address + m_state.registers.Y;
+        return (address & 0xFF00) != (m_state.address & 0xFF00);
+    }
 }
 
 void CPU::dma()
 {
     // Skip DMA cycles, 256 read + 256 write
-    m_dma_cycles = 512;
+    m_state.dma_cycles = 512;
 
     // On odd cycles add 1
-    if (m_total_cycles & 1)
-        m_dma_cycles++;
+    if (m_state.total_cycles & 1)
+        m_state.dma_cycles++;
 }
 
 void CPU::interrupt(InterruptType type)
@@ -335,13 +891,13 @@ void CPU::interrupt(InterruptType type)
     {
         if (type == InterruptType::BRK)
         {
-            stack_push_word(m_registers.PC++);
-            stack_push(m_registers.P | STATUS_B | STATUS_U);
+            stack_push_word(m_state.registers.PC++);
+            stack_push(m_state.registers.P | STATUS_B | STATUS_U);
         }
         else
         {
-            stack_push_word(m_registers.PC);
-            stack_push(m_registers.P | STATUS_U);
+            stack_push_word(m_state.registers.PC);
+            stack_push(m_state.registers.P | STATUS_U);
         }
     }
 
@@ -353,8 +909,10 @@ void CPU::interrupt(InterruptType type)
     else if (type == InterruptType::NMI)
         vector = NMI_Vector;
 
-    m_registers.PC = read_word(vector);
-    m_cycles = INT_Cycles;
+    m_state.registers.PC = read_word(vector);
+    m_state.cycles = INT_Cycles;
+    m_jit_block_start = true;
+    m_idle_loop.started = false;
 }
 
 void CPU::set_status_zn_flags(uint8_t value)
@@ -381,8 +939,8 @@ void CPU::write(uint16_t address, uint8_t data)
 
 void CPU::stack_push(uint8_t data)
 {
-    write(0x100 | m_registers.SP, data);
-    m_registers.SP--;
+    write(0x100 | m_state.registers.SP, data);
+    m_state.registers.SP--;
 }
 
 void CPU::stack_push_word(uint16_t data)
@@ -393,8 +951,8 @@ void CPU::stack_push_word(uint16_t data)
 
 uint8_t CPU::stack_pop()
 {
-    m_registers.SP++;
-    return read(0x100 | m_registers.SP);
+    m_state.registers.SP++;
+    return read(0x100 | m_state.registers.SP);
 }
 
 uint16_t CPU::stack_pop_word()
@@ -407,7 +965,7 @@ uint16_t CPU::stack_pop_word()
 
 void CPU::stack_pop_status()
 {
-    m_registers.P = stack_pop() & 0xCF;
+    m_state.registers.P = stack_pop() & 0xCF;
 }
 
 bool CPU::read_implied()
@@ -417,14 +975,14 @@ bool CPU::read_implied()
 
 bool CPU::read_immediate()
 {
-    m_address = m_registers.PC++;
+    m_state.address = m_state.registers.PC++;
     return false;
 }
 
 bool CPU::read_absolute()
 {
-    m_address = read_word(m_registers.PC);
-    m_registers.PC += 2;
+    m_state.address = read_word(m_state.registers.PC);
+    m_state.registers.PC += 2;
 
     return false;
 }
@@ -433,10 +991,10 @@ bool CPU::read_absolute_x()
 {
     read_absolute();
 
-    const uint16_t base = (m_address & 0xFF00);
-    m_address += m_registers.X;
+    const uint16_t base = (m_state.address & 0xFF00);
+    m_state.address += m_state.registers.X;
 
-    if (base != (m_address & 0xFF00))
+    if (base != (m_state.address & 0xFF00))
         return true;
 
     return false;
@@ -446,10 +1004,10 @@ bool CPU::read_absolute_y()
 {
     read_absolute();
 
-    const uint16_t base = (m_address & 0xFF00);
-    m_address += m_registers.Y;
+    const uint16_t base = (m_state.address & 0xFF00);
+    m_state.address += m_state.registers.Y;
 
-    if (base != (m_address & 0xFF00))
+    if (base != (m_state.address & 0xFF00))
         return true;
 
     return false;
@@ -457,10 +1015,10 @@ bool CPU::read_absolute_y()
 
 bool CPU::read_relative()
 {
-    int8_t offset = read(m_registers.PC++);
-    m_address = m_registers.PC + offset;
+    int8_t offset = read(m_state.registers.PC++);
+    m_state.address = m_state.registers.PC + offset;
 
-    if ((m_registers.PC & 0xFF00) != (m_address & 0xFF00))
+    if ((m_state.registers.PC & 0xFF00) != (m_state.address & 0xFF00))
         return true;
 
     return false;
@@ -468,50 +1026,50 @@ bool CPU::read_relative()
 
 bool CPU::read_zeropage()
 {
-    m_address = read(m_registers.PC++) & 0x00FF;
+    m_state.address = read(m_state.registers.PC++) & 0x00FF;
     return false;
 }
 
 bool CPU::read_zeropage_x()
 {
-    m_address = (read(m_registers.PC++) + m_registers.X) & 0x00FF;
+    m_state.address = (read(m_state.registers.PC++) + m_state.registers.X) & 0x00FF;
     return false;
 }
 
 bool CPU::read_zeropage_y()
 {
-    m_address = (read(m_registers.PC++) + m_registers.Y) & 0x00FF;
+    m_state.address = (read(m_state.registers.PC++) + m_state.registers.Y) & 0x00FF;
     return false;
 }
 
 bool CPU::read_indirect()
 {
-    uint16_t low = read_word(m_registers.PC);
+    uint16_t low = read_word(m_state.registers.PC);
     uint16_t high = (low & 0xFF00) | ((low + 1) & 0x00FF);
-    m_registers.PC += 2;
-    m_address = static_cast<uint16_t>(read(low)) | static_cast<uint16_t>(read(high)) << 8;
+    m_state.registers.PC += 2;
+    m_state.address = static_cast<uint16_t>(read(low)) | static_cast<uint16_t>(read(high)) << 8;
 
     return false;
 }
 
 bool CPU::read_indexed_indirect()
 {
-    uint16_t low = static_cast<uint16_t>(read(m_registers.PC++) + m_registers.X) & 0x00FF;
+    uint16_t low = static_cast<uint16_t>(read(m_state.registers.PC++) + m_state.registers.X) & 0x00FF;
     uint16_t high = static_cast<uint16_t>(low + 1) & 0x00FF;
-    m_address = static_cast<uint16_t>(read(low)) | static_cast<uint16_t>(read(high)) << 8;
+    m_state.address = static_cast<uint16_t>(read(low)) | static_cast<uint16_t>(read(high)) << 8;
 
     return false;
 }
 
 bool CPU::read_indirect_indexed()
 {
-    uint16_t low = static_cast<uint16_t>(read(m_registers.PC++));
+    uint16_t low = static_cast<uint16_t>(read(m_state.registers.PC++));
     uint16_t high = static_cast<uint16_t>(low + 1) & 0x00FF;
     uint16_t address = static_cast<uint16_t>(read(low)) | static_cast<uint16_t>(read(high)) << 8;
     uint16_t base = address & 0xFF00;
-    m_address = address + m_registers.Y;
+    m_state.address = address + m_state.registers.Y;
 
-    if (base != (m_address & 0xFF00))
+    if (base != (m_state.address & 0xFF00))
         return true;
 
     return false;
@@ -519,8 +1077,8 @@ bool CPU::read_indirect_indexed()
 
 void CPU::branch()
 {
-    m_registers.PC = m_address;
-    m_cycles++;
+    m_state.registers.PC = m_state.address;
+    m_state.cycles++;
 }
 
 bool CPU::op_bcs()
@@ -597,20 +1155,20 @@ bool CPU::op_bvc()
 
 bool CPU::op_pha()
 {
-    stack_push(m_registers.A);
+    stack_push(m_state.registers.A);
     return false;
 }
 
 bool CPU::op_php()
 {
-    stack_push(m_registers.P | STATUS_B | STATUS_U);
+    stack_push(m_state.registers.P | STATUS_B | STATUS_U);
     return false;
 }
 
 bool CPU::op_pla()
 {
-    m_registers.A = stack_pop();
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A = stack_pop();
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
@@ -623,8 +1181,8 @@ bool CPU::op_plp()
 
 bool CPU::op_inc()
 {
-    uint8_t value = read(m_address) + 1;
-    write(m_address, value);
+    uint8_t value = read(m_state.address) + 1;
+    write(m_state.address, value);
     set_status_zn_flags(value);
 
     return false;
@@ -632,24 +1190,24 @@ bool CPU::op_inc()
 
 bool CPU::op_inx()
 {
-    m_registers.X++;
-    set_status_zn_flags(m_registers.X);
+    m_state.registers.X++;
+    set_status_zn_flags(m_state.registers.X);
 
     return false;
 }
 
 bool CPU::op_iny()
 {
-    m_registers.Y++;
-    set_status_zn_flags(m_registers.Y);
+    m_state.registers.Y++;
+    set_status_zn_flags(m_state.registers.Y);
 
     return false;
 }
 
 bool CPU::op_dec()
 {
-    uint8_t value = read(m_address) - 1;
-    write(m_address, value);
+    uint8_t value = read(m_state.address) - 1;
+    write(m_state.address, value);
     set_status_zn_flags(value);
 
     return false;
@@ -657,46 +1215,46 @@ bool CPU::op_dec()
 
 bool CPU::op_dex()
 {
-    m_registers.X--;
-    set_status_zn_flags(m_registers.X);
+    m_state.registers.X--;
+    set_status_zn_flags(m_state.registers.X);
 
     return false;
 }
 
 bool CPU::op_dey()
 {
-    m_registers.Y--;
-    set_status_zn_flags(m_registers.Y);
+    m_state.registers.Y--;
+    set_status_zn_flags(m_state.registers.Y);
 
     return false;
 }
 
 bool CPU::op_adc()
 {
-    uint8_t operand = read(m_address);
-    bool sign = (m_registers.A >> 7) == (operand >> 7);
-    uint16_t value = m_registers.A + operand + (check_status_flag(STATUS_C) ? 1 : 0);
-    m_registers.A = value & 0xFF;
-    bool overflow = sign && (m_registers.A >> 7) != (operand >> 7);
+    uint8_t operand = read(m_state.address);
+    bool sign = (m_state.registers.A >> 7) == (operand >> 7);
+    uint16_t value = m_state.registers.A + operand + (check_status_flag(STATUS_C) ? 1 : 0);
+    m_state.registers.A = value & 0xFF;
+    bool overflow = sign && (m_state.registers.A >> 7) != (operand >> 7);
 
     set_status_flag(STATUS_C, (value & 0x100) >> 8);
     set_status_flag(STATUS_V, overflow);
-    set_status_zn_flags(m_registers.A);
+    set_status_zn_flags(m_state.registers.A);
 
     return true;
 }
 
 bool CPU::op_sbc()
 {
-    uint8_t operand = read(m_address) ^ 0xFF;
-    bool sign = (m_registers.A & 0x80) == (operand & 0x80);
-    uint16_t value = m_registers.A + operand + (check_status_flag(STATUS_C) ? 1 : 0);
-    m_registers.A = value & 0xFF;
-    bool overflow = sign && (m_registers.A & 0x80) != (operand & 0x80);
+    uint8_t operand = read(m_state.address) ^ 0xFF;
+    bool sign = (m_state.registers.A & 0x80) == (operand & 0x80);
+    uint16_t value = m_state.registers.A + operand + (check_status_flag(STATUS_C) ? 1 : 0);
+    m_state.registers.A = value & 0xFF;
+    bool overflow = sign && (m_state.registers.A & 0x80) != (operand & 0x80);
 
     set_status_flag(STATUS_C, (value & 0x100) >> 8);
     set_status_flag(STATUS_V, overflow);
-    set_status_zn_flags(m_registers.A);
+    set_status_zn_flags(m_state.registers.A);
 
     return true;
 }
@@ -745,115 +1303,115 @@ bool CPU::op_sei()
 
 bool CPU::op_lda()
 {
-    m_registers.A = read(m_address);
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A = read(m_state.address);
+    set_status_zn_flags(m_state.registers.A);
 
     return true;
 }
 
 bool CPU::op_ldx()
 {
-    m_registers.X = read(m_address);
-    set_status_zn_flags(m_registers.X);
+    m_state.registers.X = read(m_state.address);
+    set_status_zn_flags(m_state.registers.X);
 
     return true;
 }
 
 bool CPU::op_ldy()
 {
-    m_registers.Y = read(m_address);
-    set_status_zn_flags(m_registers.Y);
+    m_state.registers.Y = read(m_state.address);
+    set_status_zn_flags(m_state.registers.Y);
 
     return true;
 }
 
 bool CPU::op_sta()
 {
-    write(m_address, m_registers.A);
+    write(m_state.address, m_state.registers.A);
     return false;
 }
 
 bool CPU::op_stx()
 {
-    write(m_address, m_registers.X);
+    write(m_state.address, m_state.registers.X);
     return false;
 }
 
 bool CPU::op_sty()
 {
-    write(m_address, m_registers.Y);
+    write(m_state.address, m_state.registers.Y);
     return false;
 }
 
 bool CPU::op_tax()
 {
-    m_registers.X = m_registers.A;
-    set_status_zn_flags(m_registers.X);
+    m_state.registers.X = m_state.registers.A;
+    set_status_zn_flags(m_state.registers.X);
 
     return false;
 }
 
 bool CPU::op_tay()
 {
-    m_registers.Y = m_registers.A;
-    set_status_zn_flags(m_registers.Y);
+    m_state.registers.Y = m_state.registers.A;
+    set_status_zn_flags(m_state.registers.Y);
 
     return false;
 }
 
 bool CPU::op_tsx()
 {
-    m_registers.X = m_registers.SP;
-    set_status_zn_flags(m_registers.X);
+    m_state.registers.X = m_state.registers.SP;
+    set_status_zn_flags(m_state.registers.X);
 
     return false;
 }
 
 bool CPU::op_txa()
 {
-    m_registers.A = m_registers.X;
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A = m_state.registers.X;
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_txs()
 {
-    m_registers.SP = m_registers.X;
+    m_state.registers.SP = m_state.registers.X;
     return false;
 }
 
 bool CPU::op_tya()
 {
-    m_registers.A = m_registers.Y;
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A = m_state.registers.Y;
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_jmp()
 {
-    m_registers.PC = m_address;
+    m_state.registers.PC = m_state.address;
     return false;
 }
 
 bool CPU::op_rts()
 {
-    m_registers.PC = stack_pop_word() + 1;
+    m_state.registers.PC = stack_pop_word() + 1;
     return false;
 }
 
 bool CPU::op_jsr()
 {
-    stack_push_word(m_registers.PC - 1);
-    m_registers.PC = m_address;
+    stack_push_word(m_state.registers.PC - 1);
+    m_state.registers.PC = m_state.address;
 
     return false;
 }
 
 bool CPU::op_brk()
 {
-    m_registers.PC++;
+    m_state.registers.PC++;
     interrupt(InterruptType::BRK);
     return false;
 }
@@ -861,16 +1419,16 @@ bool CPU::op_brk()
 bool CPU::op_rti()
 {
     stack_pop_status();
-    m_registers.PC = stack_pop_word();
+    m_state.registers.PC = stack_pop_word();
 
     return false;
 }
 
 bool CPU::op_cmp()
 {
-    uint8_t operand = read(m_address);
-    uint8_t value = m_registers.A - operand;
-    set_status_flag(STATUS_C, m_registers.A >= operand);
+    uint8_t operand = read(m_state.address);
+    uint8_t value = m_state.registers.A - operand;
+    set_status_flag(STATUS_C, m_state.registers.A >= operand);
     set_status_zn_flags(value);
 
     return true;
@@ -878,9 +1436,9 @@ bool CPU::op_cmp()
 
 bool CPU::op_cpx()
 {
-    uint8_t operand = read(m_address);
-    uint8_t value = m_registers.X - operand;
-    set_status_flag(STATUS_C, m_registers.X >= operand);
+    uint8_t operand = read(m_state.address);
+    uint8_t value = m_state.registers.X - operand;
+    set_status_flag(STATUS_C, m_state.registers.X >= operand);
     set_status_zn_flags(value);
 
     return false;
@@ -888,9 +1446,9 @@ bool CPU::op_cpx()
 
 bool CPU::op_cpy()
 {
-    uint8_t operand = read(m_address);
-    uint8_t value = m_registers.Y - operand;
-    set_status_flag(STATUS_C, m_registers.Y >= operand);
+    uint8_t operand = read(m_state.address);
+    uint8_t value = m_state.registers.Y - operand;
+    set_status_flag(STATUS_C, m_state.registers.Y >= operand);
     set_status_zn_flags(value);
 
     return false;
@@ -898,41 +1456,41 @@ bool CPU::op_cpy()
 
 bool CPU::op_and()
 {
-    m_registers.A &= read(m_address);
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A &= read(m_state.address);
+    set_status_zn_flags(m_state.registers.A);
 
     return true;
 }
 
 bool CPU::op_eor()
 {
-    m_registers.A ^= read(m_address);
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A ^= read(m_state.address);
+    set_status_zn_flags(m_state.registers.A);
 
     return true;
 }
 
 bool CPU::op_ora()
 {
-    m_registers.A |= read(m_address);
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A |= read(m_state.address);
+    set_status_zn_flags(m_state.registers.A);
 
     return true;
 }
 
 bool CPU::op_asl()
 {
-    if (m_addressing_mode == AM_IMPLIED)
+    if (m_state.addressing_mode == AM_IMPLIED)
     {
-        set_status_flag(STATUS_C, m_registers.A >> 7);
-        m_registers.A <<= 1;
-        set_status_zn_flags(m_registers.A);
+        set_status_flag(STATUS_C, m_state.registers.A >> 7);
+        m_state.registers.A <<= 1;
+        set_status_zn_flags(m_state.registers.A);
     }
     else
     {
-        uint8_t operand = read(m_address);
+        uint8_t operand = read(m_state.address);
         uint8_t value = operand << 1;
-        write(m_address, value);
+        write(m_state.address, value);
         set_status_flag(STATUS_C, operand >> 7);
         set_status_zn_flags(value);
     }
@@ -942,17 +1500,17 @@ bool CPU::op_asl()
 
 bool CPU::op_lsr()
 {
-    if (m_addressing_mode == AM_IMPLIED)
+    if (m_state.addressing_mode == AM_IMPLIED)
     {
-        set_status_flag(STATUS_C, m_registers.A & 1);
-        m_registers.A >>= 1;
-        set_status_zn_flags(m_registers.A);
+        set_status_flag(STATUS_C, m_state.registers.A & 1);
+        m_state.registers.A >>= 1;
+        set_status_zn_flags(m_state.registers.A);
     }
     else
     {
-        uint8_t operand = read(m_address);
+        uint8_t operand = read(m_state.address);
         uint8_t value = operand >> 1;
-        write(m_address, value);
+        write(m_state.address, value);
         set_status_flag(STATUS_C, operand & 1);
         set_status_zn_flags(value);
     }
@@ -963,17 +1521,17 @@ bool CPU::op_lsr()
 bool CPU::op_rol()
 {
     uint8_t carry = check_status_flag(STATUS_C);
-    if (m_addressing_mode == AM_IMPLIED)
+    if (m_state.addressing_mode == AM_IMPLIED)
     {
-        set_status_flag(STATUS_C, m_registers.A >> 7);
-        m_registers.A = (m_registers.A << 1) | carry;
-        set_status_zn_flags(m_registers.A);
+        set_status_flag(STATUS_C, m_state.registers.A >> 7);
+        m_state.registers.A = (m_state.registers.A << 1) | carry;
+        set_status_zn_flags(m_state.registers.A);
     }
     else
     {
-        uint8_t operand = read(m_address);
+        uint8_t operand = read(m_state.address);
         uint8_t value = (operand << 1) | carry;
-        write(m_address, value);
+        write(m_state.address, value);
         set_status_flag(STATUS_C, operand >> 7);
         set_status_zn_flags(value);
     }
@@ -984,17 +1542,17 @@ bool CPU::op_rol()
 bool CPU::op_ror()
 {
     uint8_t carry = check_status_flag(STATUS_C);
-    if (m_addressing_mode == AM_IMPLIED)
+    if (m_state.addressing_mode == AM_IMPLIED)
     {
-        set_status_flag(STATUS_C, m_registers.A & 1);
-        m_registers.A = (carry << 7) | (m_registers.A >> 1);
-        set_status_zn_flags(m_registers.A);
+        set_status_flag(STATUS_C, m_state.registers.A & 1);
+        m_state.registers.A = (carry << 7) | (m_state.registers.A >> 1);
+        set_status_zn_flags(m_state.registers.A);
     }
     else
     {
-        uint8_t operand = read(m_address);
+        uint8_t operand = read(m_state.address);
         uint8_t value = (carry << 7) | (operand >> 1);
-        write(m_address, value);
+        write(m_state.address, value);
         set_status_flag(STATUS_C, operand & 1);
         set_status_zn_flags(value);
     }
@@ -1004,13 +1562,13 @@ bool CPU::op_ror()
 
 bool CPU::op_bit()
 {
-    uint8_t value = read(m_address);
+    uint8_t value = read(m_state.address);
 
     set_status_flag(STATUS_Z, false);
     set_status_flag(STATUS_V, false);
     set_status_flag(STATUS_N, false);
 
-    if ((m_registers.A & value) == 0)
+    if ((m_state.registers.A & value) == 0)
         set_status_flag(STATUS_Z, true);
 
     if (value & 0x40)
@@ -1024,37 +1582,37 @@ bool CPU::op_bit()
 
 bool CPU::op_lax()
 {
-    m_registers.A = read(m_address);
-    m_registers.X = m_registers.A;
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A = read(m_state.address);
+    m_state.registers.X = m_state.registers.A;
+    set_status_zn_flags(m_state.registers.A);
 
     return true;
 }
 
 bool CPU::op_sax()
 {
-    write(m_address, m_registers.A & m_registers.X);
+    write(m_state.address, m_state.registers.A & m_state.registers.X);
     return false;
 }
 
 bool CPU::op_axs()
 {
-    uint8_t value = read(m_address);
-    m_registers.X &= m_registers.A;
-    set_status_flag(STATUS_C, m_registers.X >= value);
+    uint8_t value = read(m_state.address);
+    m_state.registers.X &= m_state.registers.A;
+    set_status_flag(STATUS_C, m_state.registers.X >= value);
 
-    m_registers.X -= value;
-    set_status_zn_flags(m_registers.X);
+    m_state.registers.X -= value;
+    set_status_zn_flags(m_state.registers.X);
 
     return false;
 }
 
 bool CPU::op_dcp()
 {
-    uint8_t operand = read(m_address) - 1;
-    write(m_address, operand);
-    uint8_t value = m_registers.A - operand;
-    set_status_flag(STATUS_C, m_registers.A >= operand);
+    uint8_t operand = read(m_state.address) - 1;
+    write(m_state.address, operand);
+    uint8_t value = m_state.registers.A - operand;
+    set_status_flag(STATUS_C, m_state.registers.A >= operand);
     set_status_zn_flags(value);
 
     return false;
@@ -1062,126 +1620,126 @@ bool CPU::op_dcp()
 
 bool CPU::op_isc()
 {
-    uint8_t inc = read(m_address) + 1;
-    write(m_address, inc);
+    uint8_t inc = read(m_state.address) + 1;
+    write(m_state.address, inc);
 
     inc ^= 0xFF;
-    bool sign = (m_registers.A & 0x80) == (inc & 0x80);
-    uint16_t value = m_registers.A + inc + check_status_flag(STATUS_C);
-    m_registers.A = value & 0xFF;
-    bool overflow = sign && (m_registers.A & 0x80) != (inc & 0x80);
+    bool sign = (m_state.registers.A & 0x80) == (inc & 0x80);
+    uint16_t value = m_state.registers.A + inc + check_status_flag(STATUS_C);
+    m_state.registers.A = value & 0xFF;
+    bool overflow = sign && (m_state.registers.A & 0x80) != (inc & 0x80);
 
     set_status_flag(STATUS_C, (value & 0x100) >> 8);
     set_status_flag(STATUS_V, overflow);
-    set_status_zn_flags(m_registers.A);
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_slo()
 {
-    uint8_t operand = read(m_address);
+    uint8_t operand = read(m_state.address);
     uint8_t value = operand << 1;
     set_status_flag(STATUS_C, operand >> 7);
-    write(m_address, value);
-    m_registers.A |= value;
-    set_status_zn_flags(m_registers.A);
+    write(m_state.address, value);
+    m_state.registers.A |= value;
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_rla()
 {
-    uint8_t operand = read(m_address);
+    uint8_t operand = read(m_state.address);
     uint8_t value = (operand << 1) | (check_status_flag(STATUS_C) ? 1 : 0);
     set_status_flag(STATUS_C, operand >> 7);
-    write(m_address, value);
-    m_registers.A &= value;
-    set_status_zn_flags(m_registers.A);
+    write(m_state.address, value);
+    m_state.registers.A &= value;
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_sre()
 {
-    uint8_t operand = read(m_address);
+    uint8_t operand = read(m_state.address);
     uint8_t value = operand >> 1;
     set_status_flag(STATUS_C, operand & 1);
-    write(m_address, value);
-    m_registers.A ^= value;
-    set_status_zn_flags(m_registers.A);
+    write(m_state.address, value);
+    m_state.registers.A ^= value;
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_rra()
 {
-    uint8_t operand = read(m_address);
+    uint8_t operand = read(m_state.address);
     uint8_t value = ((check_status_flag(STATUS_C) ? 1 : 0) << 7) | (operand >> 1);
     set_status_flag(STATUS_C, operand & 1);
-    write(m_address, value);
+    write(m_state.address, value);
 
-    bool sign = (m_registers.A >> 7) == (value >> 7);
-    uint16_t result = m_registers.A + value + (check_status_flag(STATUS_C) ? 1 : 0);
-    m_registers.A = result & 0xFF;
-    bool overflow = sign && (m_registers.A >> 7) != (value >> 7);
+    bool sign = (m_state.registers.A >> 7) == (value >> 7);
+    uint16_t result = m_state.registers.A + value + (check_status_flag(STATUS_C) ? 1 : 0);
+    m_state.registers.A = result & 0xFF;
+    bool overflow = sign && (m_state.registers.A >> 7) != (value >> 7);
 
     set_status_flag(STATUS_C, (result & 0x100) >> 8);
     set_status_flag(STATUS_V, overflow);
-    set_status_zn_flags(m_registers.A);
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_anc()
 {
-    m_registers.A &= read(m_address);
-    set_status_flag(STATUS_C, m_registers.A >> 7);
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A &= read(m_state.address);
+    set_status_flag(STATUS_C, m_state.registers.A >> 7);
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_alr()
 {
-    m_registers.A &= read(m_address);
-    set_status_flag(STATUS_C, m_registers.A & 1);
-    m_registers.A >>= 1;
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A &= read(m_state.address);
+    set_status_flag(STATUS_C, m_state.registers.A & 1);
+    m_state.registers.A >>= 1;
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_arr()
 {
-    m_registers.A &= read(m_address);
-    m_registers.A = ((check_status_flag(STATUS_C) ? 1 : 0) << 7) | (m_registers.A >> 1);
+    m_state.registers.A &= read(m_state.address);
+    m_state.registers.A = ((check_status_flag(STATUS_C) ? 1 : 0) << 7) | (m_state.registers.A >> 1);
 
-    bool bit6 = (m_registers.A >> 6) & 1;
-    bool bit5 = (m_registers.A >> 5) & 1;
+    bool bit6 = (m_state.registers.A >> 6) & 1;
+    bool bit5 = (m_state.registers.A >> 5) & 1;
 
     set_status_flag(STATUS_C, bit6);
     set_status_flag(STATUS_V, bit5 ^ bit6);
-    set_status_zn_flags(m_registers.A);
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_xaa()
 {
-    m_registers.A = m_registers.X;
-    m_registers.A &= read(m_address);
-    set_status_zn_flags(m_registers.A);
+    m_state.registers.A = m_state.registers.X;
+    m_state.registers.A &= read(m_state.address);
+    set_status_zn_flags(m_state.registers.A);
 
     return false;
 }
 
 bool CPU::op_las()
 {
-    uint8_t value = m_registers.SP & read(m_address);
-    m_registers.A = value;
-    m_registers.X = value;
-    m_registers.SP = value;
+    uint8_t value = m_state.registers.SP & read(m_state.address);
+    m_state.registers.A = value;
+    m_state.registers.X = value;
+    m_state.registers.SP = value;
     set_status_zn_flags(value);
 
     return true;
@@ -1189,36 +1747,36 @@ bool CPU::op_las()
 
 bool CPU::op_ahx()
 {
-    write(m_address, ((m_address >> 8) + 1) & m_registers.A & m_registers.X);
+    write(m_state.address, ((m_state.address >> 8) + 1) & m_state.registers.A & m_state.registers.X);
     return false;
 }
 
 bool CPU::op_tas()
 {
-    m_registers.SP = m_registers.X & m_registers.A;
-    write(m_address, m_registers.SP & ((m_address >> 8) + 1));
+    m_state.registers.SP = m_state.registers.X & m_state.registers.A;
+    write(m_state.address, m_state.registers.SP & ((m_state.address >> 8) + 1));
 
     return false;
 }
 
 bool CPU::op_shy()
 {
-    uint8_t low = m_address & 0x00FF;
-    uint8_t high = m_address >> 8;
-    uint8_t data = m_registers.Y & (high + 1);
+    uint8_t low = m_state.address & 0x00FF;
+    uint8_t high = m_state.address >> 8;
+    uint8_t data = m_state.registers.Y & (high + 1);
 
-    write(((m_registers.Y & (high + 1)) << 8) | low, data);
+    write(((m_state.registers.Y & (high + 1)) << 8) | low, data);
 
     return false;
 }
 
 bool CPU::op_shx()
 {
-    uint8_t low = m_address & 0x00FF;
-    uint8_t high = m_address >> 8;
-    uint8_t data = m_registers.X & (high + 1);
+    uint8_t low = m_state.address & 0x00FF;
+    uint8_t high = m_state.address >> 8;
+    uint8_t data = m_state.registers.X & (high + 1);
 
-    write(((m_registers.X & (high + 1)) << 8) | low, data);
+    write(((m_state.registers.X & (high + 1)) << 8) | low, data);
 
     return false;
 }
@@ -1230,6 +1788,6 @@ bool CPU::op_nop()
 
 bool CPU::op_hlt()
 {
-    LOG_ERROR("CPU: halt! opcode: %02X", m_opcode);
+    LOG_ERROR("CPU: halt! opcode: %02X", m_state.opcode);
     return false;
 }
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "block_cache.hpp"
+#include "jit_x64.hpp"
 #include <cstdint>
-#include <string>
+#include <memory>
 
 class SystemBus;
 
@@ -59,6 +61,51 @@ public:
     static constexpr uint16_t RST_Vector = 0xFFFC;
     static constexpr uint16_t IRQ_Vector = 0xFFFE;
 
+    enum class Mnemonic : uint8_t
+    {
+        ADC, AHX, ALR, ANC, AND, ARR, ASL, AXS, BCC, BCS, BEQ, BIT, BMI, BNE, BPL,
+        BRK, BVC, BVS, CLC, CLD, CLI, CLV, CMP, CPX, CPY, DCP, DEC, DEX, DEY, EOR,
+        HLT, INC, INX, INY, ISC, JMP, JSR, LAS, LAX, LDA, LDX, LDY, LSR, NOP, ORA,
+        PHA, PHP, PLA, PLP, RLA, ROL, ROR, RRA, RTI, RTS, SAX, SBC, SEC, SED, SEI,
+        SHX, SHY, SLO, SRE, STA, STX, STY, TAS, TAX, TAY, TSX, TXA, TXS, TYA, XAA
+    };
+
+    // Instruction class, what the code looking ahead of the interpreter
+    // relies on
+    enum InstructionFlags : uint8_t
+    {
+        INS_NONE = 0,
+        INS_ENDS_BLOCK = (1 << 0),  // Can change the program counter
+        INS_READ = (1 << 1),        // Reads its operand, changes only registers and flags
+        INS_STORE = (1 << 2),       // Writes a register, changes nothing else
+        INS_MODIFY = (1 << 3),      // Reads, changes and writes back its operand or A
+        INS_REGISTER = (1 << 4),    // No bus access, changes only registers and flags
+        INS_STACK = (1 << 5),       // Pushes or pulls a register
+        INS_PAGE_CROSS = (1 << 6)   // A cycle more when indexing crosses a page
+    };
+
+    struct InstructionInfo
+    {
+        const char* mnemonic;
+        Mnemonic id;
+        AddressingMode addressing_mode;
+        uint8_t cycles;
+        uint8_t flags;
+    };
+
+    // What the instructions change, part of the machine state
+    struct State
+    {
+        Registers registers;
+        uint16_t cycles = 0;
+        uint16_t dma_cycles = 0;
+        uint16_t address = 0;
+        uint8_t opcode = 0;
+        AddressingMode addressing_mode = AM_IMPLIED;
+        uint64_t total_cycles = 0;
+        uint64_t instructions = 0;
+    };
+
 public:
     CPU(SystemBus& system_bus):
         m_system_bus(system_bus)
@@ -68,39 +115,120 @@ public:
     void irq();
     void nmi();
     void tick();
+    void run_until(uint64_t target_cycle);
     void dma();
 
+    // Executes the next instruction, on an instruction boundary. With the JIT
+    // enabled a whole compiled block runs instead when it cannot go past
+    // limit_cycle, so nothing must be able to interrupt the CPU before it.
+    void step(uint64_t limit_cycle);
+
+    // Runs code from PRG ROM through the decoded block cache instead of the interpreter
+    void set_block_cache_enabled(bool enabled);
+    bool block_cache_enabled() const { return m_block_cache_enabled; }
+    size_t cached_blocks() const { return m_block_cache.block_count(); }
+
+    // Runs hot PRG ROM blocks as native code, fails on other architectures than x86-64
+    bool set_jit_enabled(bool enabled);
+    bool jit_enabled() const { return m_jit != nullptr; }
+    size_t compiled_blocks() const { return m_jit ? m_jit->compiled_blocks() : 0; }
+
+    // Repeats short loops which only read memory and leave the registers
+    // unchanged, like waiting for vertical blank on $2002 or for a flag set
+    // by the NMI handler, until something outside the CPU changes. Instruction
+    // mode only.
+    void set_idle_loop_skipping_enabled(bool enabled);
+    bool idle_loop_skipping_enabled() const { return m_idle_loop_skipping_enabled; }
+    uint64_t skipped_cycles() const { return m_skipped_cycles; }
+
+    // At the start of a detected idle loop, idle_loop() has something to check
+    bool at_idle_loop() const { return m_state.registers.PC == m_idle_loop.start && m_idle_loop.valid; }
+    // Called at each instruction boundary, true at the start of an idle loop
+    // whose last iteration read the same PPU status
+    bool idle_loop(uint8_t ppu_status);
+    // Skips whole iterations of the idle loop without going past limit_cycle,
+    // nothing must be able to interrupt the CPU or change what the loop reads
+    // before it
+    bool skip_idle_loop(uint64_t limit_cycle);
+
+    const Registers& registers() const { return m_state.registers; }
+
+    const State& state() const { return m_state; }
+    // The decoded code is looked up again from the loaded state
+    void load_state(const State& state);
+
+    uint64_t cycles() const { return m_state.total_cycles; }
+    uint64_t pending_cycles() const { return m_state.cycles + m_state.dma_cycles; }
+    uint64_t instructions() const { return m_state.instructions; }
+
+    // Disassembly metadata, not used when executing
+    static const InstructionInfo& instruction_info(uint8_t opcode) { return m_instruction_info[opcode]; }
+    static uint8_t instruction_length(AddressingMode addressing_mode);
+
 private:
-    struct Instruction
+    typedef void (*DecodedHandler)(CPU& cpu, uint16_t operand);
+
+    static constexpr uint32_t JIT_Threshold = 16;
+    static constexpr uint16_t IdleLoop_MaxLength = 16;
+
+    struct IdleLoop
     {
-        bool (CPU::*read_address)(void) = nullptr;
-        bool (CPU::*execute)(void) = nullptr;
-        std::string mnemonic = "";
-        AddressingMode addressing_mode = AddressingMode::AM_IMPLIED;
-        uint8_t cycles = 0;
+        uint16_t start = 0;
+        uint16_t end = 0;               // Address of the branch back to start
+        bool valid = false;             // Only reads memory the CPU alone can change, or $2002
+        uint8_t length = 0;             // Instructions
+        uint32_t version = 0;           // Memory map version the code was decoded with
+        bool started = false;           // Registers saved at start
+        Registers registers;
+        uint8_t ppu_status = 0;
+        uint64_t cycles = 0;
+        uint64_t instructions = 0;
+        uint64_t iteration_cycles = 0;  // Set once an iteration changed nothing
     };
 
-    static Instruction m_instruction_table[256];
+    static const InstructionInfo m_instruction_info[256];
+    static const DecodedHandler m_decoded_handlers[256];
 
     SystemBus& m_system_bus;
-    Registers m_registers;
-    uint8_t m_opcode = 0;
-    AddressingMode m_addressing_mode = AM_IMPLIED;
-    uint16_t m_address = 0;
-    uint16_t m_cycles = 0;
-    uint16_t m_dma_cycles = 0;
-    uint64_t m_total_cycles = 0;
+    State m_state;
+
+    BlockCache m_block_cache;
+    bool m_block_cache_enabled = false;
+    const DecodedInstruction* m_decoded = nullptr;
+    uint32_t m_decoded_version = 0;
+
+    std::unique_ptr<JitX64> m_jit;
+    bool m_jit_block_start = true;
+
+    bool m_idle_loop_skipping_enabled = false;
+    IdleLoop m_idle_loop;
+    uint64_t m_skipped_cycles = 0;
+
+    template <bool (CPU::*ReadAddress)(), bool (CPU::*Execute)(), AddressingMode Mode, uint8_t Cycles>
+    void execute_instruction();
+    void execute_next_instruction();
+
+    template <AddressingMode Mode, bool (CPU::*Execute)(), uint8_t Cycles>
+    static void execute_decoded(CPU& cpu, uint16_t operand);
+    template <AddressingMode Mode>
+    bool resolve_address(uint16_t operand);
+    bool execute_cached_instruction();
+    const DecodedInstruction* find_block();
+    CodeBlock* lookup_block(uint16_t address, uint32_t rom_offset);
+    CodeBlock* decode_block(uint16_t address, uint32_t rom_offset);
+    bool execute_native_block(uint64_t limit_cycle);
+    void detect_idle_loop(uint16_t address);
 
     void interrupt(InterruptType type);
 
     void set_status_flag(StatusFlag flag, bool value)
     {
-        m_registers.P = value ? m_registers.P | flag : m_registers.P & (~flag);
+        m_state.registers.P = value ? m_state.registers.P | flag : m_state.registers.P & (~flag);
     }
 
     bool check_status_flag(StatusFlag flag)
     {
-        return (m_registers.P & flag) != 0;
+        return (m_state.registers.P & flag) != 0;
     }
 
     void set_status_zn_flags(uint8_t value);
@@ -0,0 +1,255 @@
+#include "emulation_thread.hpp"
+
+EmulationThread::EmulationThread() :
+    m_nes(m_input)
+{
+}
+
+EmulationThread::~EmulationThread()
+{
+    stop();
+}
+
+void EmulationThread::set_rewind_buffer_size(size_t size)
+{
+    m_rewind.init(size, size > 0 ? RewindMaxFrames : 0);
+}
+
+void EmulationThread::start()
+{
+    if (m_thread.joinable())
+        return;
+
+    m_quit = false;
+    m_running = m_nes.running();
+    m_paused = m_nes.paused();
+    m_thread = std::thread(&EmulationThread::run, this);
+}
+
+void EmulationThread::stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    m_quit = true;
+    m_thread.join();
+}
+
+void EmulationThread::set_buttons_state(const uint8_t* buttons, uint8_t count)
+{
+    for (uint8_t i = 0; i < count && i < Controller::ControllerCount; i++)
+        m_input.set_buttons_state(i, buttons[i]);
+}
+
+EmulationThread::RewindStats EmulationThread::rewind_stats() const
+{
+    RewindStats stats;
+    stats.frames = m_rewind_frames.load(std::memory_order_relaxed);
+    stats.memory = m_rewind_memory.load(std::memory_order_relaxed);
+    stats.capture_time = m_rewind_capture_time.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void EmulationThread::Input::poll_buttons_state(uint8_t* buttons, uint8_t count)
+{
+    for (uint8_t i = 0; i < count && i < Controller::ControllerCount; i++)
+        buttons[i] = m_buttons[i].load(std::memory_order_relaxed);
+}
+
+void EmulationThread::run()
+{
+    auto next_frame = std::chrono::steady_clock::now();
+
+    while (!m_quit)
+    {
+        process_commands();
+
+        const auto now = std::chrono::steady_clock::now();
+        if (!m_nes.running() || m_nes.paused() || m_held)
+        {
+            drop_sound();
+            next_frame = now + FramePeriod;
+            std::this_thread::sleep_until(next_frame);
+            continue;
+        }
+
+        // Starts over instead of running the missed frames back to back
+        if (now > next_frame + 2 * FramePeriod)
+            next_frame = now;
+
+        next_frame += FramePeriod;
+        const auto start = std::chrono::steady_clock::now();
+        if (m_rewinding)
+            rewind_frame();
+        else
+        {
+            run_frame(next_frame);
+            capture_state();
+        }
+
+        // Smoothed over about a second
+        const float frame_time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_frame_time += (frame_time - m_frame_time) / 64;
+        m_frame_time_ms.store(m_frame_time, std::memory_order_relaxed);
+
+        m_frames.publish(m_nes.screen_buffer());
+
+        std::this_thread::sleep_until(next_frame);
+    }
+}
+
+void EmulationThread::process_commands()
+{
+    Command command;
+    while (m_commands.pop(command))
+    {
+        switch (command.type)
+        {
+        case Command::LoadRom:
+            if (m_nes.load_rom_file(command.path))
+            {
+                m_rewind.clear();
+                m_events.push({ Event::RomLoaded, command.path });
+            }
+            break;
+        case Command::LoadPalette:
+            m_nes.load_palette_file(command.path);
+            break;
+        case Command::Reset:
+            m_nes.reset();
+            break;
+        case Command::PowerOff:
+            m_nes.power_off();
+            m_rewind.clear();
+            break;
+        case Command::TogglePause:
+            m_nes.toggle_pause();
+            break;
+        case Command::SetFastForward:
+            m_fast_forward = command.value != 0;
+            break;
+        case Command::SetFastForwardSpeed:
+            m_fast_forward_speed = command.value;
+            break;
+        case Command::SetRewind:
+            m_rewinding = command.value != 0;
+            break;
+        case Command::SetRunAhead:
+            m_run_ahead = command.value;
+            break;
+        case Command::SetHold:
+            m_held = command.value != 0;
+            break;
+        }
+    }
+
+    update_rewind_stats();
+
+    m_running.store(m_nes.running(), std::memory_order_relaxed);
+    m_paused.store(m_nes.paused(), std::memory_order_relaxed);
+}
+
+void EmulationThread::run_frame(std::chrono::steady_clock::time_point deadline)
+{
+    if (!m_fast_forward && m_run_ahead > 0)
+    {
+        // Only the frame ahead is drawn and only the emulated frame is heard.
+        // The emulator is back at the emulated frame for the rewind capture.
+        m_nes.run(false);
+        output_sound();
+        m_nes.run_ahead(m_run_ahead);
+        return;
+    }
+
+    if (!m_fast_forward)
+    {
+        m_nes.run();
+        output_sound();
+        return;
+    }
+
+    // Only the last frame is drawn. The sound is dropped so the emulation
+    // never waits for the sound output.
+    if (m_fast_forward_speed > 0)
+    {
+        for (int i = 1; i < m_fast_forward_speed; i++)
+        {
+            m_nes.run(false);
+            drop_sound();
+        }
+    }
+    else
+    {
+        // Leaves a quarter of the frame period to draw the last one
+        while (std::chrono::steady_clock::now() < deadline - FramePeriod / 4)
+        {
+            m_nes.run(false);
+            drop_sound();
+        }
+    }
+
+    m_nes.run();
+    drop_sound();
+}
+
+void EmulationThread::rewind_frame()
+{
+    // The frame stepped back to is run again to show it, without sound.
+    // Nothing changes once the buffer is empty.
+    if (m_rewind.pop(m_state) && m_nes.load_state(m_state))
+        m_nes.run();
+
+    drop_sound();
+    update_rewind_stats();
+}
+
+void EmulationThread::capture_state()
+{
+    if (!m_rewind.enabled())
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+    m_nes.save_state(m_state);
+    m_rewind.push(m_state);
+    const auto end = std::chrono::steady_clock::now();
+
+    // Smoothed over about a second
+    const float capture_time = std::chrono::duration<float, std::micro>(end - start).count();
+    m_capture_time += (capture_time - m_capture_time) / 64;
+    m_rewind_capture_time.store(m_capture_time, std::memory_order_relaxed);
+    update_rewind_stats();
+}
+
+void EmulationThread::update_rewind_stats()
+{
+    m_rewind_frames.store(m_rewind.frame_count(), std::memory_order_relaxed);
+    m_rewind_memory.store(m_rewind.used(), std::memory_order_relaxed);
+}
+
+void EmulationThread::output_sound()
+{
+    if (!m_sound_output)
+    {
+        drop_sound();
+        return;
+    }
+
+    // Every frame, the sound output does not block
+    long buffered = 0;
+    while (m_nes.sound_samples_available() > 0)
+    {
+        const long size = m_nes.read_sound_samples(m_sound_buffer, APU::SoundBufferSize);
+        buffered = m_sound_output(m_sound_buffer, size);
+    }
+
+    m_nes.set_sound_rate_ratio(m_rate_control.update(buffered));
+}
+
+void EmulationThread::drop_sound()
+{
+    while (m_nes.sound_samples_available() > 0)
+        m_nes.read_sound_samples(m_sound_buffer, APU::SoundBufferSize);
+
+    if (m_sound_output)
+        m_sound_output(nullptr, 0);
+}
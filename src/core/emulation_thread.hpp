@@ -0,0 +1,148 @@
+#pragma once
+
+#include "emulator.hpp"
+#include "frame_exchange.hpp"
+#include "input_source.hpp"
+#include "rate_control.hpp"
+#include "rewind_buffer.hpp"
+#include "spsc_queue.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs the emulator on its own thread, paced by a 60 Hz timer. The UI thread
+// talks to it through a command queue, takes the finished frames from a
+// triple buffer and feeds it the buttons state, so neither waits for the other.
+class EmulationThread
+{
+public:
+    struct Command
+    {
+        enum Type
+        {
+            LoadRom,
+            LoadPalette,
+            Reset,
+            PowerOff,
+            TogglePause,
+            SetFastForward,     // value: 0 or 1
+            SetFastForwardSpeed, // value: frames per displayed frame, 0 as many as fit
+            SetRewind,          // value: 0 or 1, steps back a frame per frame period while set
+            SetRunAhead,        // value: frames shown ahead of the emulated one, 0 disables it
+            SetHold             // value: 0 or 1, stops the emulation while set, apart from the pause
+        };
+
+        Type type = Reset;
+        int value = 0;
+        std::string path;
+    };
+
+    struct Event
+    {
+        enum Type
+        {
+            RomLoaded
+        };
+
+        Type type = RomLoaded;
+        std::string path;
+    };
+
+    // Receives the sound samples of the frames run at normal speed, after
+    // each frame, and returns the samples it has buffered. Must not block.
+    // Called with no samples on the frames without sound: paused, without a
+    // ROM, fast forward or rewind.
+    using SoundOutput = std::function<long(const blip_sample_t* samples, long count)>;
+
+    struct RewindStats
+    {
+        uint32_t frames = 0;        // Frames which can be gone back
+        uint64_t memory = 0;        // Bytes they take
+        float capture_time = 0;     // Microseconds to capture a frame, smoothed
+    };
+
+    static constexpr std::chrono::nanoseconds FramePeriod{ 1000000000 / 60 };
+    // Thirty minutes at most, the buffer size usually runs out first
+    static constexpr uint32_t RewindMaxFrames = 60 * 60 * 30;
+
+public:
+    EmulationThread();
+    ~EmulationThread();
+
+    // The emulator can only be used directly before start()
+    Emulator& emulator() { return m_nes; }
+    // The sample rate follows the buffered samples to keep them around target
+    void set_sound_output(SoundOutput output, long target)
+    {
+        m_sound_output = std::move(output);
+        m_rate_control.set_target(target);
+    }
+
+    // The state of every frame run goes into a rewind buffer of this many
+    // bytes, 0 disables it
+    void set_rewind_buffer_size(size_t size);
+
+    void start();
+    void stop();
+
+    // UI thread side. send() is false if the queue is full.
+    bool send(const Command& command) { return m_commands.push(command); }
+    bool poll_event(Event& event) { return m_events.pop(event); }
+    void set_buttons_state(const uint8_t* buttons, uint8_t count);
+    const uint32_t* latest_frame() { return m_frames.latest(); }
+    bool running() const { return m_running.load(std::memory_order_relaxed); }
+    bool paused() const { return m_paused.load(std::memory_order_relaxed); }
+    RewindStats rewind_stats() const;
+    // Milliseconds to emulate a displayed frame, run ahead included, smoothed
+    float frame_time() const { return m_frame_time_ms.load(std::memory_order_relaxed); }
+
+private:
+    // Buttons state written by the UI thread, latched by the emulator
+    class Input : public InputSource
+    {
+    public:
+        void poll_buttons_state(uint8_t* buttons, uint8_t count) override;
+        void set_buttons_state(uint8_t index, uint8_t state) { m_buttons[index].store(state, std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint8_t> m_buttons[Controller::ControllerCount] = {};
+    };
+
+    Input m_input;
+    Emulator m_nes;
+    std::thread m_thread;
+    std::atomic<bool> m_quit = false;
+    std::atomic<bool> m_running = false;
+    std::atomic<bool> m_paused = false;
+    SpscQueue<Command, 64> m_commands;
+    SpscQueue<Event, 16> m_events;
+    FrameExchange m_frames;
+    SoundOutput m_sound_output;
+    RateControl m_rate_control;
+    blip_sample_t m_sound_buffer[APU::SoundBufferSize] = {};
+    bool m_fast_forward = false;
+    int m_fast_forward_speed = 4;
+    RewindBuffer m_rewind;
+    std::vector<uint8_t> m_state;
+    bool m_rewinding = false;
+    float m_capture_time = 0;
+    std::atomic<uint32_t> m_rewind_frames = 0;
+    std::atomic<uint64_t> m_rewind_memory = 0;
+    std::atomic<float> m_rewind_capture_time = 0;
+    int m_run_ahead = 0;
+    bool m_held = false;
+    float m_frame_time = 0;
+    std::atomic<float> m_frame_time_ms = 0;
+
+    void run();
+    void process_commands();
+    void run_frame(std::chrono::steady_clock::time_point deadline);
+    void rewind_frame();
+    void capture_state();
+    void update_rewind_stats();
+    void output_sound();
+    void drop_sound();
+};
@@ -1,13 +1,14 @@
 #include "emulator.hpp"
-#include "input_manager.hpp"
+#include "state.hpp"
 #include "logger.hpp"
-#include <iostream>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 
-Emulator::Emulator(InputManager& input_manager):
+Emulator::Emulator(InputSource& input_source):
     m_ppu(m_cartridge),
-    m_controller(input_manager),
-    m_system_bus(m_apu, m_ppu, m_cartridge, m_controller),
+    m_controller(input_source),
+    m_system_bus(m_apu, m_ppu, m_cartridge, m_controller, m_scheduler),
     m_cpu(m_system_bus)
 {
     m_system_bus.set_cpu(&m_cpu);
@@ -30,6 +31,7 @@ void Emulator::reset()
     m_apu.reset();
     m_ppu.reset();
     m_cpu.reset();
+    m_scheduler.reset();
 }
 
 void Emulator::power_off()
@@ -37,7 +39,7 @@ void Emulator::power_off()
     m_cartridge.reset();
 }
 
-void Emulator::run()
+void Emulator::run(bool render)
 {
     if (!m_cartridge.loaded())
         return;
@@ -45,30 +47,158 @@ void Emulator::run()
     if (m_paused)
         return;
 
-    m_ppu.frame_start();
+    m_controller.latch_buttons();
+    run_frame(render);
+}
+
+bool Emulator::run_ahead(int frames)
+{
+    if (!m_cartridge.loaded() || m_paused || frames <= 0)
+        return false;
+
+    if (!save_state(m_run_ahead_state))
+        return false;
+
+    for (int i = 1; i <= frames; i++)
+        run_frame(i == frames);
+
+    // The frame buffer is not part of the state, it keeps the frame ahead.
+    // The samples of the frames ahead are dropped with the sound buffer.
+    return load_state(m_run_ahead_state);
+}
+
+void Emulator::run_frame(bool render)
+{
+    m_ppu.frame_start(render);
+    m_scheduler.invalidate();
+
+    if (m_execution_mode == ExecutionMode::Cycle)
+        run_cycles();
+    else
+        run_instructions();
+
+    m_apu.end_frame(m_cpu.cycles());
+}
 
+void Emulator::run_cycles()
+{
+    // The PPU catches up on the register accesses and the events
     while (!m_ppu.frame_rendered())
     {
-        // PPU is 3 times faster
-        m_ppu.tick();
-        m_ppu.tick();
-        m_ppu.tick();
         m_cpu.tick();
 
-        if (m_ppu.nmi())
+        if (m_scheduler.due(m_cpu.cycles()))
+            handle_events(m_cpu.cycles());
+    }
+}
+
+void Emulator::run_instructions()
+{
+    // Both modes leave the PPU at the same cycle as the CPU at the end of a frame
+    while (!m_ppu.frame_rendered())
+    {
+        // Nothing happens on the bus until the current instruction, interrupt or DMA completes
+        const uint64_t boundary = m_cpu.cycles() + m_cpu.pending_cycles();
+
+        // The frame can end before the boundary
+        if (m_scheduler.due(Scheduler::EVENT_FRAME_END, boundary))
         {
-            m_cpu.nmi();
-            m_ppu.nmi_clear();
+            m_ppu.run_until(boundary);
+            if (m_ppu.frame_rendered())
+            {
+                m_cpu.run_until(m_ppu.cpu_cycles());
+                break;
+            }
         }
 
-        if (m_cartridge.irq())
+        m_cpu.run_until(boundary);
+
+        // Interrupts are raised only by the scheduled events and the register
+        // accesses which invalidate them
+        if (m_scheduler.due(boundary))
+            handle_events(boundary);
+
+        if (m_cpu.pending_cycles() != 0)
+            continue;
+
+        // The instruction does all its bus accesses on its first cycle. A JIT
+        // block can run several instructions at once if it completes before
+        // the next event. An idle loop is skipped the same way, also stopping
+        // before the PPU status it may read changes.
+        if (m_cpu.idle_loop_skipping_enabled() && m_cpu.at_idle_loop())
         {
-            m_cpu.irq();
-            m_cartridge.irq_clear();
+            m_ppu.run_until(boundary + 1);
+            if (m_cpu.idle_loop(m_ppu.status()))
+            {
+                const uint64_t limit_cycle = std::min(m_scheduler.next_event(),
+                                                      cycle_after_dots(m_ppu.cpu_cycles(), m_ppu.dots_until_status_change()));
+                if (m_cpu.skip_idle_loop(limit_cycle))
+                    continue;
+            }
         }
+
+        m_cpu.step(m_scheduler.next_event());
+    }
+}
+
+void Emulator::handle_events(uint64_t cycle)
+{
+    const bool dmc_read = m_scheduler.due(Scheduler::EVENT_DMC_READ, cycle);
+    const bool reschedule = m_scheduler.invalidated() || dmc_read ||
+                            m_scheduler.due(Scheduler::EVENT_NMI, cycle) ||
+                            m_scheduler.due(Scheduler::EVENT_MAPPER_IRQ, cycle) ||
+                            m_scheduler.due(Scheduler::EVENT_FRAME_END, cycle);
+
+    // DMC sample reads go through the bus, before the CPU can switch banks
+    if (dmc_read)
+        m_apu.run_until(cycle);
+
+    // The APU IRQ stays raised until it is acknowledged, which invalidates
+    // the events. Until then it is polled alone when the CPU ignores it, the
+    // PPU and the mapper raise nothing before their next event.
+    if (!reschedule)
+    {
+        if (m_apu.irq(cycle))
+            m_cpu.irq();
+        return;
+    }
+
+    m_ppu.run_until(cycle);
+    poll_interrupts(cycle);
+
+    m_scheduler.schedule(Scheduler::EVENT_NMI, cycle_after_dots(cycle, m_ppu.dots_until_nmi()));
+    m_scheduler.schedule(Scheduler::EVENT_MAPPER_IRQ,
+                         cycle_after_dots(cycle, m_ppu.dots_until_scanline_counter(m_cartridge.scanlines_until_irq())));
+    m_scheduler.schedule(Scheduler::EVENT_APU_IRQ, m_apu.next_irq());
+    m_scheduler.schedule(Scheduler::EVENT_DMC_READ, m_apu.next_dmc_read());
+    m_scheduler.schedule(Scheduler::EVENT_FRAME_END, cycle_after_dots(cycle, m_ppu.dots_until_frame_end()));
+}
+
+uint64_t Emulator::cycle_after_dots(uint64_t cycle, uint32_t dots)
+{
+    // First CPU cycle which sees the PPU tick
+    if (dots == PPU::NoEvent)
+        return Scheduler::Never;
+
+    return cycle + (static_cast<uint64_t>(dots) + 2) / 3;
+}
+
+void Emulator::poll_interrupts(uint64_t cycle)
+{
+    if (m_ppu.nmi())
+    {
+        m_cpu.nmi();
+        m_ppu.nmi_clear();
+    }
+
+    if (m_cartridge.irq())
+    {
+        m_cpu.irq();
+        m_cartridge.irq_clear();
     }
 
-    m_apu.end_frame();
+    if (m_apu.irq(cycle))
+        m_cpu.irq();
 }
 
 bool Emulator::load_rom_file(const std::string& file_path)
@@ -95,6 +225,112 @@ bool Emulator::load_palette_file(const std::string& file_path)
     return true;
 }
 
+bool Emulator::save_state(std::vector<uint8_t>& state) const
+{
+    if (!m_cartridge.loaded())
+        return false;
+
+    StateHeader header;
+    header.rom_checksum = m_cartridge.rom_checksum();
+    header.mapper_id = m_cartridge.mapper_id();
+
+    APU::State apu;
+    m_apu.save_state(apu);
+
+    state.clear();
+    StateWriter writer(state);
+    writer.write(header);
+    writer.write(m_cpu.state());
+    writer.write(m_scheduler);
+    writer.write(m_controller.state());
+    writer.write(m_ppu.state());
+    writer.write(m_system_bus.state());
+    writer.write(apu);
+    writer.write(m_cartridge.state());
+
+    header.size = static_cast<uint32_t>(state.size());
+    std::memcpy(state.data(), &header, sizeof(header));
+
+    return true;
+}
+
+bool Emulator::load_state(const std::vector<uint8_t>& state)
+{
+    if (!m_cartridge.loaded())
+        return false;
+
+    StateReader reader(state.data(), state.size());
+    StateHeader header;
+    if (!reader.read(header) || header.magic != StateMagic || header.size != state.size())
+    {
+        LOG_ERROR("Invalid save state");
+        return false;
+    }
+
+    if (header.version != StateVersion)
+    {
+        LOG_ERROR("Save state version %u is not supported", header.version);
+        return false;
+    }
+
+    if (header.mapper_id != m_cartridge.mapper_id() || header.rom_checksum != m_cartridge.rom_checksum())
+    {
+        LOG_ERROR("Save state of another game");
+        return false;
+    }
+
+    MachineState loaded;
+    if (!reader.read(loaded.cpu) || !reader.read(loaded.scheduler) || !reader.read(loaded.controller) ||
+        !reader.read(loaded.ppu) || !reader.read(loaded.system_bus) || !reader.read(loaded.apu) ||
+        !reader.read(loaded.mapper) || reader.remaining() != 0)
+    {
+        LOG_ERROR("Invalid save state");
+        return false;
+    }
+
+    return load_machine_state(loaded);
+}
+
+bool Emulator::save_machine_state(MachineState& state) const
+{
+    if (!m_cartridge.loaded())
+        return false;
+
+    state.cpu = m_cpu.state();
+    state.scheduler = m_scheduler;
+    state.controller = m_controller.state();
+    state.ppu = m_ppu.state();
+    state.system_bus = m_system_bus.state();
+    m_apu.save_state(state.apu);
+    state.mapper = m_cartridge.state();
+
+    return true;
+}
+
+bool Emulator::load_machine_state(const MachineState& state)
+{
+    if (!m_cartridge.loaded())
+        return false;
+
+    // The parts used as indices are checked, the machine is left as it was
+    // when they are out of range. The mapper is the last part checked, it
+    // loads its state once it is valid.
+    if (!PPU::valid(state.ppu) || !m_cartridge.load_state(state.mapper))
+    {
+        LOG_ERROR("Invalid save state");
+        return false;
+    }
+
+    m_cpu.load_state(state.cpu);
+    m_scheduler = state.scheduler;
+    m_controller.load_state(state.controller);
+    m_ppu.load_state(state.ppu);
+    m_system_bus.load_state(state.system_bus);
+    m_apu.load_state(state.apu);
+
+    return true;
+}
+
 const long Emulator::sound_samples_available() const
 {
     return m_apu.samples_available();
@@ -6,38 +6,99 @@
 #include "cartridge.hpp"
 #include "controller.hpp"
 #include "system_bus.hpp"
+#include "scheduler.hpp"
+#include "machine_state.hpp"
 #include <cstdint>
 #include <string>
+#include <vector>
 
-class InputManager;
+class InputSource;
 
 class Emulator
 {
 public:
-    Emulator(InputManager& input_manager);
+    enum class ExecutionMode
+    {
+        Cycle,          // CPU ticked every cycle, interrupts polled every cycle
+        Instruction     // CPU runs whole instructions, interrupts taken between instructions
+    };
+
+public:
+    Emulator(InputSource& input_source);
 
     bool init();
     void reset();
     void power_off();
-    void run();
+    // Runs one frame. Without render the frame buffer keeps the last drawn
+    // frame, everything else runs the same.
+    void run(bool render = true);
+    // Runs frames ahead with the buttons of the last frame, draws the last of
+    // them and goes back to the last frame. The samples of the last frame
+    // must have been read, those of the frames ahead are dropped.
+    bool run_ahead(int frames);
     bool load_rom_file(const std::string& file_path);
     bool load_palette_file(const std::string& file_path);
     bool running() const { return m_cartridge.loaded(); }
     bool paused() const { return m_paused; }
     const long sound_samples_available() const;
     const long read_sound_samples(blip_sample_t* buffer, long size);
+    void set_sound_rate_ratio(double ratio) { m_apu.set_sample_rate_ratio(ratio); }
     void toggle_pause();
+    void set_execution_mode(ExecutionMode mode) { m_execution_mode = mode; }
+    ExecutionMode execution_mode() const { return m_execution_mode; }
+    void set_block_cache_enabled(bool enabled) { m_cpu.set_block_cache_enabled(enabled); }
+    bool set_jit_enabled(bool enabled) { return m_cpu.set_jit_enabled(enabled); }
+    void set_idle_loop_skipping_enabled(bool enabled) { m_cpu.set_idle_loop_skipping_enabled(enabled); }
+    void set_scanline_renderer_enabled(bool enabled) { m_ppu.set_scanline_renderer_enabled(enabled); }
+    bool set_compose_kernel(PixelComposer::Kernel kernel) { return m_ppu.composer().set_kernel(kernel); }
+    void set_indexed_output(bool enabled) { m_ppu.set_indexed_output(enabled); }
+    const uint8_t* ram() const { return m_system_bus.ram(); }
+
+    // Machine state between two frames, the parts of MachineState copied as
+    // they are in memory. The output buffers and the settings are not part of
+    // it. The vector keeps its capacity, saving every frame does not allocate.
+    // The samples of the last frame must have been read, those not read are
+    // dropped by a load.
+    static constexpr uint32_t StateVersion = 3;
+    bool save_state(std::vector<uint8_t>& state) const;
+    bool load_state(const std::vector<uint8_t>& state);
+    // The same without the header, to clone an emulator running the same ROM
+    bool save_machine_state(MachineState& state) const;
+    bool load_machine_state(const MachineState& state);
 
     const CPU& cpu() { return m_cpu; }
     const PPU& ppu() { return m_ppu; }
     uint32_t* screen_buffer() { return m_ppu.frame_buffer(); }
+    const uint16_t* index_buffer() const { return m_ppu.index_buffer(); }
 
 private:
+    static constexpr uint32_t StateMagic = 0x54534E4E; // "NNST"
+
+    struct StateHeader
+    {
+        uint32_t magic = StateMagic;
+        uint32_t version = StateVersion;
+        uint32_t size = 0;          // Header included
+        uint32_t rom_checksum = 0;
+        uint16_t mapper_id = 0;
+        uint16_t reserved = 0;
+    };
+
     Cartridge m_cartridge;
     CPU m_cpu;
     APU m_apu;
     PPU m_ppu;
     Controller m_controller;
     SystemBus m_system_bus;
+    Scheduler m_scheduler;
     bool m_paused = false;
+    ExecutionMode m_execution_mode = ExecutionMode::Instruction;
+    std::vector<uint8_t> m_run_ahead_state;
+
+    void run_frame(bool render);
+    void run_cycles();
+    void run_instructions();
+    void handle_events(uint64_t cycle);
+    void poll_interrupts(uint64_t cycle);
+    static uint64_t cycle_after_dots(uint64_t cycle, uint32_t dots);
 };
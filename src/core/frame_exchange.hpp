@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ppu.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Triple buffer handing the finished frames from the emulation thread to the
+// display. The producer fills the back buffer and swaps it with the middle
+// one, the consumer takes the middle one when it holds a newer frame. Frames
+// the display has no time for are overwritten, nobody waits.
+class FrameExchange
+{
+public:
+    static constexpr size_t FrameSize = PPU::ScreenWidth * PPU::ScreenHeight;
+
+    // Producer side
+    void publish(const uint32_t* frame)
+    {
+        memcpy(m_buffers[m_back], frame, sizeof(m_buffers[m_back]));
+        m_back = m_middle.exchange(m_back | NewFrame, std::memory_order_acq_rel) & BufferMask;
+    }
+
+    // Consumer side, the latest published frame. Stays valid until the next call.
+    const uint32_t* latest()
+    {
+        if (m_middle.load(std::memory_order_relaxed) & NewFrame)
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & BufferMask;
+
+        return m_buffers[m_front];
+    }
+
+private:
+    static constexpr uint8_t BufferMask = 0x03;
+    static constexpr uint8_t NewFrame = 0x04;
+
+    uint32_t m_buffers[3][FrameSize] = {};
+    std::atomic<uint8_t> m_middle = 1;
+    uint8_t m_back = 0;
+    uint8_t m_front = 2;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+class InputSource
+{
+public:
+    virtual ~InputSource() = default;
+
+    // Latches the buttons state of the controllers, called once per frame
+    virtual void poll_buttons_state(uint8_t* buttons, uint8_t count) = 0;
+};
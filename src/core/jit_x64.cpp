@@ -0,0 +1,1262 @@
+#include "jit_x64.hpp"
+#include "block_cache.hpp"
+#include "cpu.hpp"
+#include "logger.hpp"
+#include "memory_map.hpp"
+#include <cstddef>
+#include <vector>
+
+#ifdef EMU_JIT_X64
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+
+enum Register : uint8_t
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Index field value for memory operands without an index register
+constexpr Register NoIndex = RSP;
+
+enum Condition : uint8_t
+{
+    CC_B = 0x2,
+    CC_AE = 0x3,
+    CC_E = 0x4,
+    CC_NE = 0x5
+};
+
+// Register allocation, the 6502 registers are kept zero extended to 32 bits
+constexpr Register RegA = R12;
+constexpr Register RegX = RBX;
+constexpr Register RegY = RBP;
+constexpr Register RegC = RSI;              // 0 or 1
+constexpr Register RegV = RDI;              // 0 or 1
+constexpr Register RegZ = R10;              // Last result, Z is set when it is 0
+constexpr Register RegN = R11;              // Last result, N is its bit 7
+constexpr Register RegExtraCycles = R9;     // Page crossing cycles
+constexpr Register RegPages = R13;
+constexpr Register RegRam = R14;
+constexpr Register RegState = R15;
+
+constexpr int32_t StateA = offsetof(JitState, A);
+constexpr int32_t StateX = offsetof(JitState, X);
+constexpr int32_t StateY = offsetof(JitState, Y);
+constexpr int32_t StateP = offsetof(JitState, P);
+constexpr int32_t StateSP = offsetof(JitState, SP);
+constexpr int32_t StatePC = offsetof(JitState, PC);
+constexpr int32_t StateCycles = offsetof(JitState, cycles);
+constexpr int32_t StateInstructions = offsetof(JitState, instructions);
+constexpr int32_t StateRam = offsetof(JitState, ram);
+constexpr int32_t StateReadPages = offsetof(JitState, read_pages);
+
+// The few x86-64 instructions the compiler needs, 32 bit operands unless
+// noted otherwise. Memory operands always use a 32 bit displacement.
+class Assembler
+{
+public:
+    Assembler(uint8_t* code, size_t capacity):
+        m_code(code),
+        m_capacity(capacity)
+    {}
+
+    size_t size() const { return m_size; }
+    bool overflow() const { return m_size > m_capacity; }
+
+    // op r/m, reg: mov 0x89, add 0x01, or 0x09, and 0x21, sub 0x29, xor 0x31, test 0x85
+    void op(uint8_t opcode, Register rm, Register reg, bool wide = false)
+    {
+        rex(wide, reg, NoIndex, rm, false);
+        emit(opcode);
+        emit(0xC0 | (reg & 7) << 3 | (rm & 7));
+    }
+
+    // op r/m, imm32: add 0, or 1, and 4, sub 5, xor 6, cmp 7
+    void op_imm(uint8_t digit, Register rm, uint32_t imm)
+    {
+        rex(false, RAX, NoIndex, rm, false);
+        emit(0x81);
+        emit(0xC0 | digit << 3 | (rm & 7));
+        emit32(imm);
+    }
+
+    void mov(Register dst, Register src) { op(0x89, dst, src); }
+    void add(Register dst, Register src) { op(0x01, dst, src); }
+    void or_(Register dst, Register src) { op(0x09, dst, src); }
+    void and_(Register dst, Register src) { op(0x21, dst, src); }
+    void sub(Register dst, Register src) { op(0x29, dst, src); }
+    void xor_(Register dst, Register src) { op(0x31, dst, src); }
+    void test(Register dst, Register src, bool wide = false) { op(0x85, dst, src, wide); }
+    void add(Register dst, uint32_t imm) { op_imm(0, dst, imm); }
+    void or_(Register dst, uint32_t imm) { op_imm(1, dst, imm); }
+    void and_(Register dst, uint32_t imm) { op_imm(4, dst, imm); }
+    void sub(Register dst, uint32_t imm) { op_imm(5, dst, imm); }
+    void xor_(Register dst, uint32_t imm) { op_imm(6, dst, imm); }
+    void cmp(Register dst, uint32_t imm) { op_imm(7, dst, imm); }
+
+    void mov(Register dst, uint32_t imm)
+    {
+        rex(false, RAX, NoIndex, dst, false);
+        emit(0xB8 + (dst & 7));
+        emit32(imm);
+    }
+
+    void test(Register rm, uint32_t imm)
+    {
+        rex(false, RAX, NoIndex, rm, false);
+        emit(0xF7);
+        emit(0xC0 | (rm & 7));
+        emit32(imm);
+    }
+
+    void not_(Register rm)
+    {
+        rex(false, RAX, NoIndex, rm, false);
+        emit(0xF7);
+        emit(0xD0 | (rm & 7));
+    }
+
+    void shl(Register rm, uint8_t count) { shift(4, rm, count); }
+    void shr(Register rm, uint8_t count) { shift(5, rm, count); }
+
+    void setcc(Condition condition, Register rm)
+    {
+        rex(false, RAX, NoIndex, rm, true);
+        emit(0x0F);
+        emit(0x90 | condition);
+        emit(0xC0 | (rm & 7));
+    }
+
+    // movzx dst, byte [base + index + disp]
+    void load8(Register dst, Register base, Register index, int32_t disp)
+    {
+        rex(false, dst, index, base, false);
+        emit(0x0F);
+        emit(0xB6);
+        memory(dst, base, index, 0, disp);
+    }
+
+    // mov dst64, [base + index * (1 << scale) + disp]
+    void load64(Register dst, Register base, Register index, uint8_t scale, int32_t disp)
+    {
+        rex(true, dst, index, base, false);
+        emit(0x8B);
+        memory(dst, base, index, scale, disp);
+    }
+
+    void store8(Register src, Register base, Register index, int32_t disp)
+    {
+        rex(false, src, index, base, true);
+        emit(0x88);
+        memory(src, base, index, 0, disp);
+    }
+
+    void store8_imm(Register base, Register index, int32_t disp, uint8_t imm)
+    {
+        rex(false, RAX, index, base, false);
+        emit(0xC6);
+        memory(RAX, base, index, 0, disp);
+        emit(imm);
+    }
+
+    void store16(Register src, Register base, int32_t disp)
+    {
+        emit(0x66);
+        rex(false, src, NoIndex, base, false);
+        emit(0x89);
+        memory(src, base, NoIndex, 0, disp);
+    }
+
+    void store16_imm(Register base, int32_t disp, uint16_t imm)
+    {
+        emit(0x66);
+        rex(false, RAX, NoIndex, base, false);
+        emit(0xC7);
+        memory(RAX, base, NoIndex, 0, disp);
+        emit(imm & 0xFF);
+        emit(imm >> 8);
+    }
+
+    void store32(Register src, Register base, int32_t disp)
+    {
+        rex(false, src, NoIndex, base, false);
+        emit(0x89);
+        memory(src, base, NoIndex, 0, disp);
+    }
+
+    void store32_imm(Register base, int32_t disp, uint32_t imm)
+    {
+        rex(false, RAX, NoIndex, base, false);
+        emit(0xC7);
+        memory(RAX, base, NoIndex, 0, disp);
+        emit32(imm);
+    }
+
+    // op byte [base + disp], imm8: or 1, and 4
+    void op8(uint8_t digit, Register base, int32_t disp, uint8_t imm)
+    {
+        rex(false, RAX, NoIndex, base, false);
+        emit(0x80);
+        memory(static_cast<Register>(digit), base, NoIndex, 0, disp);
+        emit(imm);
+    }
+
+    // lea dst32, [base + index + disp]
+    void lea(Register dst, Register base, Register index, int32_t disp)
+    {
+        rex(false, dst, index, base, false);
+        emit(0x8D);
+        memory(dst, base, index, 0, disp);
+    }
+
+    void push(Register reg)
+    {
+        if (reg & 8)
+            emit(0x41);
+        emit(0x50 + (reg & 7));
+    }
+
+    void pop(Register reg)
+    {
+        if (reg & 8)
+            emit(0x41);
+        emit(0x58 + (reg & 7));
+    }
+
+    void ret() { emit(0xC3); }
+
+    // Jumps return the position of their offset, set later with bind()
+    size_t jump(Condition condition)
+    {
+        emit(0x0F);
+        emit(0x80 | condition);
+        emit32(0);
+        return m_size - 4;
+    }
+
+    size_t jump()
+    {
+        emit(0xE9);
+        emit32(0);
+        return m_size - 4;
+    }
+
+    void bind(size_t jump) { bind(jump, m_size); }
+
+    void bind(size_t jump, size_t target)
+    {
+        const uint32_t offset = static_cast<uint32_t>(target - (jump + 4));
+        for (size_t i = 0; i < 4; i++)
+        {
+            if (jump + i < m_capacity)
+                m_code[jump + i] = static_cast<uint8_t>(offset >> (i * 8));
+        }
+    }
+
+private:
+    uint8_t* m_code;
+    size_t m_capacity;
+    size_t m_size = 0;
+
+    void emit(uint8_t value)
+    {
+        // Keep counting past the end so the caller can check overflow()
+        if (m_size < m_capacity)
+            m_code[m_size] = value;
+        m_size++;
+    }
+
+    void emit32(uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            emit(static_cast<uint8_t>(value >> (i * 8)));
+    }
+
+    // Byte operations need a REX prefix to use SPL, BPL, SIL and DIL
+    void rex(bool wide, Register reg, Register index, Register base, bool byte)
+    {
+        const uint8_t value = 0x40 | (wide ? 0x08 : 0) | (reg & 8) >> 1 | (index & 8) >> 2 | (base & 8) >> 3;
+        if (value != 0x40 || byte)
+            emit(value);
+    }
+
+    void shift(uint8_t digit, Register rm, uint8_t count)
+    {
+        rex(false, RAX, NoIndex, rm, false);
+        emit(0xC1);
+        emit(0xC0 | digit << 3 | (rm & 7));
+        emit(count);
+    }
+
+    void memory(Register reg, Register base, Register index, uint8_t scale, int32_t disp)
+    {
+        if (index != NoIndex || (base & 7) == RSP)
+        {
+            emit(0x84 | (reg & 7) << 3);
+            emit(scale << 6 | (index & 7) << 3 | (base & 7));
+        }
+        else
+        {
+            emit(0x80 | (reg & 7) << 3 | (base & 7));
+        }
+
+        emit32(static_cast<uint32_t>(disp));
+    }
+};
+
+enum class Operation
+{
+    Unsupported,
+    Read,
+    Store,
+    Modify,
+    Implied,
+    Jump,
+    Call,
+    Return,
+    Branch
+};
+
+Operation operation(const DecodedInstruction& instruction)
+{
+    const CPU::InstructionInfo& info = CPU::instruction_info(instruction.opcode);
+    const CPU::AddressingMode mode = info.addressing_mode;
+    const uint16_t operand = instruction.operand;
+
+    if (mode == CPU::AM_RELATIVE)
+        return Operation::Branch;
+
+    switch (info.id)
+    {
+    case CPU::Mnemonic::JMP:
+        return mode == CPU::AM_ABSOLUTE ? Operation::Jump : Operation::Unsupported;
+    case CPU::Mnemonic::JSR:
+        return Operation::Call;
+    case CPU::Mnemonic::RTS:
+        return Operation::Return;
+    case CPU::Mnemonic::PLP:
+        // Can enable the interrupts, left to the interpreter
+        return Operation::Unsupported;
+    default:
+        break;
+    }
+
+    if (info.flags & CPU::INS_READ)
+    {
+        // Registers between RAM and PRG RAM are always left to the interpreter
+        if (mode == CPU::AM_ABSOLUTE && operand >= 0x2000 && operand < 0x6000)
+            return Operation::Unsupported;
+
+        return Operation::Read;
+    }
+
+    if (info.flags & CPU::INS_STORE)
+    {
+        // Only RAM is written, anything else can have side effects
+        if ((mode == CPU::AM_ABSOLUTE || mode == CPU::AM_ABSOLUTE_INDEXED_X || mode == CPU::AM_ABSOLUTE_INDEXED_Y) &&
+            operand >= 0x2000)
+            return Operation::Unsupported;
+
+        return Operation::Store;
+    }
+
+    if (info.flags & CPU::INS_MODIFY)
+    {
+        if ((mode == CPU::AM_ABSOLUTE || mode == CPU::AM_ABSOLUTE_INDEXED_X) && operand >= 0x2000)
+            return Operation::Unsupported;
+
+        return Operation::Modify;
+    }
+
+    // NOP does not access the bus in any addressing mode
+    if (info.flags & (CPU::INS_REGISTER | CPU::INS_STACK))
+        return Operation::Implied;
+
+    return Operation::Unsupported;
+}
+
+// Instructions which take a cycle more when indexing crosses a page
+bool page_cross_cycle(const CPU::InstructionInfo& info)
+{
+    const CPU::AddressingMode mode = info.addressing_mode;
+    if (mode != CPU::AM_ABSOLUTE_INDEXED_X && mode != CPU::AM_ABSOLUTE_INDEXED_Y && mode != CPU::AM_INDIRECT_INDEXED)
+        return false;
+
+    return (info.flags & CPU::INS_PAGE_CROSS) != 0;
+}
+
+class BlockCompiler
+{
+public:
+    BlockCompiler(Assembler& assembler, const CodeBlock& block):
+        m_asm(assembler),
+        m_block(block)
+    {}
+
+    bool compile(uint16_t& max_cycles);
+
+private:
+    struct SideExit
+    {
+        size_t jump;
+        size_t index;
+    };
+
+    // Accessed address range, checks are left out when the range allows it
+    struct AddressRange
+    {
+        uint32_t low;
+        uint32_t high;
+    };
+
+    Assembler& m_asm;
+    const CodeBlock& m_block;
+    std::vector<uint32_t> m_cycles_before;
+    std::vector<SideExit> m_side_exits;
+    std::vector<size_t> m_epilogue_jumps;
+    uint32_t m_cycles = 0;
+    size_t m_index = 0;
+
+    void prologue();
+    void epilogue();
+    void exit_block(uint32_t cycles, uint32_t instructions);
+    void side_exit(Condition condition);
+    void status_to_eax();
+
+    void instruction(const DecodedInstruction& instruction, Operation operation);
+    void read(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic, CPU::AddressingMode mode);
+    void store(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic, CPU::AddressingMode mode);
+    void modify(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic, CPU::AddressingMode mode);
+    void implied(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic, CPU::AddressingMode mode);
+    void branch(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic);
+
+    AddressRange address_to_ecx(const DecodedInstruction& instruction, CPU::AddressingMode mode, bool page_cross);
+    void read_static(uint16_t address);
+    void read_dynamic(AddressRange range);
+    void write_dynamic(Register value, AddressRange range);
+    void modify_value(CPU::Mnemonic mnemonic, Register value);
+    void add_with_carry();
+    void compare(Register reg);
+    void set_zn(Register value);
+    void push(Register value);
+};
+
+bool BlockCompiler::compile(uint16_t& max_cycles)
+{
+    // Compile up to the first instruction the native code cannot run, the
+    // block exits there and the interpreter takes over
+    const size_t instruction_count = m_block.instructions.size() - 1;
+    size_t count = 0;
+    uint32_t cycles = 0;
+    bool terminated = false;
+
+    while (count < instruction_count && !terminated)
+    {
+        const DecodedInstruction& instruction = m_block.instructions[count];
+        const Operation op = operation(instruction);
+        if (op == Operation::Unsupported)
+            break;
+
+        const CPU::InstructionInfo& info = CPU::instruction_info(instruction.opcode);
+        cycles += info.cycles;
+        if (op == Operation::Branch)
+            cycles += 2;
+        else if (page_cross_cycle(info))
+            cycles++;
+
+        terminated = op == Operation::Jump || op == Operation::Call || op == Operation::Return || op == Operation::Branch;
+        count++;
+    }
+
+    if (count == 0 || cycles > UINT16_MAX)
+        return false;
+
+    max_cycles = static_cast<uint16_t>(cycles);
+
+    prologue();
+
+    for (m_index = 0; m_index < count; m_index++)
+    {
+        const DecodedInstruction& instruction = m_block.instructions[m_index];
+        m_cycles_before.push_back(m_cycles);
+        m_cycles += CPU::instruction_info(instruction.opcode).cycles;
+        this->instruction(instruction, operation(instruction));
+    }
+
+    if (!terminated)
+    {
+        const DecodedInstruction& last = m_block.instructions[count - 1];
+        const uint16_t next = last.address + CPU::instruction_length(CPU::instruction_info(last.opcode).addressing_mode);
+        m_asm.store16_imm(RegState, StatePC, next);
+        exit_block(m_cycles, static_cast<uint32_t>(count));
+    }
+
+    const size_t epilogue_start = m_asm.size();
+    for (size_t jump : m_epilogue_jumps)
+        m_asm.bind(jump, epilogue_start);
+    epilogue();
+
+    // Leave before the instruction, nothing it does is visible yet
+    for (const SideExit& side_exit : m_side_exits)
+    {
+        m_asm.bind(side_exit.jump);
+        m_asm.store16_imm(RegState, StatePC, m_block.instructions[side_exit.index].address);
+        m_asm.lea(RDX, RegExtraCycles, NoIndex, m_cycles_before[side_exit.index]);
+        m_asm.store32(RDX, RegState, StateCycles);
+        m_asm.store32_imm(RegState, StateInstructions, static_cast<uint32_t>(side_exit.index));
+        m_asm.bind(m_asm.jump(), epilogue_start);
+    }
+
+    return true;
+}
+
+void BlockCompiler::prologue()
+{
+    m_asm.push(RBX);
+    m_asm.push(RBP);
+    m_asm.push(RSI);
+    m_asm.push(RDI);
+    m_asm.push(R12);
+    m_asm.push(R13);
+    m_asm.push(R14);
+    m_asm.push(R15);
+
+#ifdef _WIN32
+    m_asm.op(0x89, RegState, RCX, true);
+#else
+    m_asm.op(0x89, RegState, RDI, true);
+#endif
+
+    m_asm.load64(RegRam, RegState, NoIndex, 0, StateRam);
+    m_asm.load64(RegPages, RegState, NoIndex, 0, StateReadPages);
+    m_asm.load8(RegA, RegState, NoIndex, StateA);
+    m_asm.load8(RegX, RegState, NoIndex, StateX);
+    m_asm.load8(RegY, RegState, NoIndex, StateY);
+
+    m_asm.load8(RAX, RegState, NoIndex, StateP);
+    m_asm.mov(RegC, RAX);
+    m_asm.and_(RegC, 1);
+    m_asm.mov(RegV, RAX);
+    m_asm.shr(RegV, 6);
+    m_asm.and_(RegV, 1);
+    m_asm.mov(RegZ, RAX);
+    m_asm.not_(RegZ);
+    m_asm.and_(RegZ, CPU::STATUS_Z);
+    m_asm.mov(RegN, RAX);
+    m_asm.and_(RegN, CPU::STATUS_N);
+    m_asm.xor_(RegExtraCycles, RegExtraCycles);
+}
+
+void BlockCompiler::epilogue()
+{
+    m_asm.store8(RegA, RegState, NoIndex, StateA);
+    m_asm.store8(RegX, RegState, NoIndex, StateX);
+    m_asm.store8(RegY, RegState, NoIndex, StateY);
+    status_to_eax();
+    m_asm.store8(RAX, RegState, NoIndex, StateP);
+
+    m_asm.pop(R15);
+    m_asm.pop(R14);
+    m_asm.pop(R13);
+    m_asm.pop(R12);
+    m_asm.pop(RDI);
+    m_asm.pop(RSI);
+    m_asm.pop(RBP);
+    m_asm.pop(RBX);
+    m_asm.ret();
+}
+
+// PC must be stored already
+void BlockCompiler::exit_block(uint32_t cycles, uint32_t instructions)
+{
+    m_asm.lea(RDX, RegExtraCycles, NoIndex, cycles);
+    m_asm.store32(RDX, RegState, StateCycles);
+    m_asm.store32_imm(RegState, StateInstructions, instructions);
+    m_epilogue_jumps.push_back(m_asm.jump());
+}
+
+void BlockCompiler::side_exit(Condition condition)
+{
+    m_side_exits.push_back({ m_asm.jump(condition), m_index });
+}
+
+// Status register with the flags kept in registers, uses EDX
+void BlockCompiler::status_to_eax()
+{
+    m_asm.load8(RAX, RegState, NoIndex, StateP);
+    m_asm.and_(RAX, ~(CPU::STATUS_N | CPU::STATUS_V | CPU::STATUS_Z | CPU::STATUS_C) & 0xFF);
+    m_asm.or_(RAX, RegC);
+    m_asm.mov(RDX, RegV);
+    m_asm.shl(RDX, 6);
+    m_asm.or_(RAX, RDX);
+    m_asm.xor_(RDX, RDX);
+    m_asm.test(RegZ, RegZ);
+    m_asm.setcc(CC_E, RDX);
+    m_asm.add(RDX, RDX);
+    m_asm.or_(RAX, RDX);
+    m_asm.mov(RDX, RegN);
+    m_asm.and_(RDX, CPU::STATUS_N);
+    m_asm.or_(RAX, RDX);
+}
+
+void BlockCompiler::instruction(const DecodedInstruction& instruction, Operation operation)
+{
+    const CPU::InstructionInfo& info = CPU::instruction_info(instruction.opcode);
+    const CPU::Mnemonic mnemonic = info.id;
+    const uint32_t executed = static_cast<uint32_t>(m_index + 1);
+
+    switch (operation)
+    {
+    case Operation::Read:
+        read(instruction, mnemonic, info.addressing_mode);
+        break;
+    case Operation::Store:
+        store(instruction, mnemonic, info.addressing_mode);
+        break;
+    case Operation::Modify:
+        modify(instruction, mnemonic, info.addressing_mode);
+        break;
+    case Operation::Implied:
+        implied(instruction, mnemonic, info.addressing_mode);
+        break;
+    case Operation::Jump:
+        m_asm.store16_imm(RegState, StatePC, instruction.operand);
+        exit_block(m_cycles, executed);
+        break;
+    case Operation::Call:
+    {
+        const uint16_t return_address = instruction.address + 2;
+        m_asm.load8(RCX, RegState, NoIndex, StateSP);
+        m_asm.store8_imm(RegRam, RCX, 0x100, return_address >> 8);
+        m_asm.sub(RCX, 1);
+        m_asm.and_(RCX, 0xFF);
+        m_asm.store8_imm(RegRam, RCX, 0x100, return_address & 0xFF);
+        m_asm.sub(RCX, 1);
+        m_asm.store8(RCX, RegState, NoIndex, StateSP);
+        m_asm.store16_imm(RegState, StatePC, instruction.operand);
+        exit_block(m_cycles, executed);
+        break;
+    }
+    case Operation::Return:
+        m_asm.load8(RCX, RegState, NoIndex, StateSP);
+        m_asm.add(RCX, 1);
+        m_asm.and_(RCX, 0xFF);
+        m_asm.load8(RAX, RegRam, RCX, 0x100);
+        m_asm.add(RCX, 1);
+        m_asm.and_(RCX, 0xFF);
+        m_asm.load8(RDX, RegRam, RCX, 0x100);
+        m_asm.store8(RCX, RegState, NoIndex, StateSP);
+        m_asm.shl(RDX, 8);
+        m_asm.or_(RAX, RDX);
+        m_asm.add(RAX, 1);
+        m_asm.store16(RAX, RegState, StatePC);
+        exit_block(m_cycles, executed);
+        break;
+    case Operation::Branch:
+        branch(instruction, mnemonic);
+        break;
+    case Operation::Unsupported:
+        break;
+    }
+}
+
+void BlockCompiler::read(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic, CPU::AddressingMode mode)
+{
+    const bool page_cross = page_cross_cycle(CPU::instruction_info(instruction.opcode));
+
+    // Operand to EAX
+    if (mode == CPU::AM_IMMEDIATE)
+    {
+        m_asm.mov(RAX, instruction.operand & 0xFF);
+    }
+    else if (mode == CPU::AM_ZEROPAGE)
+    {
+        m_asm.load8(RAX, RegRam, NoIndex, instruction.operand);
+    }
+    else if (mode == CPU::AM_ABSOLUTE)
+    {
+        read_static(instruction.operand);
+    }
+    else
+    {
+        read_dynamic(address_to_ecx(instruction, mode, page_cross));
+        if (page_cross)
+            m_asm.add(RegExtraCycles, R8);
+    }
+
+    switch (mnemonic)
+    {
+    case CPU::Mnemonic::LDA:
+        m_asm.mov(RegA, RAX);
+        set_zn(RegA);
+        break;
+    case CPU::Mnemonic::LDX:
+        m_asm.mov(RegX, RAX);
+        set_zn(RegX);
+        break;
+    case CPU::Mnemonic::LDY:
+        m_asm.mov(RegY, RAX);
+        set_zn(RegY);
+        break;
+    case CPU::Mnemonic::AND:
+        m_asm.and_(RegA, RAX);
+        set_zn(RegA);
+        break;
+    case CPU::Mnemonic::ORA:
+        m_asm.or_(RegA, RAX);
+        set_zn(RegA);
+        break;
+    case CPU::Mnemonic::EOR:
+        m_asm.xor_(RegA, RAX);
+        set_zn(RegA);
+        break;
+    case CPU::Mnemonic::ADC:
+        add_with_carry();
+        break;
+    case CPU::Mnemonic::SBC:
+        m_asm.xor_(RAX, 0xFF);
+        add_with_carry();
+        break;
+    case CPU::Mnemonic::CMP:
+        compare(RegA);
+        break;
+    case CPU::Mnemonic::CPX:
+        compare(RegX);
+        break;
+    case CPU::Mnemonic::CPY:
+        compare(RegY);
+        break;
+    case CPU::Mnemonic::BIT:
+        m_asm.mov(RegZ, RegA);
+        m_asm.and_(RegZ, RAX);
+        m_asm.mov(RegN, RAX);
+        m_asm.mov(RegV, RAX);
+        m_asm.shr(RegV, 6);
+        m_asm.and_(RegV, 1);
+        break;
+    default:
+        break;
+    }
+}
+
+void BlockCompiler::store(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic, CPU::AddressingMode mode)
+{
+    Register value = RegA;
+    if (mnemonic == CPU::Mnemonic::STX)
+        value = RegX;
+    else if (mnemonic == CPU::Mnemonic::STY)
+        value = RegY;
+
+    if (mode == CPU::AM_ZEROPAGE || mode == CPU::AM_ABSOLUTE)
+        m_asm.store8(value, RegRam, NoIndex, instruction.operand & 0x7FF);
+    else
+        write_dynamic(value, address_to_ecx(instruction, mode, false));
+}
+
+void BlockCompiler::modify(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic, CPU::AddressingMode mode)
+{
+    if (mode == CPU::AM_IMPLIED)
+    {
+        modify_value(mnemonic, RegA);
+        return;
+    }
+
+    // RAM only, the RAM offset is either static or in ECX
+    Register index = NoIndex;
+    int32_t offset = instruction.operand & 0x7FF;
+
+    if (mode != CPU::AM_ZEROPAGE && mode != CPU::AM_ABSOLUTE)
+    {
+        const AddressRange range = address_to_ecx(instruction, mode, false);
+        if (range.high >= 0x2000)
+        {
+            m_asm.cmp(RCX, 0x2000);
+            side_exit(CC_AE);
+        }
+
+        m_asm.and_(RCX, 0x7FF);
+        index = RCX;
+        offset = 0;
+    }
+
+    m_asm.load8(RAX, RegRam, index, offset);
+    modify_value(mnemonic, RAX);
+    m_asm.store8(RAX, RegRam, index, offset);
+}
+
+void BlockCompiler::implied(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic, CPU::AddressingMode mode)
+{
+    switch (mnemonic)
+    {
+    case CPU::Mnemonic::NOP:
+        if (mode == CPU::AM_ABSOLUTE_INDEXED_X)
+        {
+            m_asm.lea(R8, RegX, NoIndex, instruction.operand & 0xFF);
+            m_asm.shr(R8, 8);
+            m_asm.add(RegExtraCycles, R8);
+        }
+        break;
+    case CPU::Mnemonic::TAX:
+        m_asm.mov(RegX, RegA);
+        set_zn(RegX);
+        break;
+    case CPU::Mnemonic::TAY:
+        m_asm.mov(RegY, RegA);
+        set_zn(RegY);
+        break;
+    case CPU::Mnemonic::TXA:
+        m_asm.mov(RegA, RegX);
+        set_zn(RegA);
+        break;
+    case CPU::Mnemonic::TYA:
+        m_asm.mov(RegA, RegY);
+        set_zn(RegA);
+        break;
+    case CPU::Mnemonic::TSX:
+        m_asm.load8(RegX, RegState, NoIndex, StateSP);
+        set_zn(RegX);
+        break;
+    case CPU::Mnemonic::TXS:
+        m_asm.store8(RegX, RegState, NoIndex, StateSP);
+        break;
+    case CPU::Mnemonic::INX:
+    case CPU::Mnemonic::DEX:
+    case CPU::Mnemonic::INY:
+    case CPU::Mnemonic::DEY:
+    {
+        const Register reg = (mnemonic == CPU::Mnemonic::INX || mnemonic == CPU::Mnemonic::DEX) ? RegX : RegY;
+        if (mnemonic == CPU::Mnemonic::INX || mnemonic == CPU::Mnemonic::INY)
+            m_asm.add(reg, 1);
+        else
+            m_asm.sub(reg, 1);
+        m_asm.and_(reg, 0xFF);
+        set_zn(reg);
+        break;
+    }
+    case CPU::Mnemonic::CLC:
+        m_asm.xor_(RegC, RegC);
+        break;
+    case CPU::Mnemonic::SEC:
+        m_asm.mov(RegC, 1);
+        break;
+    case CPU::Mnemonic::CLV:
+        m_asm.xor_(RegV, RegV);
+        break;
+    case CPU::Mnemonic::CLI:
+        m_asm.op8(4, RegState, StateP, ~CPU::STATUS_I & 0xFF);
+        break;
+    case CPU::Mnemonic::SEI:
+        m_asm.op8(1, RegState, StateP, CPU::STATUS_I);
+        break;
+    case CPU::Mnemonic::CLD:
+        m_asm.op8(4, RegState, StateP, ~CPU::STATUS_D & 0xFF);
+        break;
+    case CPU::Mnemonic::SED:
+        m_asm.op8(1, RegState, StateP, CPU::STATUS_D);
+        break;
+    case CPU::Mnemonic::PHA:
+        push(RegA);
+        break;
+    case CPU::Mnemonic::PHP:
+        status_to_eax();
+        m_asm.or_(RAX, CPU::STATUS_B | CPU::STATUS_U);
+        push(RAX);
+        break;
+    case CPU::Mnemonic::PLA:
+        m_asm.load8(RCX, RegState, NoIndex, StateSP);
+        m_asm.add(RCX, 1);
+        m_asm.and_(RCX, 0xFF);
+        m_asm.load8(RegA, RegRam, RCX, 0x100);
+        m_asm.store8(RCX, RegState, NoIndex, StateSP);
+        set_zn(RegA);
+        break;
+    default:
+        break;
+    }
+}
+
+void BlockCompiler::branch(const DecodedInstruction& instruction, CPU::Mnemonic mnemonic)
+{
+    Condition taken = CC_NE;
+
+    switch (mnemonic)
+    {
+    case CPU::Mnemonic::BCC:
+    case CPU::Mnemonic::BCS:
+        m_asm.test(RegC, RegC);
+        taken = mnemonic == CPU::Mnemonic::BCS ? CC_NE : CC_E;
+        break;
+    case CPU::Mnemonic::BVC:
+    case CPU::Mnemonic::BVS:
+        m_asm.test(RegV, RegV);
+        taken = mnemonic == CPU::Mnemonic::BVS ? CC_NE : CC_E;
+        break;
+    case CPU::Mnemonic::BEQ:
+    case CPU::Mnemonic::BNE:
+        m_asm.test(RegZ, RegZ);
+        taken = mnemonic == CPU::Mnemonic::BEQ ? CC_E : CC_NE;
+        break;
+    default:
+        m_asm.test(RegN, CPU::STATUS_N);
+        taken = mnemonic == CPU::Mnemonic::BMI ? CC_NE : CC_E;
+        break;
+    }
+
+    const uint32_t executed = static_cast<uint32_t>(m_index + 1);
+    const uint16_t next = instruction.address + 2;
+    const size_t jump = m_asm.jump(taken);
+
+    m_asm.store16_imm(RegState, StatePC, next);
+    exit_block(m_cycles, executed);
+
+    // One more cycle when taken, two if the target is in another page
+    m_asm.bind(jump);
+    m_asm.store16_imm(RegState, StatePC, instruction.operand);
+    exit_block(m_cycles + ((next & 0xFF00) != (instruction.operand & 0xFF00) ? 2 : 1), executed);
+}
+
+// Effective address of the indexed and indirect modes to ECX. With page_cross
+// set R8D holds the extra cycle, to be added once the access cannot exit.
+BlockCompiler::AddressRange BlockCompiler::address_to_ecx(const DecodedInstruction& instruction, CPU::AddressingMode mode, bool page_cross)
+{
+    const uint16_t operand = instruction.operand;
+
+    switch (mode)
+    {
+    case CPU::AM_ZEROPAGE_INDEXED_X:
+    case CPU::AM_ZEROPAGE_INDEXED_Y:
+        m_asm.lea(RCX, mode == CPU::AM_ZEROPAGE_INDEXED_X ? RegX : RegY, NoIndex, operand);
+        m_asm.and_(RCX, 0xFF);
+        return { 0x00, 0xFF };
+
+    case CPU::AM_ABSOLUTE_INDEXED_X:
+    case CPU::AM_ABSOLUTE_INDEXED_Y:
+    {
+        const Register index = mode == CPU::AM_ABSOLUTE_INDEXED_X ? RegX : RegY;
+        m_asm.lea(RCX, index, NoIndex, operand);
+        if (page_cross)
+        {
+            m_asm.lea(R8, index, NoIndex, operand & 0xFF);
+            m_asm.shr(R8, 8);
+        }
+
+        if (operand + 0xFF > 0xFFFF)
+        {
+            m_asm.and_(RCX, 0xFFFF);
+            return { 0x0000, 0xFFFF };
+        }
+
+        return { operand, operand + 0xFFu };
+    }
+
+    case CPU::AM_INDEXED_INDIRECT:
+        m_asm.lea(RCX, RegX, NoIndex, operand);
+        m_asm.and_(RCX, 0xFF);
+        m_asm.load8(RAX, RegRam, RCX, 0);
+        m_asm.add(RCX, 1);
+        m_asm.and_(RCX, 0xFF);
+        m_asm.load8(RDX, RegRam, RCX, 0);
+        m_asm.shl(RDX, 8);
+        m_asm.or_(RAX, RDX);
+        m_asm.mov(RCX, RAX);
+        return { 0x0000, 0xFFFF };
+
+    default:
+        // Indirect indexed
+        m_asm.load8(RAX, RegRam, NoIndex, operand);
+        m_asm.load8(RDX, RegRam, NoIndex, (operand + 1) & 0xFF);
+        m_asm.shl(RDX, 8);
+        m_asm.or_(RAX, RDX);
+        if (page_cross)
+        {
+            m_asm.mov(R8, RAX);
+            m_asm.and_(R8, 0xFF);
+            m_asm.add(R8, RegY);
+            m_asm.shr(R8, 8);
+        }
+        m_asm.lea(RCX, RAX, RegY, 0);
+        m_asm.and_(RCX, 0xFFFF);
+        return { 0x0000, 0xFFFF };
+    }
+}
+
+// Value to EAX
+void BlockCompiler::read_static(uint16_t address)
+{
+    if (address < 0x2000)
+    {
+        m_asm.load8(RAX, RegRam, NoIndex, address & 0x7FF);
+        return;
+    }
+
+    m_asm.load64(RAX, RegPages, NoIndex, 0, (address >> MemoryMap::PageShift) * sizeof(uint8_t*));
+    m_asm.test(RAX, RAX, true);
+    side_exit(CC_E);
+    m_asm.load8(RAX, RAX, NoIndex, address & MemoryMap::PageMask);
+}
+
+// Address in ECX, value to EAX
+void BlockCompiler::read_dynamic(AddressRange range)
+{
+    size_t done = 0;
+
+    if (range.low < 0x2000)
+    {
+        size_t not_ram = 0;
+        if (range.high >= 0x2000)
+        {
+            m_asm.cmp(RCX, 0x2000);
+            not_ram = m_asm.jump(CC_AE);
+        }
+
+        m_asm.mov(RAX, RCX);
+        m_asm.and_(RAX, 0x7FF);
+        m_asm.load8(RAX, RegRam, RAX, 0);
+
+        if (range.high < 0x2000)
+            return;
+
+        done = m_asm.jump();
+        m_asm.bind(not_ram);
+    }
+
+    if (range.low < 0x6000)
+    {
+        m_asm.cmp(RCX, 0x6000);
+        side_exit(CC_B);
+    }
+
+    // Memory map page, unmapped pages go through the bus
+    m_asm.mov(RAX, RCX);
+    m_asm.shr(RAX, MemoryMap::PageShift);
+    m_asm.load64(RAX, RegPages, RAX, 3, 0);
+    m_asm.test(RAX, RAX, true);
+    side_exit(CC_E);
+    m_asm.mov(RDX, RCX);
+    m_asm.and_(RDX, MemoryMap::PageMask);
+    m_asm.load8(RAX, RAX, RDX, 0);
+
+    if (range.low < 0x2000)
+        m_asm.bind(done);
+}
+
+// Address in ECX
+void BlockCompiler::write_dynamic(Register value, AddressRange range)
+{
+    if (range.high >= 0x2000)
+    {
+        m_asm.cmp(RCX, 0x2000);
+        side_exit(CC_AE);
+    }
+
+    m_asm.and_(RCX, 0x7FF);
+    m_asm.store8(value, RegRam, RCX, 0);
+}
+
+// Shifts, increments and decrements, uses EDX
+void BlockCompiler::modify_value(CPU::Mnemonic mnemonic, Register value)
+{
+    switch (mnemonic)
+    {
+    case CPU::Mnemonic::ASL:
+        m_asm.mov(RegC, value);
+        m_asm.shr(RegC, 7);
+        m_asm.shl(value, 1);
+        m_asm.and_(value, 0xFF);
+        break;
+    case CPU::Mnemonic::LSR:
+        m_asm.mov(RegC, value);
+        m_asm.and_(RegC, 1);
+        m_asm.shr(value, 1);
+        break;
+    case CPU::Mnemonic::ROL:
+        m_asm.mov(RDX, value);
+        m_asm.shr(RDX, 7);
+        m_asm.shl(value, 1);
+        m_asm.or_(value, RegC);
+        m_asm.and_(value, 0xFF);
+        m_asm.mov(RegC, RDX);
+        break;
+    case CPU::Mnemonic::ROR:
+        m_asm.mov(RDX, value);
+        m_asm.and_(RDX, 1);
+        m_asm.shr(value, 1);
+        m_asm.shl(RegC, 7);
+        m_asm.or_(value, RegC);
+        m_asm.mov(RegC, RDX);
+        break;
+    case CPU::Mnemonic::INC:
+        m_asm.add(value, 1);
+        m_asm.and_(value, 0xFF);
+        break;
+    case CPU::Mnemonic::DEC:
+        m_asm.sub(value, 1);
+        m_asm.and_(value, 0xFF);
+        break;
+    default:
+        break;
+    }
+
+    set_zn(value);
+}
+
+// A + EAX + C, no decimal mode on the 2A03
+void BlockCompiler::add_with_carry()
+{
+    m_asm.mov(RDX, RegA);
+    m_asm.add(RDX, RAX);
+    m_asm.add(RDX, RegC);
+    m_asm.mov(RegC, RDX);
+    m_asm.shr(RegC, 8);
+
+    // Overflow when both inputs have the same sign and the result another one
+    m_asm.mov(RCX, RegA);
+    m_asm.xor_(RCX, RAX);
+    m_asm.not_(RCX);
+    m_asm.xor_(RAX, RDX);
+    m_asm.and_(RCX, RAX);
+    m_asm.shr(RCX, 7);
+    m_asm.and_(RCX, 1);
+    m_asm.mov(RegV, RCX);
+
+    m_asm.and_(RDX, 0xFF);
+    m_asm.mov(RegA, RDX);
+    set_zn(RegA);
+}
+
+// Register - EAX, C set when there is no borrow
+void BlockCompiler::compare(Register reg)
+{
+    m_asm.mov(RCX, reg);
+    m_asm.sub(RCX, RAX);
+    m_asm.mov(RegC, RCX);
+    m_asm.not_(RegC);
+    m_asm.shr(RegC, 31);
+    m_asm.and_(RCX, 0xFF);
+    set_zn(RCX);
+}
+
+void BlockCompiler::set_zn(Register value)
+{
+    m_asm.mov(RegZ, value);
+    m_asm.mov(RegN, value);
+}
+
+void BlockCompiler::push(Register value)
+{
+    m_asm.load8(RCX, RegState, NoIndex, StateSP);
+    m_asm.store8(value, RegRam, RCX, 0x100);
+    m_asm.sub(RCX, 1);
+    m_asm.store8(RCX, RegState, NoIndex, StateSP);
+}
+
+} // namespace
+
+JitX64::JitX64()
+{
+#ifdef _WIN32
+    m_code = static_cast<uint8_t*>(VirtualAlloc(nullptr, CodeSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+    void* code = mmap(nullptr, CodeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    m_code = code != MAP_FAILED ? static_cast<uint8_t*>(code) : nullptr;
+#endif
+
+    if (m_code == nullptr)
+        LOG_ERROR("JIT: cannot allocate %zu bytes of code memory", CodeSize);
+}
+
+JitX64::~JitX64()
+{
+    if (m_code == nullptr)
+        return;
+
+#ifdef _WIN32
+    VirtualFree(m_code, 0, MEM_RELEASE);
+#else
+    munmap(m_code, CodeSize);
+#endif
+}
+
+bool JitX64::supported()
+{
+    return true;
+}
+
+bool JitX64::compile(CodeBlock& block)
+{
+    block.native_failed = true;
+
+    if (m_code == nullptr || !set_writable(true))
+        return false;
+
+    Assembler assembler(m_code + m_code_used, CodeSize - m_code_used);
+    BlockCompiler compiler(assembler, block);
+    uint16_t max_cycles = 0;
+    const bool compiled = compiler.compile(max_cycles) && !assembler.overflow();
+    m_full = assembler.overflow();
+
+    if (!set_writable(false) || !compiled)
+        return false;
+
+    block.native = reinterpret_cast<void (*)(JitState*)>(m_code + m_code_used);
+    block.max_cycles = max_cycles;
+    block.native_failed = false;
+
+    m_code_used = (m_code_used + assembler.size() + 15) & ~static_cast<size_t>(15);
+    m_compiled_blocks++;
+
+    return true;
+}
+
+void JitX64::reset()
+{
+    m_code_used = 0;
+    m_compiled_blocks = 0;
+    m_full = false;
+}
+
+// Code memory is never writable and executable at the same time
+bool JitX64::set_writable(bool writable)
+{
+#ifdef _WIN32
+    DWORD old_protection = 0;
+    return VirtualProtect(m_code, CodeSize, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &old_protection) != 0;
+#else
+    return mprotect(m_code, CodeSize, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+#endif
+}
+
+#else
+
+// Other architectures always use the interpreter
+JitX64::JitX64() {}
+JitX64::~JitX64() {}
+
+bool JitX64::supported()
+{
+    return false;
+}
+
+bool JitX64::compile(CodeBlock& block)
+{
+    block.native_failed = true;
+    return false;
+}
+
+void JitX64::reset() {}
+
+bool JitX64::set_writable(bool)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define EMU_JIT_X64
+#endif
+
+struct CodeBlock;
+
+// CPU state shared with the native code, loaded when a block starts and
+// written back when it exits
+struct JitState
+{
+    const uint8_t* const* read_pages = nullptr;
+    uint8_t* ram = nullptr;
+    uint32_t cycles = 0;        // Cycles used by the instructions executed
+    uint32_t instructions = 0;  // Instructions executed, 0 if the first one needs the interpreter
+    uint16_t PC = 0;
+    uint8_t A = 0;
+    uint8_t X = 0;
+    uint8_t Y = 0;
+    uint8_t P = 0;
+    uint8_t SP = 0;
+};
+
+// Translates blocks of PRG ROM code to x86-64. The native code reads RAM and
+// the mapped PRG ROM/RAM pages directly and writes only to RAM, any other
+// access (PPU, APU, controllers, mapper registers) leaves the block before
+// the instruction so the interpreter runs it with the right timing. Bank
+// switches are mapper writes so they always happen outside native code.
+class JitX64
+{
+public:
+    JitX64();
+    ~JitX64();
+
+    JitX64(const JitX64&) = delete;
+    JitX64& operator=(const JitX64&) = delete;
+
+    static bool supported();
+
+    // Sets block.native and block.max_cycles, or block.native_failed
+    bool compile(CodeBlock& block);
+    // Drops all the compiled code, the blocks pointing to it must be gone
+    void reset();
+
+    // No room left for the last block, reset() before compiling again
+    bool full() const { return m_full; }
+    size_t compiled_blocks() const { return m_compiled_blocks; }
+
+private:
+    static constexpr size_t CodeSize = 4 * 1024 * 1024;
+
+    uint8_t* m_code = nullptr;
+    size_t m_code_used = 0;
+    size_t m_compiled_blocks = 0;
+    bool m_full = false;
+
+    bool set_writable(bool writable);
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "cpu.hpp"
+#include "apu.hpp"
+#include "ppu.hpp"
+#include "controller.hpp"
+#include "system_bus.hpp"
+#include "scheduler.hpp"
+#include "mapper.hpp"
+#include <type_traits>
+
+// Everything the emulation changes, each part kept by its component as it is
+// here. The output buffers, the caches derived from the state and the ROM
+// are kept apart. Saving, loading or cloning a machine copies the parts.
+struct MachineState
+{
+    CPU::State cpu;
+    Scheduler scheduler;
+    Controller::State controller;
+    PPU::State ppu;
+    SystemBus::State system_bus;
+    APU::State apu;
+    Mapper::State mapper;
+};
+
+static_assert(std::is_trivially_copyable_v<MachineState>);
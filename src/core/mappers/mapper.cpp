@@ -1,45 +1,69 @@
 #include "mapper.hpp"
+#include <cstring>
 
-Mapper::Mapper(NesRom& rom)
+Mapper::Mapper(std::shared_ptr<const RomImage> rom):
+    m_rom(std::move(rom))
 {
-    m_id = rom.mapper_id();
-    m_prg_banks = rom.program_banks();
-    m_prg_size = rom.program_rom_size();
-    m_prg_ram_size = rom.program_ram_size();
-    m_chr_banks = rom.character_banks();
-    m_chr_size = rom.character_rom_size();
-    m_mirroring_mode = rom.mirroring_mode();
+    m_id = m_rom->mapper_id();
+    m_prg_banks = m_rom->program_banks();
+    m_prg_size = m_rom->prg_size();
+    m_chr_size = m_rom->chr_size();
+    m_rom_checksum = m_rom->checksum();
 
-    m_prg_ram.resize(m_prg_ram_size);
+    m_state.mirroring_mode = m_rom->mirroring_mode();
 
-    m_prg.resize(m_prg_size);
-    rom.read_prg_data(m_prg);
- 
+    m_prg = m_rom->prg();
     if (m_chr_size == 0)
     {
-        m_chr_size = 0x2000;
-        m_chr.resize(m_chr_size);
+        m_chr_size = ChrRamSize;
+        m_chr_ram = true;
+        m_chr = m_state.chr_ram;
+        m_chr_ram_tiles.resize(m_chr_size / 16 * ChrTileSize);
+        m_chr_tiles = m_chr_ram_tiles.data();
+        m_chr_tile_valid.resize(m_chr_size / 16, false);
+        m_chr_decoded.resize(m_chr_size);
     }
     else
     {
-        m_chr.resize(m_chr_size);
-        rom.read_chr_data(m_chr);
+        m_chr = m_rom->chr();
+        m_chr_tiles = m_rom->chr_tiles();
     }
 }
 
+Mapper::~Mapper()
+{
+    if (m_memory_map)
+    {
+        m_memory_map->unmap(0x6000, 0xA000);
+        m_memory_map->set_rom(nullptr, 0);
+    }
+}
+
+void Mapper::set_memory_map(MemoryMap* memory_map)
+{
+    m_memory_map = memory_map;
+
+    // PRG RAM reads are direct, writes go through cpu_write since not all mappers enable it
+    m_memory_map->map_read(0x6000, PrgRamSize, m_state.prg_ram);
+    m_memory_map->set_rom(m_prg, m_prg_size);
+
+    for (uint16_t slot = 0; slot < MaxPrgBankCount; slot++)
+        m_memory_map->map_read(0x8000 + slot * 0x2000, 0x2000, m_prg + m_state.prg_mapping[slot]);
+}
+
 uint8_t Mapper::cpu_read(uint16_t address)
 {
     if (address < 0x6000)
         return 0x00; // Expansion ROM, not supported
     else if (address < 0x8000)
-        return m_prg_ram[address - 0x6000];
+        return m_state.prg_ram[address - 0x6000];
     else
-        return m_prg[m_prg_mapping[(address - 0x8000) / 0x2000] + ((address - 0x8000) % 0x2000)];
+        return m_prg[m_state.prg_mapping[(address - 0x8000) / 0x2000] + ((address - 0x8000) % 0x2000)];
 }
 
 uint8_t Mapper::ppu_read(uint16_t address)
 {
-    return m_chr[m_chr_mapping[address / 0x400] + (address % 0x400)];
+    return m_chr[m_state.chr_mapping[address / 0x400] + (address % 0x400)];
 }
 
 void Mapper::map_prg(uint32_t size_kb, uint16_t slot, uint16_t bank)
@@ -48,11 +72,105 @@ void Mapper::map_prg(uint32_t size_kb, uint16_t slot, uint16_t bank)
         bank = (m_prg_size / (0x400 * size_kb)) + bank;
 
     for (int i = 0; i < (size_kb / 8); i++)
-        m_prg_mapping[(size_kb / 8) * slot + i] = (size_kb * 0x400 * bank + 0x2000 * i) % m_prg_size;
+    {
+        const uint16_t index = (size_kb / 8) * slot + i;
+        m_state.prg_mapping[index] = (size_kb * 0x400 * bank + 0x2000 * i) % m_prg_size;
+
+        if (m_memory_map)
+            m_memory_map->map_read(0x8000 + index * 0x2000, 0x2000, m_prg + m_state.prg_mapping[index]);
+    }
+}
+
+bool Mapper::load_state(const State& state)
+{
+    // Checked before anything changes, a bad state leaves the mapper as it was
+    if (state.mirroring_mode != MirroringMode::Horizontal && state.mirroring_mode != MirroringMode::Vertical &&
+        state.mirroring_mode != MirroringMode::FourScreens)
+        return false;
+
+    for (uint32_t offset : state.prg_mapping)
+    {
+        if (offset > m_prg_size - 0x2000)
+            return false;
+    }
+
+    for (uint32_t offset : state.chr_mapping)
+    {
+        if (offset > m_chr_size - 0x400)
+            return false;
+    }
+
+    m_state = state;
+
+    // Only the tiles which changed are decoded again
+    if (m_chr_ram)
+    {
+        for (uint32_t offset = 0; offset < m_chr_size; offset += 16)
+        {
+            if (m_chr_tile_valid[offset / 16] && std::memcmp(&m_chr_decoded[offset], m_chr + offset, 16) != 0)
+                m_chr_tile_valid[offset / 16] = false;
+        }
+    }
+
+    // Remapping a bank changes the memory map version, the CPU keeps its
+    // decoded code if the banks are the same
+    if (m_memory_map)
+    {
+        for (uint16_t slot = 0; slot < MaxPrgBankCount; slot++)
+        {
+            const uint16_t address = 0x8000 + slot * 0x2000;
+            const uint8_t* bank = m_prg + m_state.prg_mapping[slot];
+            if (m_memory_map->read_page(address) != bank)
+                m_memory_map->map_read(address, 0x2000, bank);
+        }
+    }
+
+    return true;
+}
+
+void Mapper::write_chr(uint32_t offset, uint8_t data)
+{
+    // CHR ROM is not part of the state, writes to it are ignored like on the
+    // boards without CHR RAM
+    if (!m_chr_ram)
+        return;
+
+    m_state.chr_ram[offset] = data;
+    m_chr_tile_valid[offset / 16] = false;
+}
+
+void Mapper::decode_chr_tile(const uint8_t* pattern, uint8_t* decoded)
+{
+    for (int row = 0; row < 8; row++)
+    {
+        uint8_t flipped_low = 0;
+        uint8_t flipped_high = 0;
+
+        for (int x = 0; x < 8; x++)
+        {
+            const uint8_t low = (pattern[row] >> (7 - x)) & 1;
+            const uint8_t high = (pattern[row + 8] >> (7 - x)) & 1;
+            decoded[ChrTilePixels + row * 8 + x] = low | (high << 1);
+            decoded[ChrTileFlippedPixels + row * 8 + 7 - x] = low | (high << 1);
+            flipped_low |= low << x;
+            flipped_high |= high << x;
+        }
+
+        decoded[ChrTileFlippedPattern + row] = flipped_low;
+        decoded[ChrTileFlippedPattern + row + 8] = flipped_high;
+    }
+}
+
+void Mapper::decode_chr_ram_tile(uint32_t tile)
+{
+    const uint8_t* pattern = m_state.chr_ram + tile * 16;
+    decode_chr_tile(pattern, m_chr_ram_tiles.data() + tile * ChrTileSize);
+    std::memcpy(&m_chr_decoded[tile * 16], pattern, 16);
+    m_chr_tile_valid[tile] = true;
 }
 
 void Mapper::map_chr(uint32_t size_kb, uint16_t slot, uint16_t bank)
 {
     for (int i = 0; i < size_kb; i++)
-        m_chr_mapping[size_kb * slot + i] = (size_kb * 0x400 * bank + 0x400 * i) % m_chr_size;
+        m_state.chr_mapping[size_kb * slot + i] = (size_kb * 0x400 * bank + 0x400 * i) % m_chr_size;
 }
@@ -1,9 +1,13 @@
 #pragma once
 
-#include "nes_rom.hpp"
+#include "rom_image.hpp"
+#include "memory_map.hpp"
 #include <cstdint>
 #include <string>
 #include <array>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <vector>
 
 enum SupportedMappers
@@ -18,40 +22,110 @@ enum SupportedMappers
 class Mapper
 {
 public:
-    Mapper(NesRom& rom);
-    virtual ~Mapper() {};
+    static constexpr uint8_t MaxPrgBankCount = 4;
+    static constexpr uint8_t MaxChrBankCount = 8;
+    static constexpr uint32_t PrgRamSize = 0x2000;
+    static constexpr uint32_t ChrRamSize = 0x2000;
+    static constexpr uint32_t BoardStateSize = 16;
 
+    // What the board changes, part of the machine state. The bank and IRQ
+    // registers are laid out by each board in board.
+    struct State
+    {
+        MirroringMode mirroring_mode = MirroringMode::Horizontal;
+        std::array<uint32_t, MaxPrgBankCount> prg_mapping = {};
+        std::array<uint32_t, MaxChrBankCount> chr_mapping = {};
+        alignas(8) uint8_t board[BoardStateSize] = {};
+        uint8_t prg_ram[PrgRamSize] = {};
+        uint8_t chr_ram[ChrRamSize] = {};
+    };
+
+public:
+    Mapper(std::shared_ptr<const RomImage> rom);
+    virtual ~Mapper();
+
+    void set_memory_map(MemoryMap* memory_map);
     uint16_t id() const { return m_id; }
-    MirroringMode mirroring_mode() { return m_mirroring_mode; }
+    // FNV-1a of the PRG and CHR ROM, a save state is only loaded by the same game
+    uint32_t rom_checksum() const { return m_rom_checksum; }
+    MirroringMode mirroring_mode() { return m_state.mirroring_mode; }
     uint8_t cpu_read(uint16_t address);
     virtual void cpu_write(uint16_t address, uint8_t data) = 0;
     uint8_t ppu_read(uint16_t address);
     virtual void ppu_write(uint16_t address, uint8_t data) = 0;
 
+    // Decoded tile of the pattern table address, ChrTileSize bytes: 8x8
+    // pixels (0-3), the same flipped horizontally, then the 16 pattern bytes
+    // flipped horizontally
+    const uint8_t* chr_tile(uint16_t address)
+    {
+        const uint32_t tile = (m_state.chr_mapping[address / 0x400] + (address % 0x400)) / 16;
+        if (m_chr_ram && !m_chr_tile_valid[tile])
+            decode_chr_ram_tile(tile);
+
+        return m_chr_tiles + tile * ChrTileSize;
+    }
+
+    // The 16 pattern bytes of a tile into its ChrTileSize bytes
+    static void decode_chr_tile(const uint8_t* pattern, uint8_t* decoded);
+
     virtual bool irq() { return false; }
     virtual void irq_clear() {}
     virtual void scanline() {}
+    // Scanline counter clocks until the IRQ is raised, NoIrq if it is not
+    virtual uint32_t scanlines_until_irq() const { return NoIrq; }
 
-    static constexpr uint8_t MaxPrgBankCount = 4;
-    static constexpr uint8_t MaxChrBankCount = 8;
+    const State& state() const { return m_state; }
+    // False if its banks are out of the ROM or its mirroring is unknown,
+    // nothing is loaded then
+    bool load_state(const State& state);
+
+    static constexpr uint32_t NoIrq = UINT32_MAX;
+    static constexpr uint32_t ChrTilePixels = 0;
+    static constexpr uint32_t ChrTileFlippedPixels = 64;
+    static constexpr uint32_t ChrTileFlippedPattern = 128;
+    static constexpr uint32_t ChrTileSize = 144;
 
 protected:
     uint16_t m_id = 0;
     uint8_t m_prg_banks = 0;
     uint32_t m_prg_size = 0;
-    uint32_t m_prg_ram_size = 0;
-    uint8_t m_chr_banks = 0;
     uint32_t m_chr_size = 0;
+    bool m_chr_ram = false;
+    uint32_t m_rom_checksum = 0;
+
+    State m_state;
+
+    // PRG and CHR ROM are read from the image, shared with the other
+    // cartridges running the same game
+    std::shared_ptr<const RomImage> m_rom;
+    const uint8_t* m_prg = nullptr;
+    // CHR ROM, or the CHR RAM in the state
+    const uint8_t* m_chr = nullptr;
 
-    MirroringMode m_mirroring_mode = MirroringMode::Horizontal;
+    // Indexed by physical CHR offset, a bank switch only changes which tiles
+    // chr_tile() finds through the CHR mapping. The CHR ROM tiles are decoded
+    // in the image, the CHR RAM ones here when they are first used.
+    const uint8_t* m_chr_tiles = nullptr;
+    std::vector<uint8_t> m_chr_ram_tiles;
+    std::vector<bool> m_chr_tile_valid;
+    // CHR RAM as it was when its tiles were decoded, a loaded state only
+    // drops the tiles which differ
+    std::vector<uint8_t> m_chr_decoded;
 
-    std::array<uint32_t, MaxPrgBankCount> m_prg_mapping = {};
-    std::array<uint32_t, MaxChrBankCount> m_chr_mapping = {};
+    MemoryMap* m_memory_map = nullptr;
 
-    std::vector<uint8_t> m_prg;
-    std::vector<uint8_t> m_prg_ram;
-    std::vector<uint8_t> m_chr;
+    // The board's registers in the state, constructed once by the board
+    template <typename T>
+    T& create_board_state()
+    {
+        static_assert(std::is_trivially_copyable_v<T> && sizeof(T) <= BoardStateSize && alignof(T) <= 8);
+        return *new (m_state.board) T();
+    }
 
     void map_prg(uint32_t size_kb, uint16_t slot, uint16_t bank);
     void map_chr(uint32_t size_kb, uint16_t slot, uint16_t bank);
+    // CHR RAM writes go through here so the decoded tile is dropped
+    void write_chr(uint32_t offset, uint8_t data);
+    void decode_chr_ram_tile(uint32_t tile);
 };
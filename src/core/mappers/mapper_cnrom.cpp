@@ -1,7 +1,8 @@
 #include "mapper_cnrom.hpp"
 
-Mapper_CNROM::Mapper_CNROM(NesRom& rom) :
-    Mapper(rom)
+Mapper_CNROM::Mapper_CNROM(std::shared_ptr<const RomImage> rom) :
+    Mapper(std::move(rom)),
+    m_board(create_board_state<Board>())
 {
     configure();
 }
@@ -10,14 +11,14 @@ void Mapper_CNROM::cpu_write(uint16_t address, uint8_t data)
 {
     if (address & 0x8000)
     {
-        m_register = data;
+        m_board.bank = data;
         configure();
     }
 }
 
 void Mapper_CNROM::ppu_write(uint16_t address, uint8_t data)
 {
-    m_chr[address] = data;
+    write_chr(address, data);
 }
 
 void Mapper_CNROM::configure()
@@ -33,5 +34,5 @@ void Mapper_CNROM::configure()
         map_prg(16, 1, 1);
     }
 
-    map_chr(8, 0, m_register & 0b11);
+    map_chr(8, 0, m_board.bank & 0b11);
 }
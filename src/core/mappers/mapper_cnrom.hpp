@@ -5,7 +5,7 @@
 class Mapper_CNROM : public Mapper
 {
 public:
-    Mapper_CNROM(NesRom& rom);
+    Mapper_CNROM(std::shared_ptr<const RomImage> rom);
     virtual ~Mapper_CNROM() {}
 
 protected:
@@ -13,7 +13,12 @@ protected:
     void ppu_write(uint16_t address, uint8_t data) override;
 
 private:
-    uint8_t m_register = 0;
+    struct Board
+    {
+        uint8_t bank = 0;
+    };
+
+    Board& m_board;
 
     void configure();
 };
\ No newline at end of file
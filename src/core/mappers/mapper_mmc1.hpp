@@ -5,7 +5,7 @@
 class Mapper_MMC1 : public Mapper
 {
 public:
-    Mapper_MMC1(NesRom& rom);
+    Mapper_MMC1(std::shared_ptr<const RomImage> rom);
     virtual ~Mapper_MMC1() {}
 
 protected:
@@ -13,9 +13,14 @@ protected:
     void ppu_write(uint16_t address, uint8_t data) override;
 
 private:
-    uint8_t m_shift_register = 0;
-    uint8_t m_count = 0;
-    std::array<uint8_t, 4> m_registers = {};
+    struct Board
+    {
+        uint8_t shift_register = 0;
+        uint8_t count = 0;
+        std::array<uint8_t, 4> registers = {};
+    };
+
+    Board& m_board;
 
     void configure();
 };
@@ -1,7 +1,8 @@
 #include "mapper_mmc3.hpp"
 
-Mapper_MMC3::Mapper_MMC3(NesRom& rom) :
-    Mapper(rom)
+Mapper_MMC3::Mapper_MMC3(std::shared_ptr<const RomImage> rom) :
+    Mapper(std::move(rom)),
+    m_board(create_board_state<Board>())
 {
     map_prg(8, 3, -1);
     configure();
@@ -10,38 +11,38 @@ Mapper_MMC3::Mapper_MMC3(NesRom& rom) :
 void Mapper_MMC3::cpu_write(uint16_t address, uint8_t data)
 {
     if (address < 0x8000)
-        m_prg_ram[address - 0x6000] = data;
+        m_state.prg_ram[address - 0x6000] = data;
     else if (address & 0x8000)
     {
         switch (address & 0xE001)
         {
         case 0x8000:
-            m_tregister = data;
+            m_board.tregister = data;
             break;
 
         case 0x8001:
-            m_registers[m_tregister & 0b111] = data;
+            m_board.registers[m_board.tregister & 0b111] = data;
             break;
 
         case 0xA000:
-            m_horizontal_mirroring = data & 1;
+            m_board.horizontal_mirroring = data & 1;
             break;
 
         case 0xC000:
-            m_irq_time = data;
+            m_board.irq_time = data;
             break;
 
         case 0xC001:
-            m_irq_count = 0;
+            m_board.irq_count = 0;
             break;
 
         case 0xE000:
-            m_irq = false;
-            m_irq_enabled = false;
+            m_board.irq = false;
+            m_board.irq_enabled = false;
             break;
 
         case 0xE001:
-            m_irq_enabled = true;
+            m_board.irq_enabled = true;
             break;
         }
 
@@ -51,51 +52,60 @@ void Mapper_MMC3::cpu_write(uint16_t address, uint8_t data)
 
 void Mapper_MMC3::ppu_write(uint16_t address, uint8_t data)
 {
-    m_chr[address] = data;
+    write_chr(address, data);
 }
 
 void Mapper_MMC3::scanline()
 {
-    if (m_irq_count == 0)
-        m_irq_count = m_irq_time;
+    if (m_board.irq_count == 0)
+        m_board.irq_count = m_board.irq_time;
     else
-        m_irq_count--;
+        m_board.irq_count--;
 
-    if (m_irq_enabled && m_irq_count == 0)
-        m_irq = true;
+    if (m_board.irq_enabled && m_board.irq_count == 0)
+        m_board.irq = true;
+}
+
+uint32_t Mapper_MMC3::scanlines_until_irq() const
+{
+    if (!m_board.irq_enabled)
+        return NoIrq;
+
+    // An empty counter is reloaded on the next clock
+    return m_board.irq_count == 0 ? m_board.irq_time + 1 : m_board.irq_count;
 }
 
 void Mapper_MMC3::configure()
 {
-    map_prg(8, 1, m_registers[7]);
+    map_prg(8, 1, m_board.registers[7]);
 
-    if (!(m_tregister & (1 << 6)))
+    if (!(m_board.tregister & (1 << 6)))
     {
-        map_prg(8, 0, m_registers[6]);
+        map_prg(8, 0, m_board.registers[6]);
         map_prg(8, 2, -2);
     }
     else
     {
         map_prg(8, 0, -2);
-        map_prg(8, 2, m_registers[6]);
+        map_prg(8, 2, m_board.registers[6]);
     }
 
-    if (!(m_tregister & (1 << 7)))
+    if (!(m_board.tregister & (1 << 7)))
     {
-        map_chr(2, 0, m_registers[0] >> 1);
-        map_chr(2, 1, m_registers[1] >> 1);
+        map_chr(2, 0, m_board.registers[0] >> 1);
+        map_chr(2, 1, m_board.registers[1] >> 1);
 
         for (int i = 0; i < 4; i++)
-            map_chr(1, 4 + i, m_registers[2 + i]);
+            map_chr(1, 4 + i, m_board.registers[2 + i]);
     }
     else
     {
         for (int i = 0; i < 4; i++)
-            map_chr(1, i, m_registers[2 + i]);
+            map_chr(1, i, m_board.registers[2 + i]);
 
-        map_chr(2, 2, m_registers[0] >> 1);
-        map_chr(2, 3, m_registers[1] >> 1);
+        map_chr(2, 2, m_board.registers[0] >> 1);
+        map_chr(2, 3, m_board.registers[1] >> 1);
     }
 
-    m_mirroring_mode = m_horizontal_mirroring ? MirroringMode::Horizontal : MirroringMode::Vertical;
+    m_state.mirroring_mode = m_board.horizontal_mirroring ? MirroringMode::Horizontal : MirroringMode::Vertical;
 }
@@ -5,24 +5,30 @@
 class Mapper_MMC3 : public Mapper
 {
 public:
-    Mapper_MMC3(NesRom& rom);
+    Mapper_MMC3(std::shared_ptr<const RomImage> rom);
     virtual ~Mapper_MMC3() {}
 
 protected:
     void cpu_write(uint16_t address, uint8_t data) override;
     void ppu_write(uint16_t address, uint8_t data) override;
-    bool irq() override { return m_irq; }
-    void irq_clear() override { m_irq = false; }
+    bool irq() override { return m_board.irq; }
+    void irq_clear() override { m_board.irq = false; }
     void scanline() override;
+    uint32_t scanlines_until_irq() const override;
 
 private:
-    uint8_t m_tregister = 0;
-    std::array<uint8_t, 8> m_registers = {};
-    uint8_t m_irq_time = 0;
-    uint8_t m_irq_count = 0;
-    bool m_irq_enabled = false;
-    bool m_irq = false;
-    bool m_horizontal_mirroring = true;
+    struct Board
+    {
+        uint8_t tregister = 0;
+        std::array<uint8_t, 8> registers = {};
+        uint8_t irq_time = 0;
+        uint8_t irq_count = 0;
+        bool irq_enabled = false;
+        bool irq = false;
+        bool horizontal_mirroring = true;
+    };
+
+    Board& m_board;
 
     void configure();
 };
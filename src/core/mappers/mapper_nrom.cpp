@@ -1,8 +1,8 @@
 #include "mapper_nrom.hpp"
 #include "common.hpp"
 
-Mapper_NROM::Mapper_NROM(NesRom& rom) :
-    Mapper(rom)
+Mapper_NROM::Mapper_NROM(std::shared_ptr<const RomImage> rom) :
+    Mapper(std::move(rom))
 {
     map_prg(32, 0, 0);
     map_chr(8, 0, 0);
@@ -5,7 +5,7 @@
 class Mapper_NROM : public Mapper
 {
 public:
-    Mapper_NROM(NesRom& rom);
+    Mapper_NROM(std::shared_ptr<const RomImage> rom);
     virtual ~Mapper_NROM() {}
 
 protected:
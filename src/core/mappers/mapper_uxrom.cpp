@@ -1,7 +1,8 @@
 #include "mapper_uxrom.hpp"
 
-Mapper_UxROM::Mapper_UxROM(NesRom& rom):
-    Mapper(rom)
+Mapper_UxROM::Mapper_UxROM(std::shared_ptr<const RomImage> rom):
+    Mapper(std::move(rom)),
+    m_board(create_board_state<Board>())
 {
     configure();
 }
@@ -10,19 +11,19 @@ void Mapper_UxROM::cpu_write(uint16_t address, uint8_t data)
 {
     if (address & 0x8000)
     {
-        m_register = data;
+        m_board.bank = data;
         configure();
     }
 }
 
 void Mapper_UxROM::ppu_write(uint16_t address, uint8_t data)
 {
-    m_chr[address] = data;
+    write_chr(address, data);
 }
 
 void Mapper_UxROM::configure()
 {
-    map_prg(16, 0, m_register & 0xF);
+    map_prg(16, 0, m_board.bank & 0xF);
     map_prg(16, 1, 0xF);
     map_chr(8, 0, 0);
 }
@@ -5,7 +5,7 @@
 class Mapper_UxROM : public Mapper
 {
 public:
-    Mapper_UxROM(NesRom& rom);
+    Mapper_UxROM(std::shared_ptr<const RomImage> rom);
     virtual ~Mapper_UxROM() {}
 
 protected:
@@ -13,7 +13,12 @@ protected:
     void ppu_write(uint16_t address, uint8_t data) override;
 
 private:
-    uint8_t m_register = 0;
+    struct Board
+    {
+        uint8_t bank = 0;
+    };
+
+    Board& m_board;
 
     void configure();
 };
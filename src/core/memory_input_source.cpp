@@ -0,0 +1,44 @@
+#include "memory_input_source.hpp"
+#include "logger.hpp"
+#include <fstream>
+
+void MemoryInputSource::poll_buttons_state(uint8_t* buttons, uint8_t count)
+{
+    if (m_frame < m_frames.size())
+        m_buttons = m_frames[m_frame++];
+    else if (!m_frames.empty())
+        m_buttons = {};
+
+    for (uint8_t i = 0; i < count && i < Controller::ControllerCount; i++)
+        buttons[i] = m_buttons[i];
+}
+
+void MemoryInputSource::set_buttons_state(uint8_t index, uint8_t state)
+{
+    if (index >= Controller::ControllerCount)
+    {
+        LOG_WARNING("Invalid controller index %u", index);
+        return;
+    }
+
+    m_buttons[index] = state;
+}
+
+bool MemoryInputSource::load_from_file(const std::string& file_path)
+{
+    std::ifstream stream(file_path, std::ios::in | std::ios::binary);
+    if (!stream.is_open())
+    {
+        LOG_ERROR("Cannot open input file %s", file_path.c_str());
+        return false;
+    }
+
+    m_frames.clear();
+    m_frame = 0;
+
+    FrameState frame = {};
+    while (stream.read(reinterpret_cast<char*>(frame.data()), frame.size()))
+        m_frames.push_back(frame);
+
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "input_source.hpp"
+#include "controller.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+
+// Input source fed from memory, either pushed in before each frame or played
+// back from a recorded sequence with one buttons state per controller per frame
+class MemoryInputSource : public InputSource
+{
+public:
+    void poll_buttons_state(uint8_t* buttons, uint8_t count) override;
+
+    void set_buttons_state(uint8_t index, uint8_t state);
+    bool load_from_file(const std::string& file_path);
+
+private:
+    using FrameState = std::array<uint8_t, Controller::ControllerCount>;
+
+    FrameState m_buttons = {};
+    std::vector<FrameState> m_frames;
+    size_t m_frame = 0;
+};
@@ -0,0 +1,49 @@
+#include "memory_map.hpp"
+#include <cassert>
+
+void MemoryMap::map_read(uint16_t address, uint32_t size, const uint8_t* memory)
+{
+    assert((address & PageMask) == 0 && (size & PageMask) == 0);
+
+    for (uint32_t offset = 0; offset < size; offset += PageSize)
+        m_read_pages[(address + offset) >> PageShift] = memory + offset;
+
+    m_version++;
+}
+
+void MemoryMap::map_write(uint16_t address, uint32_t size, uint8_t* memory)
+{
+    assert((address & PageMask) == 0 && (size & PageMask) == 0);
+
+    for (uint32_t offset = 0; offset < size; offset += PageSize)
+        m_write_pages[(address + offset) >> PageShift] = memory + offset;
+
+    m_version++;
+}
+
+void MemoryMap::unmap(uint16_t address, uint32_t size)
+{
+    for (uint32_t offset = 0; offset < size; offset += PageSize)
+    {
+        m_read_pages[(address + offset) >> PageShift] = nullptr;
+        m_write_pages[(address + offset) >> PageShift] = nullptr;
+    }
+
+    m_version++;
+}
+
+void MemoryMap::set_rom(const uint8_t* rom, uint32_t size)
+{
+    m_rom = rom;
+    m_rom_size = size;
+    m_version++;
+}
+
+int32_t MemoryMap::rom_offset(uint16_t address) const
+{
+    const uint8_t* page = read_page(address);
+    if (page == nullptr || page < m_rom || page >= m_rom + m_rom_size)
+        return -1;
+
+    return static_cast<int32_t>(page - m_rom) + (address & PageMask);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+
+// CPU address space split in 1KB pages. Pages backed by memory are read and
+// written directly, unmapped pages go through the SystemBus I/O handlers.
+class MemoryMap
+{
+public:
+    static constexpr uint16_t PageShift = 10;
+    static constexpr uint16_t PageSize = 1 << PageShift;
+    static constexpr uint16_t PageMask = PageSize - 1;
+    static constexpr uint16_t PageCount = 0x10000 >> PageShift;
+
+    const uint8_t* read_page(uint16_t address) const { return m_read_pages[address >> PageShift]; }
+    uint8_t* write_page(uint16_t address) const { return m_write_pages[address >> PageShift]; }
+    const uint8_t* const* read_pages() const { return m_read_pages.data(); }
+
+    void map_read(uint16_t address, uint32_t size, const uint8_t* memory);
+    void map_write(uint16_t address, uint32_t size, uint8_t* memory);
+    void unmap(uint16_t address, uint32_t size);
+
+    // PRG ROM, code read from it can be decoded once and cached
+    void set_rom(const uint8_t* rom, uint32_t size);
+    uint32_t rom_size() const { return m_rom_size; }
+    int32_t rom_offset(uint16_t address) const;
+
+    // Changes every time a page is mapped or unmapped
+    uint32_t version() const { return m_version; }
+
+private:
+    std::array<const uint8_t*, PageCount> m_read_pages = {};
+    std::array<uint8_t*, PageCount> m_write_pages = {};
+    const uint8_t* m_rom = nullptr;
+    uint32_t m_rom_size = 0;
+    uint32_t m_version = 0;
+};
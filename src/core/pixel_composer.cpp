@@ -0,0 +1,250 @@
+#include "pixel_composer.hpp"
+
+#ifdef EMU_COMPOSE_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define EMU_TARGET_AVX2
+#else
+#define EMU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+
+inline uint8_t palette_address(uint8_t background, uint8_t sprite)
+{
+    if ((sprite & 3) != 0 && (!(sprite & 0x20) || (background & 3) == 0))
+        return sprite & 0x1F;
+
+    return (background & 3) != 0 ? (background & 0x0F) : 0;
+}
+
+void compose_scalar(const uint8_t* background, const uint8_t* sprites, const uint32_t* colors,
+                    uint32_t* output, int count)
+{
+    for (int i = 0; i < count; i++)
+        output[i] = colors[palette_address(background[i], sprites[i])];
+}
+
+void compose_indices_scalar(const uint8_t* background, const uint8_t* sprites, const uint16_t* indices,
+                            uint16_t* output, int count)
+{
+    for (int i = 0; i < count; i++)
+        output[i] = indices[palette_address(background[i], sprites[i])];
+}
+
+void convert_scalar(const uint16_t* indices, const uint32_t* palette, uint32_t* output, int count)
+{
+    for (int i = 0; i < count; i++)
+        output[i] = palette[indices[i] & 0x1FF];
+}
+
+const PixelComposer::Functions ScalarFunctions = { compose_scalar, compose_indices_scalar, convert_scalar };
+
+#ifdef EMU_COMPOSE_X64
+
+// Same selection as palette_address() on 16 pixels
+inline __m128i palette_addresses(__m128i background, __m128i sprites)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pixel_mask = _mm_set1_epi8(3);
+    const __m128i priority_mask = _mm_set1_epi8(0x20);
+
+    const __m128i background_clear = _mm_cmpeq_epi8(_mm_and_si128(background, pixel_mask), zero);
+    const __m128i sprite_clear = _mm_cmpeq_epi8(_mm_and_si128(sprites, pixel_mask), zero);
+    const __m128i behind = _mm_cmpeq_epi8(_mm_and_si128(sprites, priority_mask), priority_mask);
+
+    // Sprite opaque and not behind an opaque background
+    const __m128i use_sprite = _mm_andnot_si128(_mm_or_si128(sprite_clear, _mm_andnot_si128(background_clear, behind)),
+                                                _mm_set1_epi8(-1));
+    const __m128i sprite_address = _mm_and_si128(sprites, _mm_set1_epi8(0x1F));
+    const __m128i background_address = _mm_andnot_si128(background_clear,
+                                                         _mm_and_si128(background, _mm_set1_epi8(0x0F)));
+
+    return _mm_or_si128(_mm_and_si128(use_sprite, sprite_address),
+                        _mm_andnot_si128(use_sprite, background_address));
+}
+
+void compose_sse2(const uint8_t* background, const uint8_t* sprites, const uint32_t* colors,
+                  uint32_t* output, int count)
+{
+    alignas(16) uint8_t addresses[16];
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i bg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + i));
+        const __m128i spr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sprites + i));
+        _mm_store_si128(reinterpret_cast<__m128i*>(addresses), palette_addresses(bg, spr));
+
+        for (int j = 0; j < 16; j++)
+            output[i + j] = colors[addresses[j]];
+    }
+
+    compose_scalar(background + i, sprites + i, colors, output + i, count - i);
+}
+
+void compose_indices_sse2(const uint8_t* background, const uint8_t* sprites, const uint16_t* indices,
+                          uint16_t* output, int count)
+{
+    alignas(16) uint8_t addresses[16];
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i bg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + i));
+        const __m128i spr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sprites + i));
+        _mm_store_si128(reinterpret_cast<__m128i*>(addresses), palette_addresses(bg, spr));
+
+        for (int j = 0; j < 16; j++)
+            output[i + j] = indices[addresses[j]];
+    }
+
+    compose_indices_scalar(background + i, sprites + i, indices, output + i, count - i);
+}
+
+const PixelComposer::Functions SSE2Functions = { compose_sse2, compose_indices_sse2, convert_scalar };
+
+EMU_TARGET_AVX2 void compose_avx2(const uint8_t* background, const uint8_t* sprites, const uint32_t* colors,
+                                  uint32_t* output, int count)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i pixel_mask = _mm256_set1_epi8(3);
+    const __m256i priority_mask = _mm256_set1_epi8(0x20);
+    const int* table = reinterpret_cast<const int*>(colors);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i bg = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(background + i));
+        const __m256i spr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sprites + i));
+
+        const __m256i background_clear = _mm256_cmpeq_epi8(_mm256_and_si256(bg, pixel_mask), zero);
+        const __m256i sprite_clear = _mm256_cmpeq_epi8(_mm256_and_si256(spr, pixel_mask), zero);
+        const __m256i behind = _mm256_cmpeq_epi8(_mm256_and_si256(spr, priority_mask), priority_mask);
+        const __m256i use_background = _mm256_or_si256(sprite_clear, _mm256_andnot_si256(background_clear, behind));
+
+        const __m256i sprite_address = _mm256_and_si256(spr, _mm256_set1_epi8(0x1F));
+        const __m256i background_address = _mm256_andnot_si256(background_clear,
+                                                               _mm256_and_si256(bg, _mm256_set1_epi8(0x0F)));
+        const __m256i addresses = _mm256_blendv_epi8(sprite_address, background_address, use_background);
+
+        const __m128i low = _mm256_castsi256_si128(addresses);
+        const __m128i high = _mm256_extracti128_si256(addresses, 1);
+        const __m128i parts[4] = { low, _mm_srli_si128(low, 8), high, _mm_srli_si128(high, 8) };
+
+        for (int j = 0; j < 4; j++)
+        {
+            const __m256i index = _mm256_cvtepu8_epi32(parts[j]);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i + j * 8),
+                                _mm256_i32gather_epi32(table, index, 4));
+        }
+    }
+
+    compose_sse2(background + i, sprites + i, colors, output + i, count - i);
+}
+
+EMU_TARGET_AVX2 void convert_avx2(const uint16_t* indices, const uint32_t* palette, uint32_t* output, int count)
+{
+    const int* table = reinterpret_cast<const int*>(palette);
+    const __m256i index_mask = _mm256_set1_epi32(0x1FF);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i));
+        const __m256i index = _mm256_and_si256(_mm256_cvtepu16_epi32(packed), index_mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_i32gather_epi32(table, index, 4));
+    }
+
+    convert_scalar(indices + i, palette, output + i, count - i);
+}
+
+const PixelComposer::Functions AVX2Functions = { compose_avx2, compose_indices_sse2, convert_avx2 };
+
+bool cpu_supports_avx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // The OS must save the YMM registers
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+}
+
+PixelComposer::PixelComposer()
+{
+    if (!set_kernel(Kernel::AVX2) && !set_kernel(Kernel::SSE2))
+        set_kernel(Kernel::Scalar);
+}
+
+bool PixelComposer::supported(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::Scalar:
+        return true;
+#ifdef EMU_COMPOSE_X64
+    case Kernel::SSE2:
+        return true;
+    case Kernel::AVX2:
+    {
+        static const bool avx2 = cpu_supports_avx2();
+        return avx2;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* PixelComposer::name(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::SSE2: return "SSE2";
+    case Kernel::AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+bool PixelComposer::set_kernel(Kernel kernel)
+{
+    if (!supported(kernel))
+        return false;
+
+    switch (kernel)
+    {
+#ifdef EMU_COMPOSE_X64
+    case Kernel::SSE2:
+        m_functions = &SSE2Functions;
+        break;
+    case Kernel::AVX2:
+        m_functions = &AVX2Functions;
+        break;
+#endif
+    default:
+        m_functions = &ScalarFunctions;
+        break;
+    }
+
+    m_kernel = kernel;
+    return true;
+}
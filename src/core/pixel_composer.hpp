@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define EMU_COMPOSE_X64
+#endif
+
+// Composes the pixels of a scanline into colours. Each pixel comes with its
+// palette RAM address: background pixel | palette << 2 and sprite pixel |
+// (palette + 4) << 2 | priority << 5, the left 8 pixels already masked. A
+// sprite pixel is drawn when the background is transparent or its priority
+// bit is clear. colors holds the colour of the 32 palette RAM entries.
+class PixelComposer
+{
+public:
+    enum class Kernel
+    {
+        Scalar,
+        SSE2,   // 16 pixels at once
+        AVX2    // 32 pixels at once, colours gathered 8 at a time
+    };
+
+    static constexpr int KernelCount = 3;
+
+public:
+    // Starts with the fastest kernel the CPU supports
+    PixelComposer();
+
+    static bool supported(Kernel kernel);
+    static const char* name(Kernel kernel);
+
+    bool set_kernel(Kernel kernel);
+    Kernel kernel() const { return m_kernel; }
+
+    void compose(const uint8_t* background, const uint8_t* sprites, const uint32_t* colors,
+                 uint32_t* output, int count) const
+    {
+        m_functions->compose(background, sprites, colors, output, count);
+    }
+
+    // Same with the 9-bit palette index (emphasis << 6 | colour) of the 32
+    // palette RAM entries
+    void compose_indices(const uint8_t* background, const uint8_t* sprites, const uint16_t* indices,
+                         uint16_t* output, int count) const
+    {
+        m_functions->compose_indices(background, sprites, indices, output, count);
+    }
+
+    // Palette indices to colours through the 512 entry palette
+    void convert(const uint16_t* indices, const uint32_t* palette, uint32_t* output, int count) const
+    {
+        m_functions->convert(indices, palette, output, count);
+    }
+
+    struct Functions
+    {
+        void (*compose)(const uint8_t* background, const uint8_t* sprites, const uint32_t* colors,
+                        uint32_t* output, int count);
+        void (*compose_indices)(const uint8_t* background, const uint8_t* sprites, const uint16_t* indices,
+                                uint16_t* output, int count);
+        void (*convert)(const uint16_t* indices, const uint32_t* palette, uint32_t* output, int count);
+    };
+
+private:
+    Kernel m_kernel = Kernel::Scalar;
+    const Functions* m_functions = nullptr;
+};
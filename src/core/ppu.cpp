@@ -1,5 +1,6 @@
 #include "ppu.hpp"
 #include "cartridge.hpp"
+#include <algorithm>
 #include <cstring>
 
 uint32_t PPU::m_default_palette[64] = {
@@ -22,100 +23,242 @@ PPU::PPU(Cartridge& cartridge)
 
 void PPU::reset()
 {
-    m_control.value = 0;
-    m_mask.value = 0;
-    m_status.value = 0;
-    m_vram_address .value = 0;
-    m_tram_address.value = 0;
-    m_fine_x = 0;
-    m_cycle = 0;
-    m_scanline = 0;
-    m_data_buffer = 0;
-    m_offset = false;
-    m_nmi = false;
-
-    m_bg_tile.nametable = 0;
-    m_bg_tile.attribute = 0;
-    m_bg_tile.byte_low = 0;
-    m_bg_tile.byte_high = 0;
-
-    m_bg_shifter.pattern_low = 0;
-    m_bg_shifter.pattern_high = 0;
-    m_bg_shifter.attribute_low = 0;
-    m_bg_shifter.attribute_high = 0;
-
-    m_oam_address = 0;
-    m_sprite_count = 0;
-    m_sprite_zero_hit_possible = false;
-
-    m_frame_rendered = false;
-    m_frame_odd = false;
-
-    memset(m_palette_ram, 0xFF, sizeof(m_palette_ram));
-    memset(m_oam, 0xFF, sizeof(m_oam));
-    memset(m_oam_scanline, 0xFF, sizeof(m_oam_scanline));
+    m_state.control.value = 0;
+    m_state.mask.value = 0;
+    m_state.status.value = 0;
+    m_state.vram_address .value = 0;
+    m_state.tram_address.value = 0;
+    m_state.fine_x = 0;
+    m_state.cycle = 0;
+    m_state.scanline = 0;
+    m_state.data_buffer = 0;
+    m_state.offset = false;
+    m_state.nmi = false;
+
+    m_state.bg_tile.nametable = 0;
+    m_state.bg_tile.attribute = 0;
+    m_state.bg_tile.byte_low = 0;
+    m_state.bg_tile.byte_high = 0;
+
+    m_state.bg_shifter.pattern_low = 0;
+    m_state.bg_shifter.pattern_high = 0;
+    m_state.bg_shifter.attribute_low = 0;
+    m_state.bg_shifter.attribute_high = 0;
+
+    m_state.oam_address = 0;
+    m_state.sprite_count = 0;
+    m_state.sprite_zero_hit_possible = false;
+
+    m_state.frame_rendered = false;
+    m_frame_skipped = false;
+    m_state.frame_odd = false;
+    m_state.cpu_cycles = 0;
+
+    memset(m_state.palette_ram, 0xFF, sizeof(m_state.palette_ram));
+    memset(m_state.oam, 0xFF, sizeof(m_state.oam));
+    memset(m_state.oam_scanline, 0xFF, sizeof(m_state.oam_scanline));
     memset(m_frame_buffer, 0xFF, sizeof(m_frame_buffer));
+    memset(m_index_buffer, 0xFF, sizeof(m_index_buffer));
+    update_colors();
+}
+
+void PPU::frame_start(bool render)
+{
+    m_state.frame_rendered = false;
+    m_frame_skipped = !render;
+
+    if (render && m_colors_stale)
+        update_colors();
+}
+
+void PPU::frame_end()
+{
+    m_state.frame_rendered = true;
+    m_state.frame_odd = !m_state.frame_odd;
+
+    // The PPU can run a few dots into the next frame before it starts, they
+    // are drawn
+    if (m_frame_skipped)
+    {
+        m_frame_skipped = false;
+        if (m_colors_stale)
+            update_colors();
+    }
 }
 
 void PPU::tick()
 {
-    if (m_scanline < 240)
+    if (m_state.scanline < 240)
     {
         if (is_rendering())
             render_cycle();
 
-        if (m_cycle < 256)
+        if (m_state.cycle < 256)
             render_pixel();
     }
-    else if (m_scanline == 241 && m_cycle == 1)
+    else if (m_state.scanline == 241 && m_state.cycle == 1)
     {
-        m_status.vertical_blank = 1;
-        m_nmi = true;
+        m_state.status.vertical_blank = 1;
+        m_state.nmi = true;
     }
-    else if (m_scanline == 261)
+    else if (m_state.scanline == 261)
     {
         if (is_rendering())
             render_cycle();
 
-        if (m_cycle == 1)
+        if (m_state.cycle == 1)
         {
-            m_status.vertical_blank = 0;
-            m_status.sprite_zero_hit = 0;
-            m_nmi = false;
+            m_state.status.vertical_blank = 0;
+            m_state.status.sprite_zero_hit = 0;
+            m_state.nmi = false;
             clear_sprite_shifter();
         }
-        else if (m_cycle > 279 && m_cycle < 305)
+        else if (m_state.cycle > 279 && m_state.cycle < 305)
         {
             if (is_rendering())
                 address_transfer_y();
         }
-        else if (m_cycle == 340 && m_frame_odd && m_mask.render_background)
+        else if (m_state.cycle == 340 && m_state.frame_odd && m_state.mask.render_background)
         {
-            m_cycle = 1;
-            m_scanline = 0;
-            m_frame_rendered = true;
-            m_frame_odd = !m_frame_odd;
+            m_state.cycle = 1;
+            m_state.scanline = 0;
+            frame_end();
             return;
         }
     }
 
-    if (is_rendering() && (m_scanline < 241 && m_cycle == 260))
+    if (is_rendering() && (m_state.scanline < 241 && m_state.cycle == 260))
         m_cartridge.scanline();
 
-    m_cycle++;
-    if (m_cycle > 340)
+    m_state.cycle++;
+    if (m_state.cycle > 340)
     {
-        m_cycle = 0;
-        m_scanline++;
-        if (m_scanline > 261)
+        m_state.cycle = 0;
+        m_state.scanline++;
+        if (m_state.scanline > 261)
         {
-            m_scanline = 0;
-            m_frame_rendered = true;
-            m_frame_odd = !m_frame_odd;
+            m_state.scanline = 0;
+            frame_end();
         }
     }
 }
 
+void PPU::run_until(uint64_t cpu_cycle)
+{
+    if (m_state.cpu_cycles >= cpu_cycle || m_state.frame_rendered)
+        return;
+
+    // Nothing can write to the PPU or switch the CHR banks before the target,
+    // a visible scanline reached in full can be drawn at once. The frame ends
+    // after the 3 dots of a CPU cycle.
+    const uint64_t dots = 3 * (cpu_cycle - m_state.cpu_cycles);
+    uint64_t done = 0;
+    while (done < dots)
+    {
+        // Dots left in the visible part of the scanline, none past its start
+        const uint64_t scanline_dots = m_state.cycle <= 1 ? static_cast<uint64_t>(ScreenWidth - m_state.cycle) : 0;
+        if (m_scanline_renderer_enabled && !m_state.frame_rendered && scanline_dots > 0 &&
+            m_state.scanline < ScreenHeight && dots - done >= scanline_dots)
+        {
+            done += scanline_dots;
+            render_scanline();
+        }
+        else
+        {
+            tick();
+            done++;
+        }
+
+        if (m_state.frame_rendered && done % 3 == 0)
+            break;
+    }
+
+    m_state.cpu_cycles += done / 3;
+}
+
+uint32_t PPU::dots_until(uint16_t scanline, uint16_t cycle) const
+{
+    return (scanline * 341 + cycle) - (m_state.scanline * 341 + m_state.cycle) + 1;
+}
+
+uint32_t PPU::dots_until_nmi()
+{
+    if (nmi())
+        return 0;
+
+    if (m_state.frame_rendered || !m_state.control.nmi_enabled ||
+        !(m_state.scanline < 241 || (m_state.scanline == 241 && m_state.cycle <= 1)))
+        return NoEvent;
+
+    return dots_until(241, 1);
+}
+
+uint32_t PPU::dots_until_frame_end()
+{
+    if (m_state.frame_rendered)
+        return 0;
+
+    // The odd frame skip happens on the same tick
+    return dots_until(261, 340);
+}
+
+uint32_t PPU::dots_until_scanline_counter(uint32_t count)
+{
+    // Clocked on cycle 260 of the visible scanlines while rendering
+    if (m_state.frame_rendered || !is_rendering() || count == 0 || count > 241)
+        return NoEvent;
+
+    const uint32_t scanline = (m_state.cycle <= 260 ? m_state.scanline : m_state.scanline + 1) + count - 1;
+    if (scanline > 240)
+        return NoEvent;
+
+    return dots_until(scanline, 260);
+}
+
+uint32_t PPU::dots_until_status_change()
+{
+    if (m_state.frame_rendered)
+        return 0;
+
+    // Vertical blank is set, then cleared with the sprite 0 hit
+    uint32_t dots = NoEvent;
+    if (m_state.scanline < 241 || (m_state.scanline == 241 && m_state.cycle <= 1))
+        dots = dots_until(241, 1);
+    else if (m_state.scanline < 261 || (m_state.scanline == 261 && m_state.cycle <= 1))
+        dots = dots_until(261, 1);
+
+    if (!is_rendering() || m_state.scanline >= 240)
+        return dots;
+
+    const bool sprite_zero_hit = m_state.mask.render_background && m_state.mask.render_sprites &&
+                                 !m_state.status.sprite_zero_hit;
+    if (sprite_zero_hit && m_state.sprite_zero_hit_possible)
+        return 1;
+
+    // Sprites are evaluated on cycle 257, sprite 0 can hit from the next
+    // scanline and the overflow flag follows the sprite count
+    uint8_t sprite_count[ScreenHeight] = {};
+    const int sprite_height = m_state.control.sprite_size ? 16 : 8;
+    for (int i = 0; i < 256; i += 4)
+    {
+        const int end = std::min<int>(m_state.oam[i] + sprite_height, ScreenHeight);
+        for (int scanline = m_state.oam[i]; scanline < end; scanline++)
+            sprite_count[scanline]++;
+    }
+
+    for (int scanline = (m_state.cycle <= 257 ? m_state.scanline : m_state.scanline + 1); scanline < ScreenHeight; scanline++)
+    {
+        const int sprite_row = scanline - m_state.oam[0];
+        const bool sprite_zero = sprite_row >= 0 && sprite_row < sprite_height;
+        const bool sprite_overflow = sprite_count[scanline] > 8;
+
+        if ((sprite_zero_hit && sprite_zero) || sprite_overflow != (m_state.status.sprite_overflow != 0))
+            return std::min(dots, dots_until(scanline, 257));
+    }
+
+    return dots;
+}
+
 uint8_t PPU::read(uint16_t address)
 {
     uint8_t data = 0;
@@ -124,22 +267,22 @@ uint8_t PPU::read(uint16_t address)
     switch (reg)
     {
     case PPU_STATUS:
-        data = (m_status.value & 0xE0) | (m_data_buffer & 0x1F);
-        m_status.vertical_blank = 0;
-        m_nmi = false;
-        m_offset = false;
+        data = (m_state.status.value & 0xE0) | (m_state.data_buffer & 0x1F);
+        m_state.status.vertical_blank = 0;
+        m_state.nmi = false;
+        m_state.offset = false;
         break;
 
     case PPU_OAM_DATA:
-        data = m_oam[m_oam_address];
+        data = m_state.oam[m_state.oam_address];
         break;
 
     case PPU_DATA:
-        data = m_data_buffer;
-        m_data_buffer = video_bus_read(m_vram_address.value);
-        if (m_vram_address.value > 0x3EFF)
-            data = m_data_buffer;
-        m_vram_address.value += (m_control.address_increment ? 32 : 1);
+        data = m_state.data_buffer;
+        m_state.data_buffer = video_bus_read(m_state.vram_address.value);
+        if (m_state.vram_address.value > 0x3EFF)
+            data = m_state.data_buffer;
+        m_state.vram_address.value += (m_state.control.address_increment ? 32 : 1);
         break;
 
     default:
@@ -156,53 +299,54 @@ void PPU::write(uint16_t address, uint8_t data)
     switch(reg)
     {
     case PPU_CONTROL:
-        m_control.value = data;
-        m_tram_address.nametable = m_control.nametable;
+        m_state.control.value = data;
+        m_state.tram_address.nametable = m_state.control.nametable;
         break;
 
     case PPU_MASK:
-        m_mask.value = data;
+        m_state.mask.value = data;
+        update_colors();
         break;
 
     case PPU_OAM_ADDRESS:
-        m_oam_address = data;
+        m_state.oam_address = data;
         break;
 
      case PPU_OAM_DATA:
-        m_oam[m_oam_address++] = data;
+        m_state.oam[m_state.oam_address++] = data;
         break;
 
     case PPU_SCROLL:
-        if (!m_offset)
+        if (!m_state.offset)
         {
-            m_tram_address.coarse_x = (data >> 3) & 0x1F;
-            m_fine_x = data & 0x7;
+            m_state.tram_address.coarse_x = (data >> 3) & 0x1F;
+            m_state.fine_x = data & 0x7;
         }
         else
         {
-            m_tram_address.coarse_y = (data >> 3) & 0x1F;;
-            m_tram_address.fine_y = data & 0x7;
+            m_state.tram_address.coarse_y = (data >> 3) & 0x1F;;
+            m_state.tram_address.fine_y = data & 0x7;
         }
-        m_offset = !m_offset;
+        m_state.offset = !m_state.offset;
         break;
 
     case PPU_ADDRESS:
-        if (!m_offset)
+        if (!m_state.offset)
         {
-            m_tram_address.value = (m_tram_address.value & 0x00FF) |
+            m_state.tram_address.value = (m_state.tram_address.value & 0x00FF) |
                                    ((uint16_t)(data & 0x3F) << 8);
         }
         else
         {
-            m_tram_address.value = (m_tram_address.value & 0xFF00) | data;
-            m_vram_address = m_tram_address;
+            m_state.tram_address.value = (m_state.tram_address.value & 0xFF00) | data;
+            m_state.vram_address = m_state.tram_address;
         }
-        m_offset = !m_offset;
+        m_state.offset = !m_state.offset;
         break;
 
     case PPU_DATA:
-        video_bus_write(m_vram_address.value, data);
-        m_vram_address.value += (m_control.address_increment ? 32 : 1);
+        video_bus_write(m_state.vram_address.value, data);
+        m_state.vram_address.value += (m_state.control.address_increment ? 32 : 1);
         break;
 
     default:
@@ -212,8 +356,33 @@ void PPU::write(uint16_t address, uint8_t data)
 
 void PPU::set_palette(const uint32_t* palette)
 {
-    for (int i = 0; i < 64; i++)
-        m_palette[i] = palette[i];
+    // Each emphasis bit darkens the other two colour channels
+    for (int emphasis = 0; emphasis < 8; emphasis++)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t color = palette[i];
+            if (emphasis != 0 && (i & 0x0F) < 0x0E)
+            {
+                uint32_t red = (color >> 16) & 0xFF;
+                uint32_t green = (color >> 8) & 0xFF;
+                uint32_t blue = color & 0xFF;
+
+                if (!(emphasis & 1))
+                    red = red * 3 / 4;
+                if (!(emphasis & 2))
+                    green = green * 3 / 4;
+                if (!(emphasis & 4))
+                    blue = blue * 3 / 4;
+
+                color = (color & 0xFF000000) | (red << 16) | (green << 8) | blue;
+            }
+
+            m_palette[emphasis * 64 + i] = color;
+        }
+    }
+
+    update_colors();
 }
 
 uint16_t PPU::nametable_mirror(uint16_t address)
@@ -235,13 +404,13 @@ uint8_t PPU::video_bus_read(uint16_t address)
     if (address < 0x2000)
         data = m_cartridge.ppu_read(address);
     else if (address < 0x3F00)
-        data = m_video_ram[nametable_mirror(address)];
+        data = m_state.video_ram[nametable_mirror(address)];
     else
     {
         uint16_t palette_address = (address - 0x3F00) & 0x1F;
         if (palette_address % 4 == 0)
             palette_address = 0;
-        data = m_palette_ram[palette_address];
+        data = m_state.palette_ram[palette_address];
     }
 
     return data;
@@ -252,160 +421,221 @@ void PPU::video_bus_write(uint16_t address, uint8_t data)
     if (address < 0x2000)
         m_cartridge.ppu_write(address, data);
     else if (address < 0x3F00)
-        m_video_ram[nametable_mirror(address)] = data;
+        m_state.video_ram[nametable_mirror(address)] = data;
     else
     {
         uint16_t palette_address = (address - 0x3F00) & 0x1F;
         if (palette_address > 0x0F && palette_address % 4 == 0)
             palette_address -= 0x10;
-        m_palette_ram[palette_address] = data;
+        m_state.palette_ram[palette_address] = data;
+        update_colors();
     }
 }
 
-inline uint32_t PPU::read_color_from_palette(uint8_t pixel, uint8_t palette)
+void PPU::update_colors()
+{
+    m_colors_stale = m_frame_skipped;
+    if (m_colors_stale)
+        return;
+
+    const uint8_t mask = m_state.mask.greyscale ? 0x30 : 0x3F;
+    const uint16_t emphasis = (m_state.mask.value >> 5) * 64;
+
+    for (uint16_t address = 0; address < 32; address++)
+    {
+        uint16_t mirror = address;
+        if (mirror > 0x0F && mirror % 4 == 0)
+            mirror -= 0x10;
+
+        m_color_indices[address] = emphasis + (m_state.palette_ram[mirror] & mask);
+        m_colors[address] = m_palette[m_color_indices[address]];
+    }
+}
+
+void PPU::set_indexed_output(bool enabled)
+{
+    if (enabled && !m_indexed_output)
+    {
+        // Indices for the pixels already drawn are lost, start from the
+        // background colour
+        std::fill_n(m_index_buffer, ScreenWidth * ScreenHeight, m_color_indices[0]);
+    }
+
+    m_indexed_output = enabled;
+}
+
+void PPU::load_state(const State& state)
+{
+    m_state = state;
+    m_frame_skipped = false;
+    update_colors();
+}
+
+bool PPU::valid(const State& state)
 {
-    uint16_t address = palette * 4 + pixel;
-    if (address > 0x0F && address % 4 == 0)
-        address -= 0x10;
+    return state.sprite_count <= 8 && state.scanline <= 261 && state.cycle <= 340;
+}
 
-    return m_palette[m_palette_ram[address]];
+uint32_t* PPU::frame_buffer()
+{
+    if (m_indexed_output)
+        m_composer.convert(m_index_buffer, m_palette, m_frame_buffer, ScreenWidth * ScreenHeight);
+
+    return m_frame_buffer;
 }
 
 inline bool PPU::is_rendering()
 {
-    return (m_mask.render_background || m_mask.render_sprites);
+    return (m_state.mask.render_background || m_state.mask.render_sprites);
 }
 
 inline void PPU::address_transfer_x()
 {
-    m_vram_address.coarse_x = m_tram_address.coarse_x;
-    m_vram_address.nametable = (m_vram_address.nametable & 2) |
-                               (m_tram_address.nametable & 1);
+    m_state.vram_address.coarse_x = m_state.tram_address.coarse_x;
+    m_state.vram_address.nametable = (m_state.vram_address.nametable & 2) |
+                               (m_state.tram_address.nametable & 1);
 }
 
 inline void PPU::address_transfer_y()
 {
-    m_vram_address.coarse_y = m_tram_address.coarse_y;
-    m_vram_address.fine_y = m_tram_address.fine_y;
-    m_vram_address.nametable = (m_vram_address.nametable & 1) |
-                               (m_tram_address.nametable & 2);
+    m_state.vram_address.coarse_y = m_state.tram_address.coarse_y;
+    m_state.vram_address.fine_y = m_state.tram_address.fine_y;
+    m_state.vram_address.nametable = (m_state.vram_address.nametable & 1) |
+                               (m_state.tram_address.nametable & 2);
 }
 
 inline void PPU::scroll_horizontal()
 {
-    m_vram_address.coarse_x++;
-    if (m_vram_address.coarse_x == 0)
-        m_vram_address.nametable ^= 1;
+    m_state.vram_address.coarse_x++;
+    if (m_state.vram_address.coarse_x == 0)
+        m_state.vram_address.nametable ^= 1;
 }
 
 inline void PPU::scroll_vertical()
 {
-    m_vram_address.fine_y++;
-    if (m_vram_address.fine_y == 0)
+    m_state.vram_address.fine_y++;
+    if (m_state.vram_address.fine_y == 0)
     {
-        m_vram_address.coarse_y++;
-        if (m_vram_address.coarse_y == 30)
+        m_state.vram_address.coarse_y++;
+        if (m_state.vram_address.coarse_y == 30)
         {
-            m_vram_address.coarse_y = 0;
-            m_vram_address.nametable ^= 2;
+            m_state.vram_address.coarse_y = 0;
+            m_state.vram_address.nametable ^= 2;
         }
     }
 }
 
+inline void PPU::fetch_nametable()
+{
+    m_state.bg_tile.nametable = video_bus_read(0x2000 | (m_state.vram_address.value & 0x0FFF));
+}
+
+inline void PPU::fetch_attribute()
+{
+    m_state.bg_tile.attribute = video_bus_read(0x23C0 |
+                                         (m_state.vram_address.value & 0x0C00) |
+                                         ((m_state.vram_address.value >> 4) & 0x38) |
+                                         ((m_state.vram_address.value >> 2) & 0x7));
+    if (m_state.vram_address.coarse_y & 2)
+        m_state.bg_tile.attribute >>= 4;
+    if (m_state.vram_address.coarse_x & 2)
+        m_state.bg_tile.attribute >>= 2;
+    m_state.bg_tile.attribute &= 3;
+}
+
+inline void PPU::fetch_pattern_low()
+{
+    m_state.bg_tile.byte_low = video_bus_read(((uint16_t)m_state.control.background_table << 12) |
+                                        (((uint16_t)m_state.bg_tile.nametable) << 4) |
+                                        m_state.vram_address.fine_y);
+}
+
+inline void PPU::fetch_pattern_high()
+{
+    m_state.bg_tile.byte_high = video_bus_read(((uint16_t)m_state.control.background_table << 12) |
+                                         (((uint16_t)m_state.bg_tile.nametable) << 4) |
+                                         m_state.vram_address.fine_y |
+                                         0x8);
+}
+
 inline void PPU::load_background_shifter()
 {
-    m_bg_shifter.pattern_low = (m_bg_shifter.pattern_low & 0xFF00) | m_bg_tile.byte_low;
-    m_bg_shifter.pattern_high = (m_bg_shifter.pattern_high & 0xFF00) | m_bg_tile.byte_high;
+    m_state.bg_shifter.pattern_low = (m_state.bg_shifter.pattern_low & 0xFF00) | m_state.bg_tile.byte_low;
+    m_state.bg_shifter.pattern_high = (m_state.bg_shifter.pattern_high & 0xFF00) | m_state.bg_tile.byte_high;
 
-    m_bg_shifter.attribute_low = (m_bg_shifter.attribute_low & 0xFF00) |
-                                 ((m_bg_tile.attribute & 1) ? 0xFF : 0);
-    m_bg_shifter.attribute_high = (m_bg_shifter.attribute_high & 0xFF00) |
-                                  ((m_bg_tile.attribute & 2) ? 0xFF : 0);
+    m_state.bg_shifter.attribute_low = (m_state.bg_shifter.attribute_low & 0xFF00) |
+                                 ((m_state.bg_tile.attribute & 1) ? 0xFF : 0);
+    m_state.bg_shifter.attribute_high = (m_state.bg_shifter.attribute_high & 0xFF00) |
+                                  ((m_state.bg_tile.attribute & 2) ? 0xFF : 0);
 }
 
 inline void PPU::update_background_shifter()
 {
-    m_bg_shifter.pattern_low <<= 1;
-    m_bg_shifter.pattern_high <<= 1;
-    m_bg_shifter.attribute_low <<= 1;
-    m_bg_shifter.attribute_high <<= 1;
+    m_state.bg_shifter.pattern_low <<= 1;
+    m_state.bg_shifter.pattern_high <<= 1;
+    m_state.bg_shifter.attribute_low <<= 1;
+    m_state.bg_shifter.attribute_high <<= 1;
 }
 
 inline void PPU::update_sprite_shifter()
 {
     Sprite* sprite = nullptr;
-    for (int i = 0; i < m_sprite_count; i++)
+    for (int i = 0; i < m_state.sprite_count; i++)
     {
-        sprite = m_oam_scanline + i;
+        sprite = m_state.oam_scanline + i;
         if (sprite->x > 0)
         {
             sprite->x--;
         }
         else
         {
-            m_sprite_shifter.pattern_low[i] <<= 1;
-            m_sprite_shifter.pattern_high[i] <<= 1;
+            m_state.sprite_shifter.pattern_low[i] <<= 1;
+            m_state.sprite_shifter.pattern_high[i] <<= 1;
         }
     }
 }
 
-uint8_t PPU::reverse_byte(uint8_t byte)
-{
-    uint8_t value = 0;
-
-    value |= (byte & 0x80) >> 7;
-    value |= (byte & 0x40) >> 5;
-    value |= (byte & 0x20) >> 3;
-    value |= (byte & 0x10) >> 1;
-    value |= (byte & 0x08) << 1;
-    value |= (byte & 0x04) << 3;
-    value |= (byte & 0x02) << 5;
-    value |= (byte & 0x01) << 7;
-
-    return value;
-}
-
 inline void PPU::clear_sprite_shifter()
 {
-    memset(m_sprite_shifter.pattern_low, 0, 8 * sizeof(m_sprite_shifter.pattern_low[0]));
-    memset(m_sprite_shifter.pattern_high, 0, 8 * sizeof(m_sprite_shifter.pattern_high[0]));
+    memset(m_state.sprite_shifter.pattern_low, 0, 8 * sizeof(m_state.sprite_shifter.pattern_low[0]));
+    memset(m_state.sprite_shifter.pattern_high, 0, 8 * sizeof(m_state.sprite_shifter.pattern_high[0]));
 }
 
 void PPU::update_sprites()
 {
-    if (m_scanline == 261)
+    if (m_state.scanline == 261)
         return;
 
-    memset(m_oam_scanline, 0xFF, 8 * sizeof(Sprite));
-    m_sprite_count = 0;
+    memset(m_state.oam_scanline, 0xFF, 8 * sizeof(Sprite));
+    m_state.sprite_count = 0;
 
-    m_status.sprite_overflow = 0;
-    m_sprite_zero_hit_possible = false;
+    m_state.status.sprite_overflow = 0;
+    m_state.sprite_zero_hit_possible = false;
 
     Sprite* sprite = nullptr;
     int sprite_row = 0;
-    int sprite_height = m_control.sprite_size ? 16 : 8;
+    int sprite_height = m_state.control.sprite_size ? 16 : 8;
 
     for (int i = 0; i < 256; i += 4)
     {
-        sprite = (Sprite*)(m_oam + i);
-        sprite_row = m_scanline - sprite->y;
+        sprite = (Sprite*)(m_state.oam + i);
+        sprite_row = m_state.scanline - sprite->y;
 
-        if (m_sprite_count < 9 && sprite_row >= 0 && sprite_row < sprite_height)
+        if (m_state.sprite_count < 9 && sprite_row >= 0 && sprite_row < sprite_height)
         {
-            if (m_sprite_count == 8)
+            if (m_state.sprite_count == 8)
             {
-                m_status.sprite_overflow = 1;
+                m_state.status.sprite_overflow = 1;
                 break;
             }
 
             if (i == 0)
-                m_sprite_zero_hit_possible = true;
+                m_state.sprite_zero_hit_possible = true;
 
             if (sprite->attribute & SPRITE_ATTR_FLIP_VERTICAL)
                 sprite_row = sprite_height - 1 - sprite_row;
 
-            uint8_t pattern_table = m_control.sprite_table;
+            uint8_t pattern_table = m_state.control.sprite_table;
             uint8_t tile_index = sprite->id;
 
             if (sprite_height == 16)
@@ -421,80 +651,73 @@ void PPU::update_sprites()
                                       (tile_index * 16) |
                                       sprite_row;
 
-            uint8_t sprite_data_low = video_bus_read(sprite_address);
-            uint8_t sprite_data_high = video_bus_read(sprite_address + 8);
+            uint8_t sprite_data_low = 0;
+            uint8_t sprite_data_high = 0;
 
             if (sprite->attribute & SPRITE_ATTR_FLIP_HORIZONTAL)
             {
-                sprite_data_low = reverse_byte(sprite_data_low);
-                sprite_data_high = reverse_byte(sprite_data_high);
+                const uint8_t* pattern = m_cartridge.chr_tile(sprite_address) + Mapper::ChrTileFlippedPattern;
+                sprite_data_low = pattern[sprite_row];
+                sprite_data_high = pattern[sprite_row + 8];
+            }
+            else
+            {
+                sprite_data_low = video_bus_read(sprite_address);
+                sprite_data_high = video_bus_read(sprite_address + 8);
             }
 
-            m_sprite_shifter.pattern_low[m_sprite_count] = sprite_data_low;
-            m_sprite_shifter.pattern_high[m_sprite_count] = sprite_data_high;
+            m_state.sprite_shifter.pattern_low[m_state.sprite_count] = sprite_data_low;
+            m_state.sprite_shifter.pattern_high[m_state.sprite_count] = sprite_data_high;
 
-            memcpy(m_oam_scanline + m_sprite_count,
-                   m_oam + i,
-                   sizeof(m_oam_scanline[0]));
+            memcpy(m_state.oam_scanline + m_state.sprite_count,
+                   m_state.oam + i,
+                   sizeof(m_state.oam_scanline[0]));
 
-            m_sprite_count++;
+            m_state.sprite_count++;
         }
     }
 }
 
 void PPU::sprite_zero_hit(uint8_t spr_pixel, uint8_t bg_pixel)
 {
-    if (m_sprite_zero_hit_possible && spr_pixel > 0 && bg_pixel > 0 &&
-        (m_cycle > 7 || (m_mask.background_left && m_mask.sprites_left)) &&
-        m_cycle > 1 && m_cycle != 255)
+    if (m_state.sprite_zero_hit_possible && spr_pixel > 0 && bg_pixel > 0 &&
+        (m_state.cycle > 7 || (m_state.mask.background_left && m_state.mask.sprites_left)) &&
+        m_state.cycle > 1 && m_state.cycle != 255)
     {
-        m_status.sprite_zero_hit = 1;
+        m_state.status.sprite_zero_hit = 1;
     }
 }
 
 void PPU::render_cycle()
 {
-    if ((m_cycle > 1 && m_cycle < 258) || (m_cycle > 321 && m_cycle < 338))
+    if ((m_state.cycle > 1 && m_state.cycle < 258) || (m_state.cycle > 321 && m_state.cycle < 338))
     {
-        if (m_mask.render_background)
+        if (m_state.mask.render_background)
             update_background_shifter();
     }
 
-    if (m_cycle > 0 && (m_cycle < 256 || m_cycle > 320) && m_cycle < 337)
+    if (m_state.cycle > 0 && (m_state.cycle < 256 || m_state.cycle > 320) && m_state.cycle < 337)
     {
-        if (m_mask.render_sprites && m_cycle < 256)
+        if (m_state.mask.render_sprites && m_state.cycle < 256)
             update_sprite_shifter();
 
-        switch ((m_cycle - 1) % 8)
+        switch ((m_state.cycle - 1) % 8)
         {
         case 0:
             load_background_shifter();
-            m_bg_tile.nametable = video_bus_read(0x2000 | (m_vram_address.value & 0x0FFF));
+            fetch_nametable();
             break;
 
         case 2:
-            m_bg_tile.attribute = video_bus_read(0x23C0 |
-                                                 (m_vram_address.value & 0x0C00) |
-                                                 ((m_vram_address.value >> 4) & 0x38) |
-                                                 ((m_vram_address.value >> 2) & 0x7));
-            if (m_vram_address.coarse_y & 2)
-                m_bg_tile.attribute >>= 4;
-            if (m_vram_address.coarse_x & 2)
-                m_bg_tile.attribute >>= 2;
-            m_bg_tile.attribute &= 3;
+            fetch_attribute();
             break;
 
         case 4:
-            m_bg_tile.byte_low = video_bus_read(((uint16_t)m_control.background_table << 12) |
-                                                (((uint16_t)m_bg_tile.nametable) << 4) |
-                                                m_vram_address.fine_y);
+            fetch_pattern_low();
             break;
 
         case 6:
-            m_bg_tile.byte_high = video_bus_read(((uint16_t)m_control.background_table << 12) |
-                                                 (((uint16_t)m_bg_tile.nametable) << 4) |
-                                                 m_vram_address.fine_y |
-                                                 0x8);
+            fetch_pattern_high();
             break;
 
         case 7:
@@ -505,18 +728,18 @@ void PPU::render_cycle()
             break;
         }
     }
-    else if (m_cycle == 256)
+    else if (m_state.cycle == 256)
     {
         scroll_vertical();
     }
-    else if (m_cycle == 257)
+    else if (m_state.cycle == 257)
     {
         address_transfer_x();
         update_sprites();
     }
-    else if (m_cycle == 337 || m_cycle == 339)
+    else if (m_state.cycle == 337 || m_state.cycle == 339)
     {
-        m_bg_tile.nametable = video_bus_read(0x2000 | (m_vram_address.value & 0x0FFF));
+        fetch_nametable();
     }
 }
 
@@ -530,31 +753,31 @@ void PPU::render_pixel()
     uint8_t spr_palette = 0;
     uint8_t spr_priority = 0;
 
-    if (m_mask.render_background)
+    if (m_state.mask.render_background)
     {
-        uint8_t bit = 15 - m_fine_x;
-        bg_pixel = ((m_bg_shifter.pattern_low >> bit) & 1) |
-                   (((m_bg_shifter.pattern_high >> bit) & 1) << 1);
-        bg_palette = ((m_bg_shifter.attribute_low >> bit) & 1) |
-                     (((m_bg_shifter.attribute_high >> bit) & 1) << 1);
+        uint8_t bit = 15 - m_state.fine_x;
+        bg_pixel = ((m_state.bg_shifter.pattern_low >> bit) & 1) |
+                   (((m_state.bg_shifter.pattern_high >> bit) & 1) << 1);
+        bg_palette = ((m_state.bg_shifter.attribute_low >> bit) & 1) |
+                     (((m_state.bg_shifter.attribute_high >> bit) & 1) << 1);
     }
 
-    if (m_cycle < 8 && !m_mask.background_left)
+    if (m_state.cycle < 8 && !m_state.mask.background_left)
     {
         bg_pixel = 0;
         bg_palette = 0;
     }
 
-    if (m_mask.render_sprites)
+    if (m_state.mask.render_sprites)
     {
         Sprite* sprite = nullptr;
-        for (int i = 0; i < m_sprite_count; i++)
+        for (int i = 0; i < m_state.sprite_count; i++)
         {
-            sprite = m_oam_scanline + i;
+            sprite = m_state.oam_scanline + i;
             if (sprite->x == 0)
             {
-                uint8_t low = (m_sprite_shifter.pattern_low[i] >> 7) & 1;
-                uint8_t high = (m_sprite_shifter.pattern_high[i] >> 7) & 1;
+                uint8_t low = (m_state.sprite_shifter.pattern_low[i] >> 7) & 1;
+                uint8_t high = (m_state.sprite_shifter.pattern_high[i] >> 7) & 1;
                 spr_pixel = (high << 1) | low;
                 spr_palette = (sprite->attribute & 0x3) + 4;
                 spr_priority = (sprite->attribute >> 5) & 1;
@@ -568,7 +791,12 @@ void PPU::render_pixel()
         }
     }
 
-    if (m_cycle < 8 && !m_mask.sprites_left)
+    // A skipped frame only needs the sprite 0 hit, and the first pixel which
+    // the next frame keeps if it is odd
+    if (m_frame_skipped && (m_state.scanline != 0 || m_state.cycle != 0))
+        return;
+
+    if (m_state.cycle < 8 && !m_state.mask.sprites_left)
     {
         spr_pixel = 0;
         spr_palette = 0;
@@ -590,12 +818,175 @@ void PPU::render_pixel()
         palette = bg_palette;
     }
 
-    uint32_t color = read_color_from_palette(pixel, palette);
-    m_frame_buffer[m_scanline * ScreenWidth + m_cycle] = color;
+    if (m_indexed_output)
+        m_index_buffer[m_state.scanline * ScreenWidth + m_state.cycle] = m_color_indices[palette * 4 + pixel];
+    else
+        m_frame_buffer[m_state.scanline * ScreenWidth + m_state.cycle] = m_colors[palette * 4 + pixel];
+}
+
+void PPU::render_scanline()
+{
+    // Cycles m_state.cycle to 255 of a visible scanline: the background tiles are
+    // fetched and loaded every 8 cycles and the shifters move once per cycle
+    // from cycle 2, a sprite starts when its X counter reaches 0. Leaves the
+    // same state as render_cycle() and render_pixel().
+    const uint16_t start = m_state.cycle;
+    uint8_t bg_pixels[ScreenWidth] = {};    // Pixel | palette << 2
+    uint8_t spr_pixels[ScreenWidth] = {};   // Pixel | palette << 2 | priority << 5
+
+    // A skipped frame only needs the pixels under sprite 0 until it hits,
+    // and the first pixel which the next frame keeps if it is odd
+    const bool first_pixel = (m_state.scanline == 0 && start == 0);
+    const bool sprite_zero = m_state.sprite_zero_hit_possible && !m_state.status.sprite_zero_hit &&
+                             m_state.mask.render_background && m_state.mask.render_sprites;
+    const bool draw = !m_frame_skipped || sprite_zero || first_pixel;
+
+    if (is_rendering())
+    {
+        // Pixel | palette << 2 in the order they go through the shifters:
+        // the 8 left in them, then the tile loaded on cycle 1 and those
+        // fetched during the scanline, read from the decoded tiles
+        uint8_t stream[8 * 33];
+        for (int i = 0; i < 8; i++)
+        {
+            const uint8_t bit = 15 - i;
+            stream[i] = ((m_state.bg_shifter.pattern_low >> bit) & 1) |
+                        (((m_state.bg_shifter.pattern_high >> bit) & 1) << 1) |
+                        (((m_state.bg_shifter.attribute_low >> bit) & 1) << 2) |
+                        (((m_state.bg_shifter.attribute_high >> bit) & 1) << 3);
+        }
+
+        for (int i = 0; i < 8; i++)
+        {
+            stream[8 + i] = ((m_state.bg_tile.byte_low >> (7 - i)) & 1) |
+                            (((m_state.bg_tile.byte_high >> (7 - i)) & 1) << 1) |
+                            (m_state.bg_tile.attribute << 2);
+        }
+
+        const uint16_t pattern_table = (uint16_t)m_state.control.background_table << 12;
+        BackgroundTile loaded[2];
+
+        // Tile 31 is loaded on cycle 249, the next one is fetched by cycle
+        // 255 and stays in m_state.bg_tile
+        for (int tile = 1; tile <= 32; tile++)
+        {
+            fetch_nametable();
+            fetch_attribute();
+
+            if (draw && tile < 32)
+            {
+                const uint8_t* pixels = m_cartridge.chr_tile(pattern_table | ((uint16_t)m_state.bg_tile.nametable << 4)) +
+                                        Mapper::ChrTilePixels + m_state.vram_address.fine_y * 8;
+                for (int i = 0; i < 8; i++)
+                    stream[8 + tile * 8 + i] = pixels[i] | (m_state.bg_tile.attribute << 2);
+            }
+
+            // The shifters end up with the pattern bytes of the last tiles
+            if (tile >= 30)
+            {
+                fetch_pattern_low();
+                fetch_pattern_high();
+                if (tile < 32)
+                    loaded[tile - 30] = m_state.bg_tile;
+            }
+
+            // Cycle 256 increments the vertical position instead
+            if (tile < 32)
+                scroll_horizontal();
+        }
+
+        if (m_state.mask.render_background)
+        {
+            if (draw)
+            {
+                for (int x = start; x < ScreenWidth; x++)
+                    bg_pixels[x] = stream[std::max(x - 1, 0) + m_state.fine_x];
+            }
+
+            // Loaded on cycles 241 and 249, shifted until cycle 255
+            m_state.bg_shifter.pattern_low = ((loaded[0].byte_low << 8) | loaded[1].byte_low) << 6;
+            m_state.bg_shifter.pattern_high = ((loaded[0].byte_high << 8) | loaded[1].byte_high) << 6;
+            m_state.bg_shifter.attribute_low = (((loaded[0].attribute & 1) ? 0xFF00 : 0) |
+                                          ((loaded[1].attribute & 1) ? 0xFF : 0)) << 6;
+            m_state.bg_shifter.attribute_high = (((loaded[0].attribute & 2) ? 0xFF00 : 0) |
+                                           ((loaded[1].attribute & 2) ? 0xFF : 0)) << 6;
+        }
+        else
+        {
+            // Loaded without shifting
+            BackgroundTile fetched = m_state.bg_tile;
+            m_state.bg_tile = loaded[1];
+            load_background_shifter();
+            m_state.bg_tile = fetched;
+        }
+    }
+
+    if (m_state.mask.render_sprites)
+    {
+        // Lowest index first, sprite 0 hits on its opaque pixels over an
+        // opaque background
+        const int first = (m_frame_skipped && !first_pixel) ? (sprite_zero ? 0 : -1) : m_state.sprite_count - 1;
+        for (int i = first; i >= 0; i--)
+        {
+            const Sprite& sprite = m_state.oam_scanline[i];
+            const uint8_t attribute = ((sprite.attribute & 0x3) + 4) << 2 |
+                                      ((sprite.attribute >> 5) & 1) << 5;
+
+            for (int x = std::max<int>(sprite.x, start); x < std::min<int>(sprite.x + 8, ScreenWidth); x++)
+            {
+                const uint8_t bit = 7 - (x - sprite.x);
+                const uint8_t pixel = ((m_state.sprite_shifter.pattern_low[i] >> bit) & 1) |
+                                      (((m_state.sprite_shifter.pattern_high[i] >> bit) & 1) << 1);
+                if (pixel == 0)
+                    continue;
+
+                spr_pixels[x] = pixel | attribute;
+
+                const bool bg_opaque = (bg_pixels[x] & 3) != 0 && (x >= 8 || m_state.mask.background_left);
+                if (i == 0 && bg_opaque)
+                {
+                    m_state.cycle = x;
+                    sprite_zero_hit(pixel, bg_pixels[x] & 3);
+                }
+            }
+        }
+
+        for (int i = 0; i < m_state.sprite_count; i++)
+        {
+            const int shifts = 255 - m_state.oam_scanline[i].x;
+            m_state.sprite_shifter.pattern_low[i] = (shifts < 8) ? m_state.sprite_shifter.pattern_low[i] << shifts : 0;
+            m_state.sprite_shifter.pattern_high[i] = (shifts < 8) ? m_state.sprite_shifter.pattern_high[i] << shifts : 0;
+            m_state.oam_scanline[i].x = 0;
+        }
+    }
+
+    if (m_frame_skipped && !first_pixel)
+    {
+        m_state.cycle = ScreenWidth;
+        return;
+    }
+
+    // The sprite 0 hit sees the left pixels before they are masked
+    for (int x = start; x < 8; x++)
+    {
+        if (!m_state.mask.background_left)
+            bg_pixels[x] = 0;
+        if (!m_state.mask.sprites_left)
+            spr_pixels[x] = 0;
+    }
+
+    const int count = m_frame_skipped ? 1 : ScreenWidth - start;
+    if (m_indexed_output)
+        m_composer.compose_indices(bg_pixels + start, spr_pixels + start, m_color_indices,
+                                   m_index_buffer + m_state.scanline * ScreenWidth + start, count);
+    else
+        m_composer.compose(bg_pixels + start, spr_pixels + start, m_colors,
+                           m_frame_buffer + m_state.scanline * ScreenWidth + start, count);
+
+    m_state.cycle = ScreenWidth;
 }
 
 void PPU::load_default_palette()
 {
-    for (int i = 0; i < 64; i++)
-        m_palette[i] = m_default_palette[i];
+    set_palette(m_default_palette);
 }
\ No newline at end of file
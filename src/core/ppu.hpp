@@ -1,5 +1,6 @@
 #pragma once
 
+#include "pixel_composer.hpp"
 #include <cstdint>
 #include <array>
 
@@ -23,30 +24,66 @@ public:
     static constexpr uint16_t ScreenWidth = 256;
     static constexpr uint16_t ScreenHeight = 240;
     static constexpr uint16_t ScreenScale = 2;
+    static constexpr uint32_t NoEvent = UINT32_MAX;
+
+    // Defined with the private types it is made of
+    struct State;
 
 public:
     PPU(Cartridge& cartridge);
 
     void reset();
     void tick();
+    // The PPU runs behind the CPU and catches up, 3 dots per CPU cycle, when
+    // its state is needed. Stops at the end of the frame.
+    void run_until(uint64_t cpu_cycle);
+    uint64_t cpu_cycles() const { return m_state.cpu_cycles; }
 
     uint8_t read(uint16_t address);
     void write(uint16_t address, uint8_t data);
 
     void set_palette(const uint32_t* palette);
+    // Draws the visible scanlines that no CPU access interrupts in one pass
+    // instead of dot by dot, the output is the same
+    void set_scanline_renderer_enabled(bool enabled) { m_scanline_renderer_enabled = enabled; }
+    PixelComposer& composer() { return m_composer; }
+
+    uint16_t cycle() const { return m_state.cycle; }
+    uint16_t scanline() const { return m_state.scanline; }
+    // A skipped frame runs with the same timing, sprite 0 hits included, but
+    // leaves the frame buffer as it is
+    void frame_start(bool render = true);
+    bool frame_rendered() const { return m_state.frame_rendered; }
+    // With indexed output the PPU writes 9-bit palette indices (emphasis << 6
+    // | colour) and frame_buffer() converts them to colours when asked for
+    void set_indexed_output(bool enabled);
+    bool indexed_output() const { return m_indexed_output; }
+    const uint16_t* index_buffer() const { return m_index_buffer; }
+    uint32_t* frame_buffer();
+    bool nmi() const { return (m_state.control.nmi_enabled && m_state.nmi); }
+    void nmi_clear() { m_state.nmi = false; }
+
+    // Dots until the tick which raises the NMI, ends the frame or clocks the
+    // mapper scanline counter for the count-th time, counting that tick.
+    // NoEvent if it does not happen in this frame.
+    uint32_t dots_until_nmi();
+    uint32_t dots_until_frame_end();
+    uint32_t dots_until_scanline_counter(uint32_t count);
+    // Same for the flags read from $2002, as long as the CPU does not write
+    // to the PPU
+    uint32_t dots_until_status_change();
 
-    uint16_t cycle() const { return m_cycle; }
-    uint16_t scanline() const { return m_scanline; }
-    void frame_start() { m_frame_rendered = false; }
-    bool frame_rendered() const { return m_frame_rendered; }
-    uint32_t* frame_buffer() { return m_frame_buffer; }
-    bool nmi() const { return (m_control.nmi_enabled && m_nmi); }
-    void nmi_clear() { m_nmi = false; }
+    uint8_t control() const { return m_state.control.value; }
+    uint8_t mask() const { return m_state.mask.value; }
+    uint8_t status() const { return m_state.status.value; }
+    const uint8_t* oam() const { return m_state.oam; }
 
-    uint8_t control() const { return m_control.value; }
-    uint8_t mask() const { return m_mask.value; }
-    uint8_t status() const { return m_status.value; }
-    const uint8_t* oam() const { return m_oam; }
+    const State& state() const { return m_state; }
+    // The colours are resolved again from the loaded state
+    void load_state(const State& state);
+    // False if the position or the sprite count of the state is out of range,
+    // they index the buffers
+    static bool valid(const State& state);
 
 private:
     union Control
@@ -142,55 +179,82 @@ private:
         uint8_t pattern_high[8];
     };
 
+public:
+    // What the PPU changes, part of the machine state. The registers and the
+    // rendering state come first, the memories last.
+    struct State
+    {
+        uint64_t cpu_cycles = 0;
+        uint16_t cycle = 0;
+        uint16_t scanline = 0;
+        Control control;
+        Mask mask;
+        Status status;
+        uint8_t fine_x = 0;
+        Address vram_address;
+        Address tram_address;
+        uint8_t data_buffer = 0;
+        bool offset = false;
+        bool nmi = false;
+        bool frame_rendered = false;
+        bool frame_odd = false;
+        uint8_t oam_address = 0;
+        uint8_t sprite_count = 0;
+        bool sprite_zero_hit_possible = false;
+        BackgroundTile bg_tile;
+        BackgroundShifter bg_shifter;
+        Sprite oam_scanline[8];
+        SpriteShifter sprite_shifter = {};
+        uint8_t palette_ram[32] = {};
+        uint8_t oam[256] = {};
+        std::array<uint8_t, 0x800> video_ram = {};
+    };
+
+private:
+
     static uint32_t m_default_palette[64];
-    uint32_t m_palette[64];
+    // The 64 colours for each combination of the emphasis bits
+    uint32_t m_palette[8 * 64];
+    // Colour of each palette RAM entry with the current mask, updated when
+    // either changes
+    uint32_t m_colors[32];
+    // Palette index of each palette RAM entry, for the indexed output
+    uint16_t m_color_indices[32];
     Cartridge& m_cartridge;
-    Control m_control;
-    Mask m_mask;
-    Status m_status;
-    Address m_vram_address;
-    Address m_tram_address;
-    uint8_t m_palette_ram[32];
-    uint8_t m_fine_x = 0;
-    uint16_t m_cycle = 0;
-    uint16_t m_scanline = 0;
-    uint8_t m_data_buffer = 0;
-    bool m_offset = false;
-    bool m_nmi = false;
-
-    BackgroundTile m_bg_tile;
-    BackgroundShifter m_bg_shifter;
-
-    std::array<uint8_t, 0x800> m_video_ram;
-
-    uint8_t m_oam[256];
-    uint8_t m_oam_address = 0;
-    Sprite m_oam_scanline[8];
-    uint8_t m_sprite_count = 0;
-    bool m_sprite_zero_hit_possible = false;
-    SpriteShifter m_sprite_shifter;
+    State m_state;
 
     uint32_t m_frame_buffer[ScreenWidth * ScreenHeight];
-    bool m_frame_rendered = false;
-    bool m_frame_odd = false;
+    uint16_t m_index_buffer[ScreenWidth * ScreenHeight];
+    bool m_indexed_output = false;
+    bool m_frame_skipped = false;
+    // The colours are resolved again when the next drawn frame starts
+    bool m_colors_stale = false;
+    bool m_scanline_renderer_enabled = true;
+    PixelComposer m_composer;
 
+    uint32_t dots_until(uint16_t scanline, uint16_t cycle) const;
     uint16_t nametable_mirror(uint16_t address);
     uint8_t video_bus_read(uint16_t address);
     void video_bus_write(uint16_t address, uint8_t data);
-    uint32_t read_color_from_palette(uint8_t pixel, uint8_t palette);
+    void update_colors();
     bool is_rendering();
     void address_transfer_x();
     void address_transfer_y();
     void scroll_horizontal();
     void scroll_vertical();
+    void fetch_nametable();
+    void fetch_attribute();
+    void fetch_pattern_low();
+    void fetch_pattern_high();
     void load_background_shifter();
     void update_background_shifter();
     void update_sprite_shifter();
-    uint8_t reverse_byte(uint8_t byte);
     void clear_sprite_shifter();
     void update_sprites();
     void sprite_zero_hit(uint8_t spr_pixel, uint8_t bg_pixel);
     void render_cycle();
     void render_pixel();
+    void render_scanline();
+    void frame_end();
     void load_default_palette();
 };
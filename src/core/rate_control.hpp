@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+
+// Dynamic rate control. When the emulation is paced by a timer or the display
+// instead of the sound card, the samples come slightly too fast or too slow.
+// The sample rate is nudged by at most MaxDeviation, too little to hear, to
+// keep the sound buffer around a target level.
+class RateControl
+{
+public:
+    static constexpr double MaxDeviation = 0.005;
+
+    void set_target(long samples)
+    {
+        m_target = std::max(samples, 1L);
+        m_level = static_cast<double>(m_target);
+        m_integral = 0;
+    }
+
+    long target() const { return m_target; }
+
+    // Buffered samples after the frame was written, returns the sample rate
+    // ratio for the next frame
+    double update(long buffered)
+    {
+        // Smoothed, the sound card takes the samples in bursts
+        m_level += (buffered - m_level) * Smoothing;
+
+        // The integral removes the constant offset a steady rate difference
+        // would leave
+        const double error = std::clamp((m_target - m_level) / m_target, -1.0, 1.0);
+        m_integral = std::clamp(m_integral + error * IntegralGain, -1.0, 1.0);
+
+        return 1.0 + MaxDeviation * std::clamp(error + m_integral, -1.0, 1.0);
+    }
+
+private:
+    static constexpr double Smoothing = 0.05;
+    static constexpr double IntegralGain = 0.002;
+
+    long m_target = 2048;
+    double m_level = 2048;
+    double m_integral = 0;
+};
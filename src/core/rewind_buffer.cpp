@@ -0,0 +1,226 @@
+#include "rewind_buffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+// A run of zeros shorter than this costs more to encode than to copy
+static constexpr size_t MinZeroRun = 4;
+
+static void write_count(std::vector<uint8_t>& output, size_t count)
+{
+    while (count >= 0x80)
+    {
+        output.push_back(static_cast<uint8_t>(count | 0x80));
+        count >>= 7;
+    }
+
+    output.push_back(static_cast<uint8_t>(count));
+}
+
+static bool read_count(const uint8_t*& input, const uint8_t* end, size_t& count)
+{
+    count = 0;
+    for (int shift = 0; input < end && shift < 64; shift += 7)
+    {
+        const uint8_t byte = *input++;
+        count |= static_cast<size_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+// Pairs of a zero run length and a literal length followed by the literal
+// bytes, of data XOR reference for a delta
+template <bool Delta>
+static void encode(const uint8_t* data, const uint8_t* reference, size_t size, std::vector<uint8_t>& output)
+{
+    auto byte = [data, reference](size_t i) -> uint8_t {
+        return Delta ? data[i] ^ reference[i] : data[i];
+    };
+
+    output.clear();
+
+    size_t i = 0;
+    while (i < size)
+    {
+        // Most of a delta is zeros, skipped a word at a time
+        const size_t zero_start = i;
+        while (i + 8 <= size)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            if (Delta)
+            {
+                uint64_t reference_word;
+                std::memcpy(&reference_word, reference + i, 8);
+                word ^= reference_word;
+            }
+
+            if (word != 0)
+                break;
+
+            i += 8;
+        }
+
+        while (i < size && byte(i) == 0)
+            i++;
+
+        const size_t literal_start = i;
+        size_t zeros = 0;
+        while (i < size)
+        {
+            zeros = byte(i) == 0 ? zeros + 1 : 0;
+            i++;
+
+            if (zeros == MinZeroRun)
+            {
+                i -= MinZeroRun;
+                break;
+            }
+        }
+
+        write_count(output, literal_start - zero_start);
+        write_count(output, i - literal_start);
+
+        const size_t offset = output.size();
+        output.resize(offset + i - literal_start);
+        for (size_t j = literal_start; j < i; j++)
+            output[offset + j - literal_start] = byte(j);
+    }
+}
+
+static bool decode(const uint8_t* input, size_t input_size, uint8_t* data, size_t size, bool delta)
+{
+    const uint8_t* end = input + input_size;
+    size_t i = 0;
+
+    while (input < end)
+    {
+        size_t zeros = 0;
+        size_t literals = 0;
+        if (!read_count(input, end, zeros) || !read_count(input, end, literals) ||
+            zeros > size - i || literals > size - i - zeros || literals > static_cast<size_t>(end - input))
+            return false;
+
+        if (!delta)
+            std::memset(data + i, 0, zeros);
+        i += zeros;
+
+        for (size_t j = 0; j < literals; j++)
+            data[i + j] = delta ? data[i + j] ^ input[j] : input[j];
+
+        i += literals;
+        input += literals;
+    }
+
+    return i == size;
+}
+
+void RewindBuffer::init(size_t capacity, uint32_t max_frames, uint32_t keyframe_interval)
+{
+    m_data.assign(capacity, 0);
+    m_entries.assign(max_frames, Entry());
+    m_keyframe_interval = std::max<uint32_t>(keyframe_interval, 1);
+    m_encoded.reserve(capacity > 0 ? 0x10000 : 0);
+    clear();
+}
+
+void RewindBuffer::clear()
+{
+    m_first = 0;
+    m_count = 0;
+    m_write = 0;
+    m_used = 0;
+    m_pushed = 0;
+    m_current.clear();
+}
+
+void RewindBuffer::push(const std::vector<uint8_t>& state)
+{
+    if (!enabled())
+        return;
+
+    // Another game, or the first state, nothing to go back to yet
+    if (m_current.size() != state.size())
+    {
+        clear();
+        m_current = state;
+        return;
+    }
+
+    // The entry of the current state, which state follows
+    const bool keyframe = m_pushed % m_keyframe_interval == 0;
+    if (keyframe)
+        encode<false>(m_current.data(), nullptr, m_current.size(), m_encoded);
+    else
+        encode<true>(m_current.data(), state.data(), m_current.size(), m_encoded);
+
+    const size_t size = m_encoded.size();
+    if (size > m_data.size())
+    {
+        clear();
+        m_current = state;
+        return;
+    }
+
+    if (m_write + size > m_data.size())
+    {
+        // Wraps around, the entries left at the end of the ring are the oldest
+        while (m_count > 0 && m_entries[m_first].offset >= m_write)
+            drop_oldest();
+
+        m_write = 0;
+    }
+
+    while (m_count > 0)
+    {
+        const Entry& oldest = m_entries[m_first];
+        const bool overlaps = oldest.offset < m_write + size && oldest.offset + oldest.size > m_write;
+        if (!overlaps && m_count < m_entries.size())
+            break;
+
+        drop_oldest();
+    }
+
+    Entry& entry = m_entries[(m_first + m_count) % m_entries.size()];
+    entry.offset = static_cast<uint32_t>(m_write);
+    entry.size = static_cast<uint32_t>(size);
+    entry.keyframe = keyframe;
+    std::memcpy(m_data.data() + m_write, m_encoded.data(), size);
+
+    m_write += size;
+    m_used += size;
+    m_count++;
+    m_pushed++;
+
+    std::memcpy(m_current.data(), state.data(), state.size());
+}
+
+bool RewindBuffer::pop(std::vector<uint8_t>& state)
+{
+    if (m_count == 0)
+        return false;
+
+    const Entry& entry = m_entries[(m_first + m_count - 1) % m_entries.size()];
+    if (!decode(m_data.data() + entry.offset, entry.size, m_current.data(), m_current.size(), !entry.keyframe))
+    {
+        clear();
+        return false;
+    }
+
+    m_write = entry.offset;
+    m_used -= entry.size;
+    m_count--;
+    m_pushed--;
+
+    state = m_current;
+    return true;
+}
+
+void RewindBuffer::drop_oldest()
+{
+    m_used -= m_entries[m_first].size;
+    m_first = (m_first + 1) % m_entries.size();
+    m_count--;
+}
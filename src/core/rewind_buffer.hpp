@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The last save states in a fixed size ring, newest first out. Every
+// KeyframeInterval-th state is stored whole, the others as the XOR with the
+// state which followed them, both compressed by runs of zero bytes. Going
+// back a frame XORs the newest delta into the current state. The oldest
+// states are dropped to make room, nothing is allocated once initialized.
+class RewindBuffer
+{
+public:
+    static constexpr uint32_t DefaultKeyframeInterval = 60;
+
+    // capacity: bytes of compressed states, max_frames: states held at most
+    void init(size_t capacity, uint32_t max_frames, uint32_t keyframe_interval = DefaultKeyframeInterval);
+    void clear();
+    bool enabled() const { return !m_data.empty(); }
+
+    // Adds the state of the frame just run
+    void push(const std::vector<uint8_t>& state);
+    // Replaces state with the one pushed before the newest, false if there
+    // is none left
+    bool pop(std::vector<uint8_t>& state);
+
+    // States which can be gone back to
+    uint32_t frame_count() const { return m_count; }
+    // Compressed size of these states
+    size_t used() const { return m_used; }
+
+private:
+    struct Entry
+    {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        bool keyframe = false;
+    };
+
+    std::vector<uint8_t> m_data;
+    std::vector<Entry> m_entries;
+    uint32_t m_first = 0;           // Oldest entry
+    uint32_t m_count = 0;
+    size_t m_write = 0;             // Data offset after the newest entry
+    size_t m_used = 0;
+    uint32_t m_keyframe_interval = DefaultKeyframeInterval;
+    uint64_t m_pushed = 0;
+    // The newest state, the entries go back from it
+    std::vector<uint8_t> m_current;
+    std::vector<uint8_t> m_encoded;
+
+    void drop_oldest();
+};
@@ -0,0 +1,61 @@
+#include "rom_image.hpp"
+#include "mapper.hpp"
+#include <cstring>
+#include <mutex>
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t* data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+RomImage::RomImage(const std::string& file_path):
+    m_rom(file_path)
+{
+    m_checksum = fnv1a(0x811C9DC5, prg(), prg_size());
+    m_checksum = fnv1a(m_checksum, chr(), chr_size());
+}
+
+std::shared_ptr<const RomImage> RomImage::load(const std::string& file_path)
+{
+    // Images stay loaded while a cartridge uses them
+    static std::mutex mutex;
+    static std::vector<std::weak_ptr<const RomImage>> images;
+
+    std::shared_ptr<RomImage> image(new RomImage(file_path));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::erase_if(images, [](const std::weak_ptr<const RomImage>& loaded) { return loaded.expired(); });
+    for (const std::weak_ptr<const RomImage>& loaded : images)
+    {
+        std::shared_ptr<const RomImage> shared = loaded.lock();
+        if (shared && shared->same_rom(*image))
+            return shared;
+    }
+
+    // Decoded once for all the cartridges, the CHR ROM never changes
+    image->m_chr_tiles.resize(image->chr_size() / 16 * Mapper::ChrTileSize);
+    for (uint32_t offset = 0; offset < image->chr_size(); offset += 16)
+        Mapper::decode_chr_tile(image->chr() + offset, image->m_chr_tiles.data() + offset / 16 * Mapper::ChrTileSize);
+
+    images.push_back(image);
+
+    return image;
+}
+
+bool RomImage::same_rom(const RomImage& other) const
+{
+    return m_checksum == other.m_checksum &&
+           mapper_id() == other.mapper_id() &&
+           mirroring_mode() == other.mirroring_mode() &&
+           program_banks() == other.program_banks() &&
+           prg_size() == other.prg_size() &&
+           chr_size() == other.chr_size() &&
+           std::memcmp(prg(), other.prg(), prg_size()) == 0 &&
+           std::memcmp(chr(), other.chr(), chr_size()) == 0;
+}
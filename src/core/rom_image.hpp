@@ -0,0 +1,40 @@
+#pragma once
+
+#include "nes_rom.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A ROM file loaded once and shared, read only, by every cartridge running
+// it. Holds what is derived from the ROM alone: the checksum and the decoded
+// CHR ROM tiles. The RAMs and the banks selected are in the mapper state.
+class RomImage
+{
+public:
+    // The image already loaded from a file with the same contents if there
+    // is one, throws the NesRom exceptions
+    static std::shared_ptr<const RomImage> load(const std::string& file_path);
+
+    uint16_t mapper_id() const { return m_rom.mapper_id(); }
+    MirroringMode mirroring_mode() const { return m_rom.mirroring_mode(); }
+    uint8_t program_banks() const { return m_rom.program_banks(); }
+    uint32_t prg_size() const { return m_rom.program_rom_size(); }
+    const uint8_t* prg() const { return m_rom.prg_data(); }
+    // 0 with CHR RAM
+    uint32_t chr_size() const { return m_rom.character_rom_size(); }
+    const uint8_t* chr() const { return m_rom.chr_data(); }
+    // Mapper::ChrTileSize bytes per 16 bytes of CHR ROM
+    const uint8_t* chr_tiles() const { return m_chr_tiles.data(); }
+    // FNV-1a of the PRG and CHR ROM, a save state is only loaded by the same game
+    uint32_t checksum() const { return m_checksum; }
+
+private:
+    NesRom m_rom;
+    std::vector<uint8_t> m_chr_tiles;
+    uint32_t m_checksum = 0;
+
+    explicit RomImage(const std::string& file_path);
+
+    bool same_rom(const RomImage& other) const;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// Timestamps in CPU cycles of the next events which can interrupt the CPU or
+// need a component to catch up. The main loop runs the CPU up to the earliest
+// one instead of polling the interrupts after every cycle.
+class Scheduler
+{
+public:
+    enum Event
+    {
+        EVENT_NMI,
+        EVENT_MAPPER_IRQ,
+        EVENT_APU_IRQ,
+        EVENT_DMC_READ,
+        EVENT_FRAME_END,
+        EVENT_COUNT
+    };
+
+    static constexpr uint64_t Never = UINT64_MAX;
+
+public:
+    Scheduler() { reset(); }
+
+    void reset()
+    {
+        m_events.fill(Never);
+        m_next_event = 0;
+        m_invalidated = true;
+    }
+
+    void schedule(Event event, uint64_t cycle)
+    {
+        m_events[event] = cycle;
+        m_invalidated = false;
+        m_next_event = Never;
+        for (uint64_t event_cycle : m_events)
+            m_next_event = std::min(m_next_event, event_cycle);
+    }
+
+    // A register access moved the events, they are scheduled again before
+    // the next instruction
+    void invalidate()
+    {
+        m_next_event = 0;
+        m_invalidated = true;
+    }
+
+    bool invalidated() const { return m_invalidated; }
+
+    bool due(uint64_t cycle) const { return cycle >= m_next_event; }
+    bool due(Event event, uint64_t cycle) const { return cycle >= m_events[event]; }
+    uint64_t next_event() const { return m_next_event; }
+
+private:
+    std::array<uint64_t, EVENT_COUNT> m_events;
+    uint64_t m_next_event = 0;
+    bool m_invalidated = true;
+};
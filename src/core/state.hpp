@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Save states are a header and the parts of the machine state copied as they
+// are in memory. A state is only loaded by the same build, there is no
+// conversion.
+
+// Appends to the state, the buffer keeps its capacity from one state to the
+// next so saving does not allocate once it has grown
+class StateWriter
+{
+public:
+    explicit StateWriter(std::vector<uint8_t>& data):
+        m_data(data)
+    {}
+
+    void write(const void* data, size_t size)
+    {
+        const size_t offset = m_data.size();
+        m_data.resize(offset + size);
+        std::memcpy(m_data.data() + offset, data, size);
+    }
+
+    template <typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write(&value, sizeof(T));
+    }
+
+private:
+    std::vector<uint8_t>& m_data;
+};
+
+// Reads the state back, fails instead of reading past its end
+class StateReader
+{
+public:
+    StateReader(const uint8_t* data, size_t size):
+        m_data(data),
+        m_size(size)
+    {}
+
+    // The next size bytes, nullptr if there are not that many left
+    const uint8_t* read_block(size_t size)
+    {
+        if (size > m_size - m_offset)
+            return nullptr;
+
+        const uint8_t* data = m_data + m_offset;
+        m_offset += size;
+        return data;
+    }
+
+    bool read(void* data, size_t size)
+    {
+        const uint8_t* bytes = read_block(size);
+        if (bytes == nullptr)
+            return false;
+
+        std::memcpy(data, bytes, size);
+        return true;
+    }
+
+    template <typename T>
+    bool read(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return read(&value, sizeof(T));
+    }
+
+    size_t remaining() const { return m_size - m_offset; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_offset = 0;
+};
@@ -4,21 +4,45 @@
 #include "apu.hpp"
 #include "cartridge.hpp"
 #include "controller.hpp"
+#include "scheduler.hpp"
 
-uint8_t SystemBus::read(uint16_t address)
+SystemBus::SystemBus(APU& apu, PPU& ppu, Cartridge& cartridge, Controller& controller, Scheduler& scheduler):
+    m_apu(apu),
+    m_ppu(ppu),
+    m_cartrige(cartridge),
+    m_controller(controller),
+    m_scheduler(scheduler)
 {
-    if (address < 0x2000)
-        return m_ram[address & 0x7FF];
-    else if (address < 0x4000)
+    // Internal RAM is mirrored up to $1FFF
+    for (uint16_t address = 0; address < 0x2000; address += 0x800)
+    {
+        m_memory_map.map_read(address, 0x800, m_state.ram.data());
+        m_memory_map.map_write(address, 0x800, m_state.ram.data());
+    }
+
+    // The mapper maps its PRG RAM and ROM banks
+    m_cartrige.set_memory_map(&m_memory_map);
+}
+
+uint8_t SystemBus::read_io(uint16_t address)
+{
+    if (address < 0x4000)
+    {
+        m_ppu.run_until(m_cpu->cycles());
         return m_ppu.read(address);
+    }
     else if (address < 0x4016) {
-        return m_apu.read();
+        // Reading the status acknowledges the frame IRQ
+        m_scheduler.invalidate();
+        return m_apu.read(m_cpu->cycles());
     }
     else if (address < 0x4020)
     {
         switch (address)
         {
-        case 0x4015: return m_apu.read();
+        case 0x4015:
+            m_scheduler.invalidate();
+            return m_apu.read(m_cpu->cycles());
         case 0x4016: return m_controller.read(0);
         case 0x4017: return m_controller.read(1);
         default:
@@ -27,18 +51,23 @@ uint8_t SystemBus::read(uint16_t address)
     }
     else
     {
+        m_ppu.run_until(m_cpu->cycles());
         return m_cartrige.cpu_read(address);
     }
 
     return 0;
 }
 
-void SystemBus::write(uint16_t address, uint8_t data)
+void SystemBus::write_io(uint16_t address, uint8_t data)
 {
-    if (address < 0x2000)
-        m_ram[address & 0x7FF] = data;
-    else if (address < 0x4000)
+    if (address < 0x4000)
+    {
+        // Control and mask enable the NMI and the mapper scanline counter
+        if ((address & 0x7) <= 1)
+            m_scheduler.invalidate();
+        m_ppu.run_until(m_cpu->cycles());
         m_ppu.write(address, data);
+    }
     else if (address < 0x4020)
     {
         switch (address)
@@ -52,12 +81,16 @@ void SystemBus::write(uint16_t address, uint8_t data)
             break;
 
         default:
-            m_apu.write(address, data);
+            m_scheduler.invalidate();
+            m_apu.write(m_cpu->cycles(), address, data);
             break;
         }
     }
     else
     {
+        // The PPU fetches so far use the old banks and IRQ counter
+        m_scheduler.invalidate();
+        m_ppu.run_until(m_cpu->cycles());
         m_cartrige.cpu_write(address, data);
     }
 }
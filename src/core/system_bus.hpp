@@ -1,5 +1,6 @@
 #pragma once
 
+#include "memory_map.hpp"
 #include <cstdint>
 #include <array>
 
@@ -8,29 +9,55 @@ class APU;
 class PPU;
 class Cartridge;
 class Controller;
+class Scheduler;
 
 class SystemBus
 {
 public:
-    SystemBus(APU& apu, PPU& ppu, Cartridge& cartridge, Controller& controller):
-        m_apu(apu),
-        m_ppu(ppu),
-        m_cartrige(cartridge),
-        m_controller(controller)
-    {}
+    // Internal RAM, part of the machine state
+    struct State
+    {
+        std::array<uint8_t, 0x800> ram = {};
+    };
+
+public:
+    SystemBus(APU& apu, PPU& ppu, Cartridge& cartridge, Controller& controller, Scheduler& scheduler);
 
     void set_cpu(CPU* cpu) { m_cpu = cpu; }
+    const MemoryMap& memory_map() const { return m_memory_map; }
+    const uint8_t* ram() const { return m_state.ram.data(); }
+    const State& state() const { return m_state; }
+    void load_state(const State& state) { m_state = state; }
+
+    uint8_t read(uint16_t address)
+    {
+        const uint8_t* page = m_memory_map.read_page(address);
+        if (page != nullptr)
+            return page[address & MemoryMap::PageMask];
+
+        return read_io(address);
+    }
 
-    uint8_t read(uint16_t address);
-    void write(uint16_t address, uint8_t data);
+    void write(uint16_t address, uint8_t data)
+    {
+        uint8_t* page = m_memory_map.write_page(address);
+        if (page != nullptr)
+            page[address & MemoryMap::PageMask] = data;
+        else
+            write_io(address, data);
+    }
 
 private:
-    std::array<uint8_t, 0x800> m_ram{};
+    State m_state;
+    MemoryMap m_memory_map;
     CPU* m_cpu = nullptr;
     APU& m_apu;
     PPU& m_ppu;
     Cartridge& m_cartrige;
     Controller& m_controller;
+    Scheduler& m_scheduler;
 
+    uint8_t read_io(uint16_t address);
+    void write_io(uint16_t address, uint8_t data);
     void oam_dma(uint8_t data);
 };
@@ -0,0 +1,534 @@
+#include "emulator.hpp"
+#include "memory_input_source.hpp"
+#include "rewind_buffer.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+static constexpr size_t RewindBufferSize = 32 * 1024 * 1024;
+
+static void print_usage(const char* program)
+{
+    std::printf("Usage: %s <rom file> [--frames N] [--input file] [--mode cycle|instruction] [--block-cache] [--jit] [--idle-skip] [--dot-renderer] [--compose scalar|sse2|avx2] [--indexed] [--frame-skip N] [--run-ahead N] [--verify] [--verify-jit] [--verify-state] [--rewind] [--hash]\n", program);
+    std::printf("       %s --bench-compose\n", program);
+}
+
+// FNV-1a, used to compare the output of different execution modes
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+// Samples of the last frame
+static void read_samples(Emulator& nes, std::vector<blip_sample_t>& samples)
+{
+    blip_sample_t buffer[APU::SoundBufferSize];
+
+    samples.clear();
+    while (nes.sound_samples_available() > 0)
+    {
+        const long count = nes.read_sound_samples(buffer, APU::SoundBufferSize);
+        samples.insert(samples.end(), buffer, buffer + count);
+    }
+}
+
+// Time per scanline of each pixel composition kernel and per frame of the
+// index conversion, on random lines which are first checked against the
+// scalar kernel
+static int bench_compose()
+{
+    constexpr int LineCount = 64;
+    constexpr long Iterations = 200000;
+
+    std::vector<uint8_t> background(LineCount * 256);
+    std::vector<uint8_t> sprites(LineCount * 256);
+    uint32_t colors[32];
+    uint16_t indices[32];
+    uint32_t palette[512];
+
+    uint32_t seed = 1;
+    auto random = [&seed]()
+    {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) & 0x7FFF;
+    };
+
+    for (size_t i = 0; i < background.size(); i++)
+    {
+        background[i] = random() & 0x0F;
+        sprites[i] = (random() % 4 == 0) ? (random() & 3) | ((4 + random() % 4) << 2) | ((random() & 1) << 5) : 0;
+    }
+
+    for (uint32_t& color : colors)
+        color = random() << 16 | random();
+
+    for (uint16_t& index : indices)
+        index = random() & 0x1FF;
+
+    for (uint32_t& color : palette)
+        color = random() << 16 | random();
+
+    std::vector<uint32_t> expected(LineCount * 256);
+    std::vector<uint32_t> output(LineCount * 256);
+    PixelComposer composer;
+    composer.set_kernel(PixelComposer::Kernel::Scalar);
+    composer.compose(background.data(), sprites.data(), colors, expected.data(), LineCount * 256);
+
+    std::vector<uint16_t> index_output(LineCount * 256);
+    std::vector<uint32_t> expected_converted(LineCount * 256);
+    std::vector<uint32_t> converted(LineCount * 256);
+    composer.compose_indices(background.data(), sprites.data(), indices, index_output.data(), LineCount * 256);
+    composer.convert(index_output.data(), palette, expected_converted.data(), LineCount * 256);
+
+    for (int i = 0; i < PixelComposer::KernelCount; i++)
+    {
+        const PixelComposer::Kernel kernel = static_cast<PixelComposer::Kernel>(i);
+        if (!composer.set_kernel(kernel))
+        {
+            std::printf("%s: not supported\n", PixelComposer::name(kernel));
+            continue;
+        }
+
+        for (int line = 0; line < LineCount; line++)
+            composer.compose(&background[line * 256], &sprites[line * 256], colors, &output[line * 256], 256);
+
+        for (int line = 0; line < LineCount; line++)
+            composer.compose_indices(&background[line * 256], &sprites[line * 256], indices, &index_output[line * 256], 256);
+        composer.convert(index_output.data(), palette, converted.data(), LineCount * 256);
+
+        if (output != expected || converted != expected_converted)
+        {
+            std::printf("%s: differs from the scalar kernel\n", PixelComposer::name(kernel));
+            return 1;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        for (long n = 0; n < Iterations; n++)
+        {
+            const int line = n % LineCount;
+            composer.compose(&background[line * 256], &sprites[line * 256], colors, &output[line * 256], 256);
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        const double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+
+        // The index buffer holds LineCount / 240 frames
+        const auto convert_start = std::chrono::steady_clock::now();
+        for (long n = 0; n < Iterations / 256; n++)
+            composer.convert(index_output.data(), palette, converted.data(), LineCount * 256);
+        const auto convert_end = std::chrono::steady_clock::now();
+
+        const double convert_nanoseconds = std::chrono::duration<double, std::nano>(convert_end - convert_start).count();
+        std::printf("%s: %.1f ns per scanline, %.1f us per frame conversion\n", PixelComposer::name(kernel),
+                    nanoseconds / Iterations, convert_nanoseconds / (Iterations / 256) * 240 / LineCount / 1000);
+    }
+
+    return 0;
+}
+
+// Everything the block cache, the JIT, the idle loop skipping or the scanline renderer can change,
+// compared with the interpreter after each frame
+static const char* compare_state(Emulator& nes, Emulator& interpreter, bool rendered)
+{
+    const CPU::Registers& a = nes.cpu().registers();
+    const CPU::Registers& b = interpreter.cpu().registers();
+
+    if (a.A != b.A || a.X != b.X || a.Y != b.Y || a.P != b.P || a.SP != b.SP || a.PC != b.PC)
+        return "CPU registers";
+
+    if (nes.cpu().cycles() != interpreter.cpu().cycles())
+        return "CPU cycles";
+
+    if (nes.cpu().instructions() != interpreter.cpu().instructions())
+        return "CPU instructions";
+
+    if (std::memcmp(nes.ram(), interpreter.ram(), 0x800) != 0)
+        return "RAM";
+
+    if (rendered && std::memcmp(nes.screen_buffer(), interpreter.screen_buffer(), 256 * 240 * sizeof(uint32_t)) != 0)
+        return "frame";
+
+    return nullptr;
+}
+
+// A state with a bank out of the ROM, an unknown mirroring or a PPU position
+// or sprite count out of range must not load, and must leave the machine as
+// it was
+static bool check_bad_state(Emulator& nes)
+{
+    std::vector<uint8_t> state;
+    std::vector<uint8_t> after;
+    if (!nes.save_state(state))
+        return false;
+
+    // The mapper state comes last, after the PPU, system bus and APU states
+    const size_t mapper = state.size() - sizeof(Mapper::State);
+    const size_t ppu = mapper - sizeof(APU::State) - sizeof(SystemBus::State) - sizeof(PPU::State);
+
+    struct BadField
+    {
+        const char* name;
+        size_t offset;
+        uint32_t value;
+        size_t size;
+    };
+
+    const BadField fields[] = {
+        { "PRG bank", mapper + offsetof(Mapper::State, prg_mapping), 0xFFFFF000, sizeof(uint32_t) },
+        { "CHR bank", mapper + offsetof(Mapper::State, chr_mapping), 0xFFFFF000, sizeof(uint32_t) },
+        { "mirroring", mapper + offsetof(Mapper::State, mirroring_mode), 7, sizeof(MirroringMode) },
+        { "PPU sprite count", ppu + offsetof(PPU::State, sprite_count), 9, sizeof(uint8_t) },
+        { "PPU scanline", ppu + offsetof(PPU::State, scanline), 262, sizeof(uint16_t) },
+        { "PPU cycle", ppu + offsetof(PPU::State, cycle), 341, sizeof(uint16_t) },
+    };
+
+    for (const BadField& field : fields)
+    {
+        // Little endian, the low bytes of the value
+        std::vector<uint8_t> bad = state;
+        std::memcpy(&bad[field.offset], &field.value, field.size);
+        if (nes.load_state(bad) || !nes.save_state(after) || after != state)
+        {
+            std::printf("A state with a bad %s %s\n", field.name, after == state ? "was loaded" : "changed the machine");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Goes back through the rewind buffer, each state must be the one saved
+static bool check_rewind(RewindBuffer& rewind_buffer, const std::vector<std::vector<uint8_t>>& states, double capture_seconds)
+{
+    const uint32_t frames = rewind_buffer.frame_count();
+    const size_t used = rewind_buffer.used();
+
+    std::vector<uint8_t> state;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        if (!rewind_buffer.pop(state) || state != states[states.size() - 2 - i])
+        {
+            std::printf("Rewind differs %u frames back\n", i + 1);
+            return false;
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double pop_seconds = std::chrono::duration<double>(end - start).count();
+    std::printf("Rewind: %u frames, %.1f KB per minute, %.1f us capture, %.1f us per frame back\n", frames,
+                frames > 0 ? used / 1024.0 / frames * 3600 : 0.0, capture_seconds / states.size() * 1000000.0,
+                frames > 0 ? pop_seconds / frames * 1000000.0 : 0.0);
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string rom_file;
+    std::string input_file;
+    long frame_count = 600;
+    bool print_hash = false;
+    bool block_cache = false;
+    bool jit = false;
+    bool idle_skip = false;
+    bool dot_renderer = false;
+    int compose_kernel = -1;
+    bool indexed = false;
+    long frame_skip = 0;
+    int run_ahead = 0;
+    bool verify = false;
+    bool verify_state = false;
+    bool rewind = false;
+    Emulator::ExecutionMode mode = Emulator::ExecutionMode::Instruction;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frame_count = std::strtol(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+            input_file = argv[++i];
+        else if (std::strcmp(argv[i], "--mode") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "cycle") == 0)
+        {
+            mode = Emulator::ExecutionMode::Cycle;
+            i++;
+        }
+        else if (std::strcmp(argv[i], "--mode") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "instruction") == 0)
+        {
+            mode = Emulator::ExecutionMode::Instruction;
+            i++;
+        }
+        else if (std::strcmp(argv[i], "--block-cache") == 0)
+            block_cache = true;
+        else if (std::strcmp(argv[i], "--jit") == 0)
+            jit = true;
+        else if (std::strcmp(argv[i], "--idle-skip") == 0)
+            idle_skip = true;
+        else if (std::strcmp(argv[i], "--dot-renderer") == 0)
+            dot_renderer = true;
+        else if (std::strcmp(argv[i], "--compose") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (std::strcmp(argv[i], "scalar") == 0)
+                compose_kernel = static_cast<int>(PixelComposer::Kernel::Scalar);
+            else if (std::strcmp(argv[i], "sse2") == 0)
+                compose_kernel = static_cast<int>(PixelComposer::Kernel::SSE2);
+            else if (std::strcmp(argv[i], "avx2") == 0)
+                compose_kernel = static_cast<int>(PixelComposer::Kernel::AVX2);
+
+            if (compose_kernel < 0)
+            {
+                print_usage(argv[0]);
+                return -1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--indexed") == 0)
+            indexed = true;
+        else if (std::strcmp(argv[i], "--frame-skip") == 0 && i + 1 < argc)
+            frame_skip = std::strtol(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc)
+            run_ahead = static_cast<int>(std::strtol(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--bench-compose") == 0)
+            return bench_compose();
+        else if (std::strcmp(argv[i], "--verify") == 0)
+            verify = true;
+        else if (std::strcmp(argv[i], "--verify-jit") == 0)
+            jit = verify = true;
+        else if (std::strcmp(argv[i], "--verify-state") == 0)
+            verify_state = true;
+        else if (std::strcmp(argv[i], "--rewind") == 0)
+            rewind = true;
+        else if (std::strcmp(argv[i], "--hash") == 0)
+            print_hash = true;
+        else if (rom_file.empty() && argv[i][0] != '-')
+            rom_file = argv[i];
+        else
+        {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (rom_file.empty() || frame_count <= 0 || frame_skip < 0 || run_ahead < 0)
+    {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    // Input file holds one byte per controller per frame
+    MemoryInputSource input;
+    if (!input_file.empty() && !input.load_from_file(input_file))
+        return -1;
+
+    Emulator nes(input);
+
+    if (!nes.init())
+        return -1;
+
+    if (!nes.load_rom_file(rom_file))
+        return -1;
+
+    nes.set_execution_mode(mode);
+    nes.set_block_cache_enabled(block_cache);
+    nes.set_idle_loop_skipping_enabled(idle_skip);
+    nes.set_scanline_renderer_enabled(!dot_renderer);
+    nes.set_indexed_output(indexed);
+
+    if (compose_kernel >= 0 && !nes.set_compose_kernel(static_cast<PixelComposer::Kernel>(compose_kernel)))
+    {
+        std::printf("%s composition is not supported on this CPU\n",
+                    PixelComposer::name(static_cast<PixelComposer::Kernel>(compose_kernel)));
+        return -1;
+    }
+
+    if (jit && !nes.set_jit_enabled(true))
+        return -1;
+
+    // Same machine without the block cache, the JIT, the idle loop skipping
+    // and the scanline renderer, run in lockstep with the first one. With the state check it
+    // is also reset and given the state of the first one once a second.
+    const bool use_reference = verify || verify_state;
+    MemoryInputSource reference_input;
+    if (use_reference && !input_file.empty() && !reference_input.load_from_file(input_file))
+        return -1;
+
+    Emulator reference(reference_input);
+
+    if (use_reference)
+    {
+        if (!reference.init() || !reference.load_rom_file(rom_file))
+            return -1;
+
+        reference.set_execution_mode(mode);
+        reference.set_scanline_renderer_enabled(false);
+    }
+
+    // The samples are not played, drain them so the sound buffer does not fill up
+    std::vector<blip_sample_t> samples;
+    std::vector<blip_sample_t> reference_samples;
+    uint64_t hash = 0xCBF29CE484222325;
+    std::vector<uint8_t> state;
+    double save_seconds = 0;
+    double load_seconds = 0;
+    bool reference_loaded = false;
+
+    // Every state is kept to check what the rewind buffer gives back
+    RewindBuffer rewind_buffer;
+    std::vector<std::vector<uint8_t>> rewind_states;
+    double capture_seconds = 0;
+    if (rewind)
+        rewind_buffer.init(RewindBufferSize, static_cast<uint32_t>(frame_count));
+
+    // Without input the frame shown ahead is the one the reference draws
+    // run_ahead frames later
+    const bool check_ahead = use_reference && run_ahead > 0 && frame_skip == 0 && input_file.empty();
+    std::deque<std::vector<uint32_t>> ahead_frames;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (long frame = 0; frame < frame_count; frame++)
+    {
+        // Frame skip N draws one frame out of N + 1
+        const bool render = (frame % (frame_skip + 1)) == 0;
+        nes.run(render && run_ahead == 0);
+        read_samples(nes, samples);
+
+        // Only the frame ahead is drawn, the samples are those of the frame
+        // just run
+        if (run_ahead > 0 && render)
+        {
+            if (!nes.run_ahead(run_ahead))
+                return 1;
+
+            if (check_ahead)
+                ahead_frames.emplace_back(nes.screen_buffer(), nes.screen_buffer() + 256 * 240);
+        }
+
+        if (print_hash)
+        {
+            hash = hash_bytes(hash, samples.data(), samples.size() * sizeof(blip_sample_t));
+            if (render)
+                hash = hash_bytes(hash, nes.screen_buffer(), 256 * 240 * sizeof(uint32_t));
+        }
+
+        if (verify_state)
+        {
+            // Loading the state just saved must change nothing
+            const auto save_start = std::chrono::steady_clock::now();
+            nes.save_state(state);
+            const auto load_start = std::chrono::steady_clock::now();
+            const bool loaded = nes.load_state(state);
+            const auto load_end = std::chrono::steady_clock::now();
+
+            save_seconds += std::chrono::duration<double>(load_start - save_start).count();
+            load_seconds += std::chrono::duration<double>(load_end - load_start).count();
+
+            if (!loaded)
+                return 1;
+        }
+
+        if (rewind)
+        {
+            const auto capture_start = std::chrono::steady_clock::now();
+            nes.save_state(state);
+            rewind_buffer.push(state);
+            const auto capture_end = std::chrono::steady_clock::now();
+
+            capture_seconds += std::chrono::duration<double>(capture_end - capture_start).count();
+            rewind_states.push_back(state);
+        }
+
+        if (use_reference)
+        {
+            reference.run();
+            read_samples(reference, reference_samples);
+
+            // The first frame after a load can keep a pixel of the frame
+            // before it, the audio must be the same
+            const char* difference = compare_state(nes, reference, render && !reference_loaded && run_ahead == 0);
+            if (difference == nullptr && samples != reference_samples)
+                difference = "audio";
+
+            if (check_ahead && !ahead_frames.empty() && frame >= run_ahead)
+            {
+                if (std::memcmp(ahead_frames.front().data(), reference.screen_buffer(), 256 * 240 * sizeof(uint32_t)) != 0)
+                    difference = "frame ahead";
+
+                ahead_frames.pop_front();
+            }
+
+            if (difference != nullptr)
+            {
+                std::printf("Differs from the interpreter at frame %ld: %s\n", frame, difference);
+                return 1;
+            }
+
+            // Anything left out of the state shows up as a difference after
+            // the reset
+            reference_loaded = verify_state && frame % 60 == 0;
+            if (reference_loaded)
+            {
+                reference.reset();
+                if (!reference.load_state(state))
+                    return 1;
+            }
+        }
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+
+    if (rewind && !check_rewind(rewind_buffer, rewind_states, capture_seconds))
+        return 1;
+
+    if (verify_state && !check_bad_state(nes))
+        return 1;
+
+    std::printf("Frames: %ld\n", frame_count);
+    std::printf("Time: %.3f s\n", seconds);
+    std::printf("Speed: %.1f fps\n", seconds > 0 ? frame_count / seconds : 0.0);
+    std::printf("CPU: %llu instructions, %llu cycles\n",
+                static_cast<unsigned long long>(nes.cpu().instructions()),
+                static_cast<unsigned long long>(nes.cpu().cycles()));
+    std::printf("CPU speed: %.2f M instructions/s\n",
+                seconds > 0 ? nes.cpu().instructions() / seconds / 1000000.0 : 0.0);
+
+    if (block_cache)
+        std::printf("Cached blocks: %zu\n", nes.cpu().cached_blocks());
+
+    if (jit)
+        std::printf("Compiled blocks: %zu\n", nes.cpu().compiled_blocks());
+
+    if (idle_skip)
+        std::printf("Skipped cycles: %llu\n", static_cast<unsigned long long>(nes.cpu().skipped_cycles()));
+
+    if (use_reference)
+        std::printf("Matches the interpreter\n");
+
+    if (run_ahead > 0)
+        std::printf("Run-ahead: %d frames, %.3f ms per frame\n", run_ahead, seconds / frame_count * 1000.0);
+
+    if (verify_state)
+    {
+        std::printf("State: %zu bytes, %.2f us save, %.2f us load\n", state.size(),
+                    save_seconds / frame_count * 1000000.0, load_seconds / frame_count * 1000000.0);
+    }
+
+    if (print_hash)
+        std::printf("Hash: %016llx\n", static_cast<unsigned long long>(hash));
+
+    return 0;
+}
@@ -28,6 +28,12 @@ void InputManager::process_input_event(SDL_Event& event)
     }
 }
 
+void InputManager::poll_buttons_state(uint8_t* buttons, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+        buttons[i] = get_buttons_state(i);
+}
+
 uint8_t InputManager::get_buttons_state(uint8_t index)
 {
     if (index >= Controller::ControllerCount)
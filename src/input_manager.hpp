@@ -1,6 +1,7 @@
 #pragma once
 
 #include "controller.hpp"
+#include "input_source.hpp"
 #include <cstdint>
 #include <SDL.h>
 
@@ -16,13 +17,14 @@ struct KeyboardConfig
     SDL_Scancode key_right[Controller::ControllerCount] = { SDL_SCANCODE_RIGHT, SDL_SCANCODE_D };
 };
 
-class InputManager
+class InputManager : public InputSource
 {
 public:
     InputManager() = default;
     ~InputManager();
 
     void process_input_event(SDL_Event& event);
+    void poll_buttons_state(uint8_t* buttons, uint8_t count) override;
     uint8_t get_buttons_state(uint8_t index);
     void search_controllers();
     uint8_t controller_count();
@@ -1,29 +1,30 @@
 #include "logger.hpp"
 #include "platform.hpp"
-#include "version.hpp"
 #include <cstdarg>
 #include <string>
 #include <sstream>
 #include <iostream>
 
-#ifndef EMU_DEBUG_ENABLED
-#include <SDL.h>
-#endif // Release mode
-
 #ifdef EMU_PLATFORM_WINDOWS
 #include <Windows.h>
 #include <debugapi.h>
 #endif // Windows
 
+static LogErrorHandler log_error_handler = nullptr;
+
 inline void log_write_error(const std::string& message)
 {
-#ifndef EMU_DEBUG_ENABLED
-    SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, EMU_VERSION_NAME, message.c_str(), nullptr);
-#elif defined(EMU_PLATFORM_WINDOWS)
+    if (log_error_handler)
+    {
+        log_error_handler(message.c_str());
+        return;
+    }
+
+#ifdef EMU_PLATFORM_WINDOWS
     OutputDebugStringA(message.c_str());
 #else
     std::cerr << message;
-#endif // Debug enabled and platform
+#endif // Windows
 }
 
 inline void log_write(const std::string& message)
@@ -35,6 +36,11 @@ inline void log_write(const std::string& message)
 #endif // Windows
 }
 
+void log_set_error_handler(LogErrorHandler handler)
+{
+    log_error_handler = handler;
+}
+
 void log_f(LogLevel level, const char* fmt, ...)
 {
     constexpr std::size_t LOG_BUFFER_SIZE = 1024;
@@ -21,4 +21,8 @@ enum LogLevel
     LOG_LEVEL_MAX
 };
 
+// Called for error and fatal messages instead of the default output when set
+typedef void (*LogErrorHandler)(const char* message);
+
+void log_set_error_handler(LogErrorHandler handler);
 void log_f(LogLevel level, const char* fmt, ...);
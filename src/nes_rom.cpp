@@ -5,16 +5,16 @@
 
 NesRom::NesRom(const std::string& file_path)
 {
-    size_t file_size = platform::file_size(file_path);
-    m_data.resize(file_size);
-
     std::ifstream fstream(file_path, std::ifstream::binary);
     if (!fstream.is_open())
         throw NesFileOpenException();
 
-    m_data.insert(m_data.begin(),
-                  std::istreambuf_iterator<char>(fstream),
-                  std::istreambuf_iterator<char>());
+    // Read in place, the buffer is the size of the file
+    m_data.resize(platform::file_size(file_path));
+    fstream.read(reinterpret_cast<char*>(m_data.data()), m_data.size());
+    m_data.resize(fstream.gcount());
+    if (m_data.size() < sizeof(NesFileHeader))
+        throw NesInvalidRomException();
 
     m_header = reinterpret_cast<NesFileHeader*>(&m_data[0]);
     if (!is_valid())
@@ -22,6 +22,9 @@ NesRom::NesRom(const std::string& file_path)
 
     if (version() == NesRomVersion::Unsupported)
         throw NesUnsupportedException();
+
+    if (m_data.size() < static_cast<size_t>(chr_data() - m_data.data()) + character_rom_size())
+        throw NesInvalidRomException();
 }
 
 bool NesRom::is_valid() const
@@ -116,24 +119,16 @@ MirroringMode NesRom::mirroring_mode() const
     }
 }
 
-void NesRom::read_prg_data(std::vector<uint8_t>& buffer)
+const uint8_t* NesRom::prg_data() const
 {
     uint32_t offset = sizeof(NesFileHeader);
     if (has_trainer_data())
         offset += NesFileHeader::TrainerSize;
 
-    std::copy(m_data.begin() + offset, m_data.begin() + (offset + program_rom_size()), buffer.begin());
+    return m_data.data() + offset;
 }
 
-void NesRom::read_chr_data(std::vector<uint8_t>& buffer)
+const uint8_t* NesRom::chr_data() const
 {
-    if (character_rom_size() == 0)
-        return;
-
-    uint32_t offset = sizeof(NesFileHeader);
-    if (has_trainer_data())
-        offset += NesFileHeader::TrainerSize;
-    offset += program_rom_size();
-
-    std::copy(m_data.begin() + offset, m_data.begin() + (offset + character_rom_size()), buffer.begin());
+    return prg_data() + program_rom_size();
 }
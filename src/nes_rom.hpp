@@ -65,8 +65,9 @@ public:
     uint32_t character_rom_size() const;
     MirroringMode mirroring_mode() const;
 
-    void read_prg_data(std::vector<uint8_t>& buffer);
-    void read_chr_data(std::vector<uint8_t>& buffer);
+    // Within the file data, the CHR ROM is empty with CHR RAM
+    const uint8_t* prg_data() const;
+    const uint8_t* chr_data() const;
 
 private:
     std::vector<uint8_t> m_data;
@@ -1,40 +1,33 @@
 #include "sound_queue.hpp"
 #include "logger.hpp"
-#include <string>
-#include <assert.h>
+#include <algorithm>
+#include <cstring>
 
 SoundQueue::~SoundQueue()
 {
-    SDL_PauseAudio(true);
-    SDL_CloseAudio();
-    SDL_DestroySemaphore(m_semaphore);
+    if (m_device == 0)
+        return;
 
-    delete [] m_buffers;
+    SDL_CloseAudioDevice(m_device);
+    LOG_INFO("Sound queue: %llu underruns, %llu overruns",
+             static_cast<unsigned long long>(underruns()),
+             static_cast<unsigned long long>(overruns()));
 }
 
-bool SoundQueue::init(long sample_rate, int channel_count)
+bool SoundQueue::init(long sample_rate, long capacity, int device_samples, int channel_count)
 {
-    assert(!m_buffers);
+    size_t size = 1;
+    while (size < static_cast<size_t>(std::max(capacity, 1L)))
+        size <<= 1;
 
-    m_buffers = new sample_t[BufferSize * BufferCount];
-    if (!m_buffers)
-     {
-        LOG_FATAL("Cannot allocate memory for sound queue buffers");
-        return false;
-    }
-
-    m_semaphore = SDL_CreateSemaphore(BufferCount - 1);
-    if (!m_semaphore)
-    {
-        LOG_FATAL("SDL_CreateSemaphore error: %s", SDL_GetError());
-        return false;
-    }
+    m_buffer.assign(size, 0);
+    m_mask = size - 1;
 
     m_audio_spec.freq = sample_rate;
     m_audio_spec.format = AUDIO_S16SYS;
     m_audio_spec.channels = channel_count;
     m_audio_spec.silence = 0;
-    m_audio_spec.samples = BufferSize;
+    m_audio_spec.samples = device_samples;
     m_audio_spec.size = 0;
     m_audio_spec.userdata = this;
     m_audio_spec.callback = [](void* user_data, unsigned char* stream, int size) {
@@ -42,61 +35,73 @@ bool SoundQueue::init(long sample_rate, int channel_count)
         sq->fill_buffer(stream, size);
     };
 
-    if (SDL_OpenAudio(&m_audio_spec, nullptr) < 0)
+    SDL_AudioSpec obtained = {};
+    m_device = SDL_OpenAudioDevice(nullptr, 0, &m_audio_spec, &obtained, SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+    if (m_device == 0)
     {
-        LOG_FATAL("SDL_OpenAudio error: %s", SDL_GetError());
+        LOG_FATAL("SDL_OpenAudioDevice error: %s", SDL_GetError());
         return false;
     }
 
-    SDL_PauseAudio(false);
+    m_audio_spec.samples = obtained.samples;
+    SDL_PauseAudioDevice(m_device, 0);
 
     return true;
 }
 
-int SoundQueue::sample_count() const
+long SoundQueue::sample_count() const
 {
-    int buffer_free = SDL_SemValue(m_semaphore) * BufferSize + (BufferSize - m_write_position);
-    return BufferSize * BufferCount - buffer_free;
+    return static_cast<long>(m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_acquire));
 }
 
-inline SoundQueue::sample_t* SoundQueue::get_buffer(int index)
+double SoundQueue::latency() const
 {
-    assert(static_cast<unsigned>(index) < BufferCount);
-    return m_buffers + static_cast<long>(index) * BufferSize;
+    return 1000.0 * (sample_count() + m_audio_spec.samples) / m_audio_spec.freq;
 }
 
-void SoundQueue::write(const sample_t* stream, int size)
+long SoundQueue::write(const sample_t* samples, long count)
 {
-    while (size)
-    {
-        int n = BufferSize - m_write_position;
-        if (n > size)
-            n = size;
-        
-        memcpy(get_buffer(m_write_buffer) + m_write_position, stream, n * sizeof(sample_t));
-        stream += n;
-        m_write_position += n;
-        size -= n;
-        
-        if (m_write_position >= BufferSize)
-        {
-            m_write_position = 0;
-            m_write_buffer = (m_write_buffer + 1) % BufferCount;
-            SDL_SemWait(m_semaphore);
-        }
-    }
+    const size_t write = m_write.load(std::memory_order_relaxed);
+    const size_t free = m_buffer.size() - (write - m_read.load(std::memory_order_acquire));
+    const size_t n = std::min(static_cast<size_t>(count), free);
+
+    if (n < static_cast<size_t>(count))
+        m_overruns.fetch_add(1, std::memory_order_relaxed);
+
+    // In up to two parts around the end of the ring
+    const size_t offset = write & m_mask;
+    const size_t first = std::min(n, m_buffer.size() - offset);
+    memcpy(&m_buffer[offset], samples, first * sizeof(sample_t));
+    memcpy(&m_buffer[0], samples + first, (n - first) * sizeof(sample_t));
+
+    m_write.store(write + n, std::memory_order_release);
+    return static_cast<long>(n);
 }
 
 void SoundQueue::fill_buffer(uint8_t* stream, int size)
 {
-    if (SDL_SemValue(m_semaphore) < BufferCount - 1)
-    {
-        memcpy(stream, get_buffer(m_read_buffer), size);
-        m_read_buffer = (m_read_buffer + 1) % BufferCount;
-        SDL_SemPost(m_semaphore);
-    }
-    else
+    sample_t* output = reinterpret_cast<sample_t*>(stream);
+    const size_t count = size / sizeof(sample_t);
+
+    const size_t read = m_read.load(std::memory_order_relaxed);
+    const size_t available = m_write.load(std::memory_order_acquire) - read;
+    const size_t n = std::min(count, available);
+
+    const size_t offset = read & m_mask;
+    const size_t first = std::min(n, m_buffer.size() - offset);
+    memcpy(output, &m_buffer[offset], first * sizeof(sample_t));
+    memcpy(output + first, &m_buffer[0], (n - first) * sizeof(sample_t));
+
+    m_read.store(read + n, std::memory_order_release);
+
+    if (n > 0)
+        m_last_sample = output[n - 1];
+
+    // Holding the last sample avoids the click of dropping to silence
+    if (n < count)
     {
-        memset(stream, 0, size);
+        if (m_producing.load(std::memory_order_relaxed))
+            m_underruns.fetch_add(1, std::memory_order_relaxed);
+        std::fill(output + n, output + count, m_last_sample);
     }
 }
@@ -1,30 +1,48 @@
 #pragma once
 
 #include <SDL.h>
+#include <atomic>
 #include <cstdint>
+#include <vector>
 
+// Ring buffer between the emulation thread, which writes the samples, and the
+// SDL audio callback, which reads them. Neither side ever waits: samples which
+// do not fit are dropped and the callback pads a short read with the last
+// sample.
 class SoundQueue {
 public:
     SoundQueue() = default;
     ~SoundQueue();
-    
-    bool init(long sample_rate, int channel_count = 1);
-    int sample_count() const;
+
+    // capacity: ring buffer size in samples, rounded up to a power of two.
+    // device_samples: samples the device asks for at once, its latency.
+    bool init(long sample_rate, long capacity = 8192, int device_samples = 512, int channel_count = 1);
+    // Samples waiting in the ring buffer
+    long sample_count() const;
+    long capacity() const { return static_cast<long>(m_buffer.size()); }
+    // Buffered samples plus one device buffer, in milliseconds
+    double latency() const;
+    uint64_t underruns() const { return m_underruns.load(std::memory_order_relaxed); }
+    uint64_t overruns() const { return m_overruns.load(std::memory_order_relaxed); }
+    // Set by the producer while it writes every frame, a short read is only
+    // an underrun then and not while the emulation is paused or idle
+    void set_producing(bool producing) { m_producing.store(producing, std::memory_order_relaxed); }
 
     typedef short sample_t;
-    void write(const sample_t*, int count);
+    // Writes what fits, returns the number of samples written
+    long write(const sample_t* samples, long count);
 
 private:
-    static constexpr long BufferSize = 2048;
-    static constexpr int BufferCount = 3;
-
+    SDL_AudioDeviceID m_device = 0;
     SDL_AudioSpec m_audio_spec = {};
-    sample_t* volatile m_buffers = nullptr;
-    SDL_sem* volatile m_semaphore = nullptr;
-    int volatile m_read_buffer = 0;
-    int m_write_buffer = 0;
-    int m_write_position = 0;
+    std::vector<sample_t> m_buffer;
+    size_t m_mask = 0;
+    sample_t m_last_sample = 0;
+    alignas(64) std::atomic<size_t> m_read = 0;
+    alignas(64) std::atomic<size_t> m_write = 0;
+    std::atomic<uint64_t> m_underruns = 0;
+    std::atomic<uint64_t> m_overruns = 0;
+    std::atomic<bool> m_producing = false;
 
-    sample_t* get_buffer(int index);
     void fill_buffer(uint8_t* stream, int size);
 };
@@ -0,0 +1,12 @@
+#pragma once
+
+#define MKSTR(x) #x
+#define EMU_MKSTR(x) MKSTR(x)
+
+#define EMU_VERSION_MAJOR 0
+#define EMU_VERSION_MINOR 1
+#define EMU_VERSION_PATCH 1
+
+#define EMU_VERSION_NAME "Nesmancer"
+#define EMU_VERSION_NUMBER EMU_MKSTR(EMU_VERSION_MAJOR.EMU_VERSION_MINOR.EMU_VERSION_PATCH)
+#define EMU_VERSION "v" EMU_VERSION_NUMBER
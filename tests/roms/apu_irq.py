@@ -0,0 +1,132 @@
+import sys
+
+from nesasm import Asm, Lcg, ines
+
+# APU frame and DMC IRQs: the handler acknowledges them, changes the scroll
+# and the palette mid-frame so their timing shows in the video
+src = r'''
+frame = $00
+nmi_flag = $01
+irqs = $02
+dmcs = $03
+tmp = $04
+.org $8000
+reset:
+  SEI
+  CLD
+  LDX #$FF
+  TXS
+  LDA #0
+  STA $2000
+  STA $2001
+vw1: BIT $2002
+  BPL vw1
+  LDA #0
+  TAX
+clr: STA $00,X
+  STA $0200,X
+  INX
+  BNE clr
+vw2: LDA $2002
+  BPL vw2
+  LDA #$3F
+  STA $2006
+  LDA #$00
+  STA $2006
+  LDX #0
+pal: LDA palette,X
+  STA $2007
+  INX
+  CPX #32
+  BNE pal
+  LDA #$20
+  STA $2006
+  LDA #$00
+  STA $2006
+  LDX #4
+  LDY #0
+nt: TYA
+  EOR tmp
+  AND #$07
+  ORA #$02
+  STA $2007
+  INY
+  BNE nt
+  INC tmp
+  DEX
+  BNE nt
+; DMC at $C000, IRQ on, no loop, slowest rate
+  LDA #$80
+  STA $4010
+  LDA #$00
+  STA $4012
+  LDA #$04
+  STA $4013
+  LDA #$10
+  STA $4015
+; frame counter mode 0, IRQ enabled
+  LDA #$00
+  STA $4017
+  LDA #$1E
+  STA $2001
+  LDA #$80
+  STA $2000
+  CLI
+main:
+wait: LDA nmi_flag
+  BEQ wait
+  LDA #0
+  STA nmi_flag
+  LDX #0
+busy: LDA frame
+  ADC busy,X
+  STA $0300,X
+  INX
+  BNE busy
+  JMP main
+
+nmi:
+  PHA
+  LDA #0
+  STA $2005
+  STA $2005
+  INC frame
+  LDA #1
+  STA nmi_flag
+  PLA
+  RTI
+
+irq:
+  PHA
+  LDA $4015
+  STA tmp
+  AND #$80
+  BEQ nodmc
+; restart the sample, which acknowledges the DMC IRQ
+  INC dmcs
+  LDA #$10
+  STA $4015
+nodmc:
+  INC irqs
+  LDA irqs
+  ASL A
+  ASL A
+  STA $2005
+  LDA dmcs
+  STA $2005
+  PLA
+  RTI
+
+palette:
+  .byte $0F,$01,$11,$21, $0F,$06,$16,$26, $0F,$09,$19,$29, $0F,$0C,$1C,$2C
+  .byte $0F,$14,$24,$34, $0F,$07,$17,$27, $0F,$0A,$1A,$2A, $0F,$03,$13,$23
+
+.org $FFFA
+  .word nmi, reset, irq
+'''
+a = Asm(0x8000)
+prg = a.assemble(src, zp=['frame','nmi_flag','irqs','dmcs','tmp'])
+assert len(prg) == 0x8000, hex(len(prg))
+rng = Lcg(3)
+chr_ = bytearray(rng.byte() for _ in range(0x2000))
+open(sys.argv[1], 'wb').write(ines(prg, bytes(chr_), 0))
@@ -0,0 +1,406 @@
+import sys
+
+from nesasm import Asm, Lcg, ines
+
+# MMC3 with PRG and CHR banks switched during the frame and a scanline IRQ
+# splitting the screen, code runs from every 8 KB PRG bank
+ZP = ['frame','nmi_flag','seed','scroll_x','tmpx','pad','chk','ptr','cnt','seed+1','ptr+1','split','bank','chrb']
+defs = r'''
+frame = $00
+nmi_flag = $01
+seed = $02
+scroll_x = $04
+tmpx = $05
+pad = $06
+chk = $07
+ptr = $08
+cnt = $0A
+split = $0B
+bank = $0C
+chrb = $0D
+'''
+main = defs + r'''
+helper = $C400
+.org $E000
+reset:
+  SEI
+  CLD
+  LDX #$FF
+  TXS
+  LDA #0
+  STA $2000
+  STA $2001
+  STA $E000
+  LDA #$40
+  STA $4017
+vw1: BIT $2002
+  BPL vw1
+  LDA #0
+  TAX
+clr: STA $00,X
+  STA $0200,X
+  STA $0300,X
+  STA $0400,X
+  STA $0500,X
+  STA $0600,X
+  STA $0700,X
+  INX
+  BNE clr
+; MMC3 setup: CHR banks R0..R5, PRG R6/R7
+  LDX #0
+mset: STX $8000
+  LDA chrinit,X
+  STA $8001
+  INX
+  CPX #8
+  BNE mset
+  LDA #1
+  STA $A000
+  LDA #$80
+  STA $A001
+vw2: LDA $2002
+  BPL vw2
+  LDA #$3F
+  STA $2006
+  LDA #$00
+  STA $2006
+  LDX #0
+pal: LDA palette,X
+  STA $2007
+  INX
+  CPX #32
+  BNE pal
+  LDA #$20
+  STA $2006
+  LDA #$00
+  STA $2006
+  LDX #8
+  LDY #0
+nt: TYA
+  EOR tmpx
+  STA $2007
+  INY
+  BNE nt
+  INC tmpx
+  DEX
+  BNE nt
+  LDX #0
+spr: TXA
+  ASL A
+  ADC #20
+  STA $0200,X
+  TXA
+  AND #$3E
+  STA $0201,X
+  TXA
+  AND #$C3
+  STA $0202,X
+  TXA
+  ASL A
+  STA $0203,X
+  INX
+  INX
+  INX
+  INX
+  BNE spr
+  LDA #24
+  STA $0200
+  LDA #2
+  STA $0201
+  LDA #0
+  STA $0202
+  LDA #64
+  STA $0203
+; copy RAM routine
+  LDX #0
+cpy: LDA ramcode,X
+  STA $0700,X
+  INX
+  CPX #32
+  BNE cpy
+; DMC sample
+  LDA #$0F
+  STA $4010
+  LDA #$00
+  STA $4012
+  LDA #$20
+  STA $4013
+  LDA #$1F
+  STA $4015
+  LDA #$34
+  STA seed
+  LDA #$12
+  STA seed+1
+  LDA #$1E
+  STA $2001
+  LDA #$A0
+  STA $2000
+  CLI
+main:
+wait: LDA nmi_flag
+  BEQ wait
+  LDA #0
+  STA nmi_flag
+; run routines from every switchable bank through R6 ($8000)
+  LDA #0
+  STA bank
+bloop: LDA #6
+  STA $8000
+  LDA bank
+  STA $8001
+  JSR $8000
+  INC bank
+  LDA bank
+  CMP #12
+  BNE bloop
+; same bank code mapped at $C000 (PRG mode 1)
+  SEI
+  LDA #$46
+  STA $8000
+  LDA #5
+  STA $8001
+  JSR $C000
+  LDA #$06
+  STA $8000
+  CLI
+; self switching routine in bank 0 slot $8000
+  LDA #6
+  STA $8000
+  LDA #0
+  STA $8001
+  JSR $8100
+; R7 routine which switches R6 while running from $A000
+  LDA #7
+  STA $8000
+  LDA #13
+  STA $8001
+  JSR $A000
+; code in RAM
+  JSR $0700
+; PRG RAM checksum
+  LDX #0
+  LDA #0
+prs: CLC
+  ADC $6000,X
+  INX
+  BNE prs
+  STA $0601
+  JSR helper
+  JMP main
+
+nmi:
+  PHA
+  TXA
+  PHA
+  TYA
+  PHA
+  LDA #$02
+  STA $4014
+  LDA scroll_x
+  STA $2005
+  LDA #0
+  STA $2005
+  LDA #$A0
+  STA $2000
+; IRQ after 40 scanlines
+  LDA #39
+  STA $C000
+  STA $C001
+  STA $E001
+  LDA #0
+  STA split
+; controller
+  LDA #1
+  STA $4016
+  LDA #0
+  STA $4016
+  LDX #8
+rd: LDA $4016
+  LSR A
+  ROL pad
+  DEX
+  BNE rd
+; animate CHR bank R2
+  INC chrb
+  LDA chrb
+  LSR A
+  LSR A
+  AND #$1F
+  ORA #$40
+  LDX #2
+  STX $8000
+  STA $8001
+; move sprites
+  LDX #4
+mv: TXA
+  LSR A
+  LSR A
+  AND #$03
+  SEC
+  ADC $0203,X
+  STA $0203,X
+  INX
+  INX
+  INX
+  INX
+  BNE mv
+  INC frame
+  LDA frame
+  STA scroll_x
+  AND #$1F
+  BNE nosnd
+  LDA #$1F
+  STA $4015
+  LDA #$9F
+  STA $4004
+  LDA frame
+  STA $4006
+  LDA #$09
+  STA $4007
+nosnd:
+  LDA #1
+  STA nmi_flag
+  PLA
+  TAY
+  PLA
+  TAX
+  PLA
+  RTI
+
+irq:
+  PHA
+  TXA
+  PHA
+  STA $E000
+  INC split
+  LDA split
+  ASL A
+  ASL A
+  ASL A
+  ADC frame
+  STA $2005
+  STA $2005
+; swap background CHR bank mid frame
+  LDX #0
+  STX $8000
+  ASL A
+  AND #$3E
+  STA $8001
+  LDA split
+  CMP #3
+  BCS irqdone
+  LDA #29
+  STA $C000
+  STA $C001
+  STA $E001
+irqdone:
+  PLA
+  TAX
+  PLA
+  RTI
+
+ramcode:
+  LDX #0
+rc1: LDA $0300,X
+  EOR #$5A
+  STA $0780,X
+  INX
+  CPX #32
+  BNE rc1
+  INC $0602
+  RTS
+  .byte 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+
+chrinit: .byte 0, 2, 4, 5, 6, 7, 0, 1
+palette:
+  .byte $0F,$01,$11,$21, $0F,$06,$16,$26, $0F,$09,$19,$29, $0F,$0C,$1C,$2C
+  .byte $0F,$14,$24,$34, $0F,$07,$17,$27, $0F,$0A,$1A,$2A, $0F,$03,$13,$23
+
+.org $FFFA
+  .word nmi, reset, irq
+'''
+c000 = defs + r'''
+.org $C000
+  .byte $AA,$55,$F0,$0F,$CC,$33,$FF,$00
+  .byte $AA,$55,$F0,$0F,$CC,$33,$FF,$00
+.org $C400
+helper:
+  LDY #0
+hl: LDA $0300,Y
+  ADC $0340,Y
+  STA $0640,Y
+  INY
+  CPY #64
+  BNE hl
+  RTS
+'''
+def bank_code(b):
+    s = defs + r'''
+.org $8000
+  LDY #%d
+  LDX #0
+b1: TXA
+  ADC #%d
+  STA $6000,X
+  EOR $0300,X
+  ROL A
+  STA $0300,X
+  INX
+  CPX #%d
+  BNE b1
+  STY $6100
+  RTS
+.org $8100
+  LDA #6
+  STA $8000
+  LDA #%d
+  STA $8001
+  INC $6101
+  INC $6102
+  RTS
+''' % (b, b * 7 + 1, 16 + b * 4, (b + 1) % 12)
+    return s
+def bank_a(b):
+    return defs + r'''
+.org $A000
+  LDA #6
+  STA $8000
+  LDA #3
+  STA $8001
+  LDA $8000
+  STA $6200
+  LDA #6
+  STA $8000
+  LDA #5
+  STA $8001
+  LDA $8000
+  STA $6201
+  LDY #0
+a1: LDA $8000,Y
+  STA $6300,Y
+  INY
+  BNE a1
+  RTS
+'''
+banks = []
+for b in range(16):
+    if b == 15:
+        code = Asm(0xE000).assemble(main, zp=ZP)
+        # Asm starts at org but main has .org $E000 right away
+    elif b == 14:
+        code = Asm(0xC000).assemble(c000, zp=ZP)
+    elif b == 13:
+        code = Asm(0xA000).assemble(bank_a(b), zp=ZP)
+    else:
+        code = Asm(0x8000).assemble(bank_code(b), zp=ZP)
+    code = code + bytes([0xFF]) * (0x2000 - len(code))
+    assert len(code) == 0x2000, (b, len(code))
+    banks.append(code)
+prg = b''.join(banks)
+rng = Lcg(2)
+chr_ = bytearray(rng.byte() for _ in range(0x20000))
+for bank in range(128):
+    base = bank * 0x400
+    for i in range(16): chr_[base + i] = 0
+    for i in range(16): chr_[base + 16 + i] = 0xFF
+open(sys.argv[1], 'wb').write(ines(prg, bytes(chr_), 4))
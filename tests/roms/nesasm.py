@@ -0,0 +1,184 @@
+"""Small 6502 assembler for the test ROMs, official opcodes only.
+
+Labels, `name = value` assignments, .byte, .word and .org are supported,
+values can be $hex, %binary or decimal with + and - and a < or > prefix
+for the low or high byte. Zero page operands are the names given to
+assemble() and the values of one or two hex digits.
+"""
+
+import re
+
+OPCODES = {
+    'ADC': {'izx': 0x61, 'zp': 0x65, 'imm': 0x69, 'abs': 0x6D, 'izy': 0x71, 'zpx': 0x75, 'aby': 0x79, 'abx': 0x7D},
+    'AND': {'izx': 0x21, 'zp': 0x25, 'imm': 0x29, 'abs': 0x2D, 'izy': 0x31, 'zpx': 0x35, 'aby': 0x39, 'abx': 0x3D},
+    'ASL': {'zp': 0x06, 'imp': 0x0A, 'abs': 0x0E, 'zpx': 0x16, 'abx': 0x1E},
+    'BCC': {'rel': 0x90},
+    'BCS': {'rel': 0xB0},
+    'BEQ': {'rel': 0xF0},
+    'BIT': {'zp': 0x24, 'abs': 0x2C},
+    'BMI': {'rel': 0x30},
+    'BNE': {'rel': 0xD0},
+    'BPL': {'rel': 0x10},
+    'BRK': {'imp': 0x00},
+    'BVC': {'rel': 0x50},
+    'BVS': {'rel': 0x70},
+    'CLC': {'imp': 0x18},
+    'CLD': {'imp': 0xD8},
+    'CLI': {'imp': 0x58},
+    'CLV': {'imp': 0xB8},
+    'CMP': {'izx': 0xC1, 'zp': 0xC5, 'imm': 0xC9, 'abs': 0xCD, 'izy': 0xD1, 'zpx': 0xD5, 'aby': 0xD9, 'abx': 0xDD},
+    'CPX': {'imm': 0xE0, 'zp': 0xE4, 'abs': 0xEC},
+    'CPY': {'imm': 0xC0, 'zp': 0xC4, 'abs': 0xCC},
+    'DEC': {'zp': 0xC6, 'abs': 0xCE, 'zpx': 0xD6, 'abx': 0xDE},
+    'DEX': {'imp': 0xCA},
+    'DEY': {'imp': 0x88},
+    'EOR': {'izx': 0x41, 'zp': 0x45, 'imm': 0x49, 'abs': 0x4D, 'izy': 0x51, 'zpx': 0x55, 'aby': 0x59, 'abx': 0x5D},
+    'INC': {'zp': 0xE6, 'abs': 0xEE, 'zpx': 0xF6, 'abx': 0xFE},
+    'INX': {'imp': 0xE8},
+    'INY': {'imp': 0xC8},
+    'JMP': {'abs': 0x4C, 'ind': 0x6C},
+    'JSR': {'abs': 0x20},
+    'LDA': {'izx': 0xA1, 'zp': 0xA5, 'imm': 0xA9, 'abs': 0xAD, 'izy': 0xB1, 'zpx': 0xB5, 'aby': 0xB9, 'abx': 0xBD},
+    'LDX': {'imm': 0xA2, 'zp': 0xA6, 'abs': 0xAE, 'zpy': 0xB6, 'aby': 0xBE},
+    'LDY': {'imm': 0xA0, 'zp': 0xA4, 'abs': 0xAC, 'zpx': 0xB4, 'abx': 0xBC},
+    'LSR': {'zp': 0x46, 'imp': 0x4A, 'abs': 0x4E, 'zpx': 0x56, 'abx': 0x5E},
+    'NOP': {'imp': 0xEA},
+    'ORA': {'izx': 0x01, 'zp': 0x05, 'imm': 0x09, 'abs': 0x0D, 'izy': 0x11, 'zpx': 0x15, 'aby': 0x19, 'abx': 0x1D},
+    'PHA': {'imp': 0x48},
+    'PHP': {'imp': 0x08},
+    'PLA': {'imp': 0x68},
+    'PLP': {'imp': 0x28},
+    'ROL': {'zp': 0x26, 'imp': 0x2A, 'abs': 0x2E, 'zpx': 0x36, 'abx': 0x3E},
+    'ROR': {'zp': 0x66, 'imp': 0x6A, 'abs': 0x6E, 'zpx': 0x76, 'abx': 0x7E},
+    'RTI': {'imp': 0x40},
+    'RTS': {'imp': 0x60},
+    'SBC': {'izx': 0xE1, 'zp': 0xE5, 'imm': 0xE9, 'abs': 0xED, 'izy': 0xF1, 'zpx': 0xF5, 'aby': 0xF9, 'abx': 0xFD},
+    'SEC': {'imp': 0x38},
+    'SED': {'imp': 0xF8},
+    'SEI': {'imp': 0x78},
+    'STA': {'izx': 0x81, 'zp': 0x85, 'abs': 0x8D, 'izy': 0x91, 'zpx': 0x95, 'aby': 0x99, 'abx': 0x9D},
+    'STX': {'zp': 0x86, 'abs': 0x8E, 'zpy': 0x96},
+    'STY': {'zp': 0x84, 'abs': 0x8C, 'zpx': 0x94},
+    'TAX': {'imp': 0xAA},
+    'TAY': {'imp': 0xA8},
+    'TSX': {'imp': 0xBA},
+    'TXA': {'imp': 0x8A},
+    'TXS': {'imp': 0x9A},
+    'TYA': {'imp': 0x98},
+}
+
+MODES = {
+    'AM_IMPLIED': 'imp', 'AM_IMMEDIATE': 'imm', 'AM_ZEROPAGE': 'zp',
+    'AM_ZEROPAGE_INDEXED_X': 'zpx', 'AM_ZEROPAGE_INDEXED_Y': 'zpy',
+    'AM_ABSOLUTE': 'abs', 'AM_ABSOLUTE_INDEXED_X': 'abx', 'AM_ABSOLUTE_INDEXED_Y': 'aby',
+    'AM_INDIRECT': 'ind', 'AM_INDEXED_INDIRECT': 'izx', 'AM_INDIRECT_INDEXED': 'izy',
+    'AM_RELATIVE': 'rel',
+}
+
+table = {(mn, am): OPCODES[mn][mode] for am, mode in MODES.items() for mn in OPCODES if mode in OPCODES[mn]}
+
+
+class Asm:
+    def __init__(self, org):
+        self.org = org; self.lines = []; self.labels = {}
+    def parse_val(self, s, labels, final):
+        s = s.strip()
+        lo = hi = False
+        if s.startswith('<'): lo = True; s = s[1:]
+        elif s.startswith('>'): hi = True; s = s[1:]
+        total = 0
+        for term in re.findall(r'[+-]?[^+-]+', s):
+            sign = -1 if term.startswith('-') else 1
+            t = term.lstrip('+-').strip()
+            if t.startswith('$'): v = int(t[1:], 16)
+            elif t.startswith('%'): v = int(t[1:], 2)
+            elif t[0].isdigit(): v = int(t)
+            else:
+                if t in labels: v = labels[t]
+                elif final: raise Exception('undefined ' + t)
+                else: v = 0xFFFF
+            total += sign * v
+        if lo: total &= 0xFF
+        if hi: total = (total >> 8) & 0xFF
+        return total
+    def isz(self, s):
+        s = s.strip()
+        return re.fullmatch(r'<?\$[0-9A-Fa-f]{1,2}', s) is not None or s.startswith('<') or s.startswith('>') or s in self.zp
+    def assemble(self, text, zp=()):
+        self.zp = set(zp)
+        labels = {}
+        for p in range(3):
+            out = bytearray(); pc = self.org; final = (p == 2)
+            for raw in text.split('\n'):
+                line = raw.split(';')[0].strip()
+                if not line: continue
+                m = re.match(r'^(\w+):\s*(.*)$', line)
+                if m:
+                    labels[m.group(1)] = pc; line = m.group(2).strip()
+                    if not line: continue
+                m = re.match(r'^(\w+)\s*=\s*(.+)$', line)
+                if m:
+                    labels[m.group(1)] = self.parse_val(m.group(2), labels, final); continue
+                if line.startswith('.byte'):
+                    for v in line[5:].split(','):
+                        out.append(self.parse_val(v, labels, final) & 0xFF); pc += 1
+                    continue
+                if line.startswith('.word'):
+                    for v in line[5:].split(','):
+                        w = self.parse_val(v, labels, final); out += bytes([w & 0xFF, w >> 8]); pc += 2
+                    continue
+                if line.startswith('.org'):
+                    target = self.parse_val(line[4:], labels, True)
+                    while pc < target: out.append(0xFF); pc += 1
+                    continue
+                parts = line.split(None, 1)
+                mn = parts[0].upper(); arg = parts[1].strip() if len(parts) > 1 else ''
+                if mn in ('BPL','BMI','BVC','BVS','BCC','BCS','BNE','BEQ'):
+                    t = self.parse_val(arg, labels, final)
+                    off = t - (pc + 2)
+                    if final and not -128 <= off <= 127: raise Exception('branch range ' + line)
+                    out += bytes([table[(mn,'AM_RELATIVE')], off & 0xFF]); pc += 2; continue
+                if arg == '' or arg == 'A':
+                    am, n = 'AM_IMPLIED', 0
+                elif arg.startswith('#'):
+                    am, n = 'AM_IMMEDIATE', 1; v = self.parse_val(arg[1:], labels, final)
+                elif re.match(r'^\(.*,\s*[xX]\)$', arg):
+                    am, n = 'AM_INDEXED_INDIRECT', 1; v = self.parse_val(arg[1:arg.index(',')], labels, final)
+                elif re.match(r'^\(.*\),\s*[yY]$', arg):
+                    am, n = 'AM_INDIRECT_INDEXED', 1; v = self.parse_val(arg[1:arg.index(')')], labels, final)
+                elif arg.startswith('('):
+                    am, n = 'AM_INDIRECT', 2; v = self.parse_val(arg[1:-1], labels, final)
+                else:
+                    idx = None
+                    m = re.match(r'^(.*),\s*([xXyY])$', arg)
+                    if m: arg, idx = m.group(1), m.group(2).upper()
+                    v = self.parse_val(arg, labels, final)
+                    zp_ok = self.isz(arg)
+                    if zp_ok:
+                        am = {None:'AM_ZEROPAGE','X':'AM_ZEROPAGE_INDEXED_X','Y':'AM_ZEROPAGE_INDEXED_Y'}[idx]
+                        n = 1
+                        if (mn, am) not in table: zp_ok = False
+                    if not zp_ok:
+                        am = {None:'AM_ABSOLUTE','X':'AM_ABSOLUTE_INDEXED_X','Y':'AM_ABSOLUTE_INDEXED_Y'}[idx]; n = 2
+                if (mn, am) not in table: raise Exception('bad op ' + line + ' ' + am)
+                out.append(table[(mn, am)])
+                if n == 1: out.append(v & 0xFF)
+                if n == 2: out += bytes([v & 0xFF, (v >> 8) & 0xFF])
+                pc += 1 + n
+        self.labels = labels
+        return bytes(out)
+
+def ines(prg, chr_, mapper=0, vertical=True, prg_ram=False):
+    h = bytearray(b'NES\x1a') + bytes([len(prg)//16384, len(chr_)//8192, ((mapper & 0xF) << 4) | (1 if vertical else 0) | (2 if prg_ram else 0), mapper & 0xF0]) + bytes(8)
+    return bytes(h) + prg + chr_
+
+
+class Lcg:
+    """Fixed random bytes for the pattern tables, the same on every Python."""
+
+    def __init__(self, seed):
+        self.state = seed
+
+    def byte(self):
+        self.state = (self.state * 1103515245 + 12345) & 0x7FFFFFFF
+        return (self.state >> 16) & 0xFF
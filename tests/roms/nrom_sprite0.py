@@ -0,0 +1,319 @@
+import argparse
+
+from nesasm import Asm, Lcg, ines
+
+# NROM with a sprite 0 hit splitting the scroll, moving sprites and some
+# sorting work in the main loop. With --cpu-loop the main loop only calls
+# the work routines, rendering stays off
+src = r'''
+frame = $00
+nmi_flag = $01
+seed = $02
+scroll_x = $04
+tmpx = $05
+pad = $06
+chk = $07
+ptr = $08
+cnt = $0A
+reset:
+  SEI
+  CLD
+  LDX #$FF
+  TXS
+  LDA #0
+  STA $2000
+  STA $2001
+vw1: BIT $2002
+  BPL vw1
+  LDA #0
+  TAX
+clr: STA $00,X
+  STA $0200,X
+  STA $0300,X
+  STA $0400,X
+  STA $0500,X
+  STA $0600,X
+  STA $0700,X
+  INX
+  BNE clr
+vw2: LDA $2002
+  BPL vw2
+  LDA #$3F
+  STA $2006
+  LDA #$00
+  STA $2006
+  LDX #0
+pal: LDA palette,X
+  STA $2007
+  INX
+  CPX #32
+  BNE pal
+  LDA #$20
+  STA $2006
+  LDA #$00
+  STA $2006
+  LDX #8
+  LDY #0
+nt: TYA
+  LSR A
+  EOR tmpx
+  AND #$0F
+  STA $2007
+  INY
+  BNE nt
+  INC tmpx
+  DEX
+  BNE nt
+  LDX #0
+spr: TXA
+  ASL A
+  ADC #16
+  STA $0200,X
+  TXA
+  LSR A
+  LSR A
+  AND #$07
+  ORA #$01
+  STA $0201,X
+  TXA
+  AND #$E3
+  STA $0202,X
+  TXA
+  STA $0203,X
+  INX
+  INX
+  INX
+  INX
+  BNE spr
+  LDA #30
+  STA $0200
+  LDA #1
+  STA $0201
+  LDA #0
+  STA $0202
+  LDA #40
+  STA $0203
+  LDA #$34
+  STA seed
+  LDA #$12
+  STA seed+1
+MAIN_START
+main:
+wait: LDA nmi_flag
+  BEQ wait
+  LDA #0
+  STA nmi_flag
+s0clr: BIT $2002
+  BVS s0clr
+s0set: BIT $2002
+  BVC s0set
+  LDA scroll_x
+  STA $2005
+  LDA #0
+  STA $2005
+  JSR work
+  JMP main
+
+rand:
+  LDA seed
+  ASL A
+  ROL seed+1
+  BCC nofb
+  EOR #$2D
+nofb:
+  STA seed
+  RTS
+
+work:
+  LDX #0
+fill: JSR rand
+  STA $0300,X
+  EOR seed+1
+  STA $0340,X
+  INX
+  CPX #40
+  BNE fill
+  LDY #39
+outer: LDX #0
+inner: LDA $0300,X
+  CMP $0301,X
+  BCC noswap
+  BEQ noswap
+  PHA
+  LDA $0301,X
+  STA $0300,X
+  PLA
+  STA $0301,X
+noswap: INX
+  STX cnt
+  CPY cnt
+  BNE inner
+  DEY
+  BNE outer
+  LDA #$00
+  STA ptr
+  LDA #$03
+  STA ptr+1
+  LDY #0
+  LDA #0
+  CLC
+sum: ADC (ptr),Y
+  ROR chk
+  SBC $0340,Y
+  ROL chk
+  INY
+  CPY #40
+  BNE sum
+  LDX #ptr
+  STA chk
+  LDA (0,X)
+  .byte $A7, chk        ; LAX zp
+  .byte $87, $0B        ; SAX zp
+  .byte $C7, $0B        ; DCP zp
+  .byte $E7, $0B        ; ISC zp
+  .byte $0F, $80, $03   ; SLO abs
+  .byte $3F, $00, $03   ; RLA abs,x
+  .byte $5B, $00, $03   ; SRE abs,y
+  .byte $73, ptr        ; RRA (zp),y
+  INC $0380
+  DEC $0381,X
+  LSR $0382
+  ASL $0383,X
+  BIT $0384
+  LDA #$55
+  PHP
+  SED
+  ADC #$27
+  CLD
+  PLP
+  JMP (indvec)
+indret:
+  RTS
+
+nmi:
+  PHA
+  TXA
+  PHA
+  TYA
+  PHA
+  LDA #$02
+  STA $4014
+  LDA #0
+  STA $2005
+  STA $2005
+  LDA #$80
+  STA $2000
+  LDA #1
+  STA $4016
+  LDA #0
+  STA $4016
+  LDX #8
+rd: LDA $4016
+  LSR A
+  ROL pad
+  DEX
+  BNE rd
+  LDX #4
+mv: TXA
+  LSR A
+  LSR A
+  AND #$03
+  SEC
+  ADC $0203,X
+  STA $0203,X
+  INX
+  INX
+  INX
+  INX
+  BNE mv
+  INC frame
+  LDA frame
+  STA scroll_x
+  AND #$0F
+  BNE nosnd
+  LDA #$BF
+  STA $4000
+  LDA frame
+  STA $4002
+  LDA #$08
+  STA $4003
+  LDA #$01
+  STA $4015
+nosnd:
+  LDA #1
+  STA nmi_flag
+  PLA
+  TAY
+  PLA
+  TAX
+  PLA
+  RTI
+
+irq:
+  RTI
+
+indvec: .word indret
+palette:
+  .byte $0F,$01,$11,$21, $0F,$06,$16,$26, $0F,$09,$19,$29, $0F,$0C,$1C,$2C
+  .byte $0F,$14,$24,$34, $0F,$07,$17,$27, $0F,$0A,$1A,$2A, $0F,$03,$13,$23
+
+.org $FFFA
+  .word nmi, reset, irq
+'''
+
+RENDER = '''
+  LDA #$1E
+  STA $2001
+  LDA #$80
+  STA $2000
+'''
+CPU_LOOP = '''
+cpuloop:
+  JSR work
+  JSR work2
+  JMP cpuloop
+'''
+WORK2 = '''
+work2:
+  LDX #0
+w2a: LDA $0300,X
+  ASL A
+  ROL $0400,X
+  ADC $0340,X
+  STA $0500,X
+  LDY $0500,X
+  EOR $0300,Y
+  STA $0600,X
+  TXA
+  SBC #3
+  TAY
+  LDA ($08),Y
+  AND #$7F
+  ORA $10
+  STA $10
+  INX
+  BNE w2a
+  RTS
+'''
+
+parser = argparse.ArgumentParser()
+parser.add_argument('output')
+parser.add_argument('--cpu-loop', action='store_true', help='run only the work routines')
+args = parser.parse_args()
+
+src = src.replace('MAIN_START\n', (CPU_LOOP if args.cpu_loop else RENDER).lstrip('\n'))
+if args.cpu_loop:
+    src = src.replace('\nnmi:\n', WORK2 + '\nnmi:\n')
+a = Asm(0x8000)
+prg = a.assemble(src, zp=['frame','nmi_flag','seed','scroll_x','tmpx','pad','chk','ptr','cnt','seed+1','ptr+1'])
+assert len(prg) == 0x8000, hex(len(prg))
+rng = Lcg(1)
+chr_ = bytearray(0x2000)
+for t in range(512):
+    for r in range(8):
+        if t % 256 == 0: lo = hi = 0
+        elif t % 256 == 1: lo = hi = 0xFF
+        elif t % 256 == 2: lo = 0xAA if r & 1 else 0x55; hi = 0x0F
+        else: lo = rng.byte(); hi = rng.byte()
+        chr_[t*16 + r] = lo; chr_[t*16 + 8 + r] = hi
+open(args.output, 'wb').write(ines(prg, bytes(chr_), 0))
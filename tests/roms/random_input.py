@@ -0,0 +1,17 @@
+import argparse
+
+from nesasm import Lcg
+
+# Controller input for the headless runner, one byte per controller and per
+# frame, each button pattern held for 1 to 32 frames
+parser = argparse.ArgumentParser()
+parser.add_argument('output')
+parser.add_argument('--frames', type=int, default=2000)
+args = parser.parse_args()
+
+rng = Lcg(4)
+data = bytearray()
+while len(data) < args.frames * 2:
+    buttons = bytes([rng.byte(), rng.byte()])
+    data += buttons * (1 + (rng.byte() & 0x1F))
+open(args.output, 'wb').write(bytes(data[:args.frames * 2]))
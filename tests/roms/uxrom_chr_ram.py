@@ -0,0 +1,172 @@
+import argparse
+
+from nesasm import Asm, ines
+
+# UxROM with CHR RAM: tiles uploaded at reset and one rewritten every frame,
+# flipped 8x16 sprites moving over a scrolling background
+src = r'''
+frame = $00
+nmi_flag = $01
+tmp = $02
+ptr = $03
+.org $8000
+reset:
+  SEI
+  CLD
+  LDX #$FF
+  TXS
+  LDA #0
+  STA $2000
+  STA $2001
+vw1: BIT $2002
+  BPL vw1
+  LDA #0
+  TAX
+clr: STA $00,X
+  STA $0200,X
+  INX
+  BNE clr
+vw2: LDA $2002
+  BPL vw2
+; pattern tables: 8KB of bytes from an LFSR-ish sequence
+  LDA #$00
+  STA $2006
+  STA $2006
+  LDY #$20
+  LDA #$5A
+  STA tmp
+chr: LDX #0
+chr2: LDA tmp
+  ASL A
+  BCC nox
+  EOR #$1D
+nox: STA tmp
+  STA $2007
+  INX
+  BNE chr2
+  DEY
+  BNE chr
+  LDA #$3F
+  STA $2006
+  LDA #$00
+  STA $2006
+  LDX #0
+pal: LDA palette,X
+  STA $2007
+  INX
+  CPX #32
+  BNE pal
+  LDA #$20
+  STA $2006
+  LDA #$00
+  STA $2006
+  LDX #8
+  LDY #0
+nt: TYA
+  EOR tmp
+  STA $2007
+  INY
+  BNE nt
+  INC tmp
+  DEX
+  BNE nt
+; 64 sprites, every attribute combination
+  LDX #0
+spr: TXA
+  ASL A
+  ASL A
+  ASL A
+  STA $0200,X
+  TXA
+  STA $0201,X
+  STA $0202,X
+  ASL A
+  STA $0203,X
+  INX
+  INX
+  INX
+  INX
+  BNE spr
+  LDA #MASK
+  STA $2001
+  LDA #$B8
+  STA $2000
+main:
+wait: LDA nmi_flag
+  BEQ wait
+  LDA #0
+  STA nmi_flag
+  JMP main
+
+nmi:
+  PHA
+  TXA
+  PHA
+  LDA #$02
+  STA $4014
+; rewrite a tile row of the tile the frame number selects
+  LDA frame
+  LSR A
+  LSR A
+  LSR A
+  LSR A
+  AND #$0F
+  ORA #$10
+  STA $2006
+  LDA frame
+  ASL A
+  ASL A
+  ASL A
+  ASL A
+  STA $2006
+  LDX #16
+up: LDA frame
+  EOR tmp
+  STA $2007
+  INC tmp
+  DEX
+  BNE up
+  LDA frame
+  STA $2005
+  LSR A
+  STA $2005
+  LDA #$B8
+  STA $2000
+; move the sprites
+  LDX #0
+mv: INC $0203,X
+  INX
+  INX
+  INX
+  INX
+  BNE mv
+  INC frame
+  LDA #1
+  STA nmi_flag
+  PLA
+  TAX
+  PLA
+  RTI
+
+irq:
+  RTI
+
+palette:
+  .byte $0F,$01,$11,$21, $0F,$06,$16,$26, $0F,$09,$19,$29, $0F,$0C,$1C,$2C
+  .byte $0F,$14,$24,$34, $0F,$07,$17,$27, $0F,$0A,$1A,$2A, $0F,$03,$13,$23
+
+.org $BFFA
+  .word nmi, reset, irq
+'''
+
+parser = argparse.ArgumentParser()
+parser.add_argument('output')
+parser.add_argument('--emphasis', action='store_true', help='grey and colour emphasis on')
+args = parser.parse_args()
+
+src = src.replace('MASK', '$3F' if args.emphasis else '$1E')
+a = Asm(0x8000)
+bank = a.assemble(src, zp=['frame','nmi_flag','tmp','ptr'])
+assert len(bank) == 0x4000, hex(len(bank))
+prg = bank + bank
+open(args.output, 'wb').write(ines(prg, b'', 2))
@@ -220,7 +220,7 @@ void Blip_Buffer::mix_samples( blip_sample_t const in [], int count )
 	*out -= prev;
 }
 
-void Blip_Buffer::save_state( blip_buffer_state_t* out )
+void Blip_Buffer::save_state( blip_buffer_state_t* out ) const
 {
 	assert( samples_avail() == 0 );
 	out->offset_       = offset_;
@@ -89,7 +89,7 @@ public:
 	// Saves state, including high-pass filter and tails of last deltas.
 	// All samples must have been read from buffer before calling this
 	// (that is, samples_avail() must return 0).
-	void save_state( blip_buffer_state_t* out );
+	void save_state( blip_buffer_state_t* out ) const;
 	
 	// Loads state. State must have been saved from Blip_Buffer with same
 	// settings during same run of program; states can NOT be stored on disk.
@@ -14,6 +14,8 @@
 
 #include "Nes_Apu.h"
 
+#include <cstring>
+
 int const amp_range = 15;
 
 Nes_Apu::Nes_Apu() :
@@ -116,6 +118,122 @@ void Nes_Apu::reset( bool pal_mode, uint8_t initial_dmc_dac )
 		dmc.last_amp = initial_dmc_dac; // prevent output transition
 }
 
+// state
+
+static void save_osc( Nes_Osc const& osc, apu_state_t::osc_t* out )
+{
+	memcpy( out->regs, osc.regs, sizeof out->regs );
+	memcpy( out->reg_written, osc.reg_written, sizeof out->reg_written );
+	out->length_counter = osc.length_counter;
+	out->delay          = osc.delay;
+	out->last_amp       = osc.last_amp;
+}
+
+static void load_osc( Nes_Osc& osc, apu_state_t::osc_t const& in )
+{
+	memcpy( osc.regs, in.regs, sizeof osc.regs );
+	memcpy( osc.reg_written, in.reg_written, sizeof osc.reg_written );
+	osc.length_counter = in.length_counter;
+	osc.delay          = in.delay;
+	osc.last_amp       = in.last_amp;
+}
+
+static void save_square( Nes_Square const& osc, apu_state_t::square_t* out )
+{
+	save_osc( osc, &out->osc );
+	out->env.envelope  = osc.envelope;
+	out->env.env_delay = osc.env_delay;
+	out->phase         = osc.phase;
+	out->sweep_delay   = osc.sweep_delay;
+}
+
+static void load_square( Nes_Square& osc, apu_state_t::square_t const& in )
+{
+	load_osc( osc, in.osc );
+	osc.envelope    = in.env.envelope;
+	osc.env_delay   = in.env.env_delay;
+	osc.phase       = in.phase;
+	osc.sweep_delay = in.sweep_delay;
+}
+
+void Nes_Apu::save_state( apu_state_t* out ) const
+{
+	save_square( square1, &out->square1 );
+	save_square( square2, &out->square2 );
+	
+	save_osc( triangle, &out->triangle.osc );
+	out->triangle.phase          = triangle.phase;
+	out->triangle.linear_counter = triangle.linear_counter;
+	
+	save_osc( noise, &out->noise.osc );
+	out->noise.env.envelope  = noise.envelope;
+	out->noise.env.env_delay = noise.env_delay;
+	out->noise.noise         = noise.noise;
+	
+	save_osc( dmc, &out->dmc.osc );
+	out->dmc.address     = dmc.address;
+	out->dmc.period      = dmc.period;
+	out->dmc.buf         = dmc.buf;
+	out->dmc.bits_remain = dmc.bits_remain;
+	out->dmc.bits        = dmc.bits;
+	out->dmc.dac         = dmc.dac;
+	out->dmc.next_irq    = dmc.next_irq;
+	out->dmc.buf_full    = dmc.buf_full;
+	out->dmc.silence     = dmc.silence;
+	out->dmc.irq_enabled = dmc.irq_enabled;
+	out->dmc.irq_flag    = dmc.irq_flag;
+	
+	out->last_time     = last_time;
+	out->last_dmc_time = last_dmc_time;
+	out->earliest_irq  = earliest_irq_;
+	out->next_irq      = next_irq;
+	out->frame_delay   = frame_delay;
+	out->frame         = frame;
+	out->osc_enables   = osc_enables;
+	out->frame_mode    = frame_mode;
+	out->irq_flag      = irq_flag;
+	out->enable_w4011  = enable_w4011;
+}
+
+void Nes_Apu::load_state( apu_state_t const& in )
+{
+	load_square( square1, in.square1 );
+	load_square( square2, in.square2 );
+	
+	load_osc( triangle, in.triangle.osc );
+	triangle.phase          = in.triangle.phase;
+	triangle.linear_counter = in.triangle.linear_counter;
+	
+	load_osc( noise, in.noise.osc );
+	noise.envelope  = in.noise.env.envelope;
+	noise.env_delay = in.noise.env.env_delay;
+	noise.noise     = in.noise.noise;
+	
+	load_osc( dmc, in.dmc.osc );
+	dmc.address     = in.dmc.address;
+	dmc.period      = in.dmc.period;
+	dmc.buf         = in.dmc.buf;
+	dmc.bits_remain = in.dmc.bits_remain;
+	dmc.bits        = in.dmc.bits;
+	dmc.dac         = in.dmc.dac;
+	dmc.next_irq    = in.dmc.next_irq;
+	dmc.buf_full    = in.dmc.buf_full;
+	dmc.silence     = in.dmc.silence;
+	dmc.irq_enabled = in.dmc.irq_enabled;
+	dmc.irq_flag    = in.dmc.irq_flag;
+	
+	last_time     = in.last_time;
+	last_dmc_time = in.last_dmc_time;
+	earliest_irq_ = in.earliest_irq;
+	next_irq      = in.next_irq;
+	frame_delay   = in.frame_delay;
+	frame         = in.frame;
+	osc_enables   = in.osc_enables;
+	frame_mode    = in.frame_mode;
+	irq_flag      = in.irq_flag;
+	enable_w4011  = in.enable_w4011;
+}
+
 void Nes_Apu::irq_changed()
 {
 	blip_time_t new_irq = dmc.next_irq;
@@ -177,3 +177,72 @@ inline Nes_Apu::nes_time_t Nes_Dmc::next_read_time() const
 }
 
 inline Nes_Apu::nes_time_t Nes_Apu::next_dmc_read_time() const { return dmc.next_read_time(); }
+
+// Exact emulation state of Nes_Apu. Plain data, only meant to be loaded by
+// the same build.
+struct apu_state_t
+{
+	struct osc_t {
+		unsigned char regs [4];
+		bool reg_written [4];
+		int length_counter;
+		int delay;
+		int last_amp;
+	};
+	
+	struct envelope_t {
+		int envelope;
+		int env_delay;
+	};
+	
+	struct square_t {
+		osc_t osc;
+		envelope_t env;
+		int phase;
+		int sweep_delay;
+	};
+	
+	struct triangle_t {
+		osc_t osc;
+		int phase;
+		int linear_counter;
+	};
+	
+	struct noise_t {
+		osc_t osc;
+		envelope_t env;
+		int noise;
+	};
+	
+	struct dmc_t {
+		osc_t osc;
+		int address;
+		int period;
+		int buf;
+		int bits_remain;
+		int bits;
+		int dac;
+		int next_irq;
+		bool buf_full;
+		bool silence;
+		bool irq_enabled;
+		bool irq_flag;
+	};
+	
+	square_t square1;
+	square_t square2;
+	triangle_t triangle;
+	noise_t noise;
+	dmc_t dmc;
+	
+	int last_time;
+	int last_dmc_time;
+	int earliest_irq;
+	int next_irq;
+	int frame_delay;
+	int frame;
+	int osc_enables;
+	int frame_mode;
+	bool irq_flag;
+	bool enable_w4011;
+};